@@ -18,17 +18,17 @@
 #define HASH_BUCKETS 65536 //2^15 + 1
 
 typedef struct hash_data_t {
-    void* key;
-    char* cache_node_ptr;
+    offset_ptr_t key;
+    offset_ptr_t cache_node_ptr;
 }__attribute__((aligned(8))) hash_data_t;
 
 typedef struct bucket_t {
-    list_t* list;
+    offset_ptr_t list;
     int list_count;
 }__attribute__((aligned(8))) bucket_t;
 
 typedef struct hash_t {
-    bucket_t* bucket_list;
+    offset_ptr_t bucket_list;
     LIBCACHE_CMP_KEY* kcmp;
     LIBCACHE_KEY_TO_NUMBER* k2num;
     int max_buckets;
@@ -44,6 +44,26 @@ static inline u32 key_to_hash(hash_t* hash, const void* key)
     return val >> (32 - HASH_BITS);
 }
 
+static inline bucket_t* hash_get_bucket(const hash_t* hash, u32 hash_code)
+{
+    return (bucket_t*) offset_ptr_get(&hash->bucket_list) + hash_code;
+}
+
+static inline list_t* bucket_get_list(const bucket_t* bucket)
+{
+    return (list_t*) offset_ptr_get(&bucket->list);
+}
+
+static inline void* hash_data_get_key(const hash_data_t* hash_data)
+{
+    return offset_ptr_get(&hash_data->key);
+}
+
+static inline void* hash_data_get_cache_node(const hash_data_t* hash_data)
+{
+    return offset_ptr_get(&hash_data->cache_node_ptr);
+}
+
 /**
  * @fn hash_init
  *
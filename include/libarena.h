@@ -0,0 +1,162 @@
+/*
+ * libarena.h
+ *
+ *  Memory regions backing the cache pools.
+ */
+
+#ifndef LIBARENA_H_
+#define LIBARENA_H_
+#include <stddef.h>
+#include "libcache_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARENA_HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define ARENA_GIGA_PAGE_SIZE (1024UL * 1024 * 1024)
+
+/* Pages backing a private region, a kind that isn't available falls back to the next one:
+ * 1G -> 2M -> THP -> 4K.
+ */
+typedef enum {
+    ARENA_PAGES_DEFAULT,        /* 4K pages */
+    ARENA_PAGES_THP,            /* transparent huge pages (madvise) */
+    ARENA_PAGES_HUGE_2M,        /* hugetlb pages reserved in vm.nr_hugepages */
+    ARENA_PAGES_HUGE_1G,        /* hugetlb 1G pages reserved at boot */
+} arena_pages_e;
+
+/* arena_populate flags */
+#define ARENA_PREFAULT (0x1)    /* fault every page in now instead of on first touch */
+#define ARENA_MLOCK    (0x2)    /* lock the pages in memory */
+
+typedef struct arena_report_t {
+    arena_pages_e pages;        /* pages the region got */
+    int prefaulted;
+    int locked;
+    const char* reason;         /* why a request wasn't fulfilled, NULL when all of it was */
+} arena_report_t;
+
+/**
+ * @fn arena_shm_create
+ *
+ * @brief create a named shared memory segment and map it.
+ * @param [in] name - POSIX shared memory name ("/name"),
+ *                    or a file path on a hugetlbfs mount ("/dev/hugepages/name")
+ * @param [in,out] size - size of the segment, rounded up to ARENA_HUGE_PAGE_SIZE for a file path
+ * @return - address of the mapped segment, NULL when failed (e.g. the name exists already)
+ */
+void* arena_shm_create(const char* name, size_t* size);
+
+/**
+ * @fn arena_shm_attach
+ *
+ * @brief map an existing named shared memory segment.
+ * @param [in] name  - name given to arena_shm_create
+ * @param [out] size - size of the segment
+ * @return - address of the mapped segment, NULL when failed
+ */
+void* arena_shm_attach(const char* name, size_t* size);
+
+/**
+ * @fn arena_shm_detach
+ *
+ * @brief unmap a shared memory segment, the content is kept.
+ * @param [in] addr - address returned by arena_shm_create/arena_shm_attach
+ * @param [in] size - size of the segment
+ */
+void arena_shm_detach(void* addr, size_t size);
+
+/**
+ * @fn arena_shm_unlink
+ *
+ * @brief remove the name of a shared memory segment, the memory is released
+ *        when the last process detaches.
+ * @param [in] name - name given to arena_shm_create
+ * @return -  OK / ERR
+ */
+return_t arena_shm_unlink(const char* name);
+
+/**
+ * @fn arena_alloc
+ *
+ * @brief map an anonymous private memory region, pages are populated on first touch.
+ * @param [in] size - size of the region
+ * @return - address of the region, NULL when failed
+ */
+void* arena_alloc(size_t size);
+
+/**
+ * @fn arena_free
+ *
+ * @brief unmap a region returned by arena_alloc.
+ * @param [in] addr - address of the region
+ * @param [in] size - size of the region
+ */
+void arena_free(void* addr, size_t size);
+
+/**
+ * @fn arena_alloc_pages
+ *
+ * @brief map an anonymous private memory region backed by the given kind of pages,
+ *        or by smaller ones when they can't be had.
+ * @param [in,out] size  - size of the region, rounded up to the page size used
+ * @param [in] pages     - kind of pages wanted
+ * @param [out] report   - pages used and the reason of a fallback, it can be NULL
+ * @return - address of the region, NULL when failed. arena_free releases it.
+ */
+void* arena_alloc_pages(size_t* size, arena_pages_e pages, arena_report_t* report);
+
+/**
+ * @fn arena_get_page_size
+ *
+ * @brief get the size of a kind of pages, arena_alloc_pages rounds a region up to it.
+ * @param [in] pages - kind of pages
+ * @return - size in bytes
+ */
+size_t arena_get_page_size(arena_pages_e pages);
+
+/**
+ * @fn arena_populate
+ *
+ * @brief prefault and/or lock the pages of a region, after arena_numa_bind if it is used.
+ * @param [in] addr    - address of the region
+ * @param [in] size    - size of the region
+ * @param [in] flags   - ARENA_PREFAULT | ARENA_MLOCK
+ * @param [out] report - prefaulted/locked and the reason of a failure, it can be NULL
+ * @return -  OK / ERR (something wasn't done, the region is still usable)
+ */
+return_t arena_populate(void* addr, size_t size, int flags, arena_report_t* report);
+
+/**
+ * @fn arena_numa_node_count
+ *
+ * @brief get the number of NUMA nodes of this machine.
+ * @return - node count, 1 when NUMA is not available
+ */
+int arena_numa_node_count(void);
+
+/**
+ * @fn arena_numa_current_node
+ *
+ * @brief get the NUMA node of the CPU the caller runs on.
+ * @return - node id, 0 when it can't be told
+ */
+int arena_numa_current_node(void);
+
+/**
+ * @fn arena_numa_bind
+ *
+ * @brief prefer a NUMA node for the pages of a region (mbind), it has to be
+ *        called before the pages are touched.
+ * @param [in] addr - address of the region, page aligned
+ * @param [in] size - size of the region
+ * @param [in] node - node id
+ * @return -  OK / ERR (no such node, or the kernel refused the policy)
+ */
+return_t arena_numa_bind(void* addr, size_t size, int node);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LIBARENA_H_ */
@@ -8,6 +8,44 @@
 #ifndef LIBCACHE_H_
 #define LIBCACHE_H_
 #include "libcache_def.h"
+#include "libarena.h"
+#include "libpool.h"
+
+/* Memory of one pool of a cache block, see libcache_estimate_memory and libcache_get_memory_stats */
+typedef struct libcache_pool_stats_t
+{
+    size_t element_size;        /* bytes per element, head and padding included */
+    libcache_scale_t capacity;
+    libcache_scale_t used;
+    libcache_scale_t free;
+    size_t bytes;
+    double overhead_ratio;      /* share of bytes which don't hold keys and entries, 0 .. 1 */
+}libcache_pool_stats_t;
+
+typedef struct libcache_memory_stats_t
+{
+    libcache_pool_stats_t pools[POOL_TYPE_MAX]; /* by pool_type_e */
+    size_t block_bytes;         /* the cache block: its pools, the pointers to them and page rounding */
+    size_t chunk_bytes;         /* records added by libcache_resize */
+    size_t bucket_bytes;        /* index tables mapped by libcache_resize */
+    size_t secondary_bytes;     /* tables and links of the secondary indexes */
+    size_t total_bytes;
+    double bytes_per_entry;     /* total_bytes / entries the cache can hold */
+}libcache_memory_stats_t;
+
+typedef struct libcache_memory_options_t
+{
+    int on_pages;               /* TRUE: the block is mapped by libcache_create_on_pages */
+    arena_pages_e pages;        /* pages of libcache_create_on_pages, the block is rounded up to them */
+    int shared;                 /* TRUE: the block is in a segment of libcache_create_shared */
+}libcache_memory_options_t;
+
+/* libcache_put flags */
+#define LIBCACHE_PUT_NO_PROMOTE (0x1)   /* an overwritten entry keeps its place in the LRU list */
+#define LIBCACHE_PUT_REPLACE    (0x2)   /* only overwrite, a missing key isn't added */
+
+/* secondary indexes a cache can have, see libcache_add_secondary */
+#define LIBCACHE_MAX_SECONDARIES (2)
 
 /*
  *  @brief libcache_create    creates a cache object
@@ -32,6 +70,146 @@ void* libcache_create(
         LIBCACHE_CMP_KEY* cmp_key,
         LIBCACHE_KEY_TO_NUMBER* key_to_number);
 
+/*
+ *  @brief libcache_get_memory_size  gets the memory size a cache object needs.
+ *
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @return                      size in bytes for libcache_create_in_memory.
+ */
+size_t libcache_get_memory_size(libcache_scale_t max_entry_number, size_t entry_size, size_t key_size);
+
+/*
+ *  @brief libcache_estimate_memory  gets the memory a cache object needs and how it's made up.
+ *
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param options               how the cache will be created, NULL: by libcache_create / libcache_create_in_memory.
+ *  @param stats                 output, the bytes of each pool, nothing is used yet. It can be NULL.
+ *  @return                      total size in bytes.
+ */
+size_t libcache_estimate_memory(
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        const libcache_memory_options_t* options,
+        libcache_memory_stats_t* stats);
+
+/*
+ *  @brief libcache_get_memory_stats  gets the memory of a cache object and how much of each pool is used.
+ *
+ *  @param libcache              cache object, cannot be NULL.
+ *  @param stats                 output, cannot be NULL.
+ *  @return
+ *      LIBCACHE_SUCCESS         stats was filled.
+ *  NOTE:   The free elements of each pool are counted, it takes O(free entries).
+ */
+libcache_ret_t libcache_get_memory_stats(const void* libcache, libcache_memory_stats_t* stats);
+
+/*
+ *  @brief libcache_create_in_memory    creates a cache object in memory given by the caller
+ *
+ *  @param memory                memory for this cache object, e.g. a region bound to a NUMA node.
+ *  @param memory_size           size of memory, at least libcache_get_memory_size() bytes.
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param free_memory           function to free memory when the cache is destroyed,
+ *                               it can be NULL if the caller releases memory itself.
+ *  @param free_entry            function to free entry and key, it can be NULL if there isn't any resource to release.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL if memory is too small.
+ */
+void* libcache_create_in_memory(
+        void* memory,
+        size_t memory_size,
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        LIBCACHE_FREE_MEMORY* free_memory,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number);
+
+/*
+ *  @brief libcache_create_on_pages    creates a cache object in a private region of (huge) pages
+ *
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param pages                 pages wanted, e.g. ARENA_PAGES_HUGE_2M to spare TLB misses of random lookups.
+ *                               Smaller pages are used when they can't be had.
+ *  @param populate              ARENA_PREFAULT and/or ARENA_MLOCK the region now, 0: pages are faulted in on first use.
+ *  @param report                pages used and why the wanted ones or populate failed, it can be NULL.
+ *  @param free_entry            function to free entry and key, it can be NULL if there isn't any resource to release.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL on failure. libcache_destroy unmaps the region.
+ */
+void* libcache_create_on_pages(
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        arena_pages_e pages,
+        int populate,
+        arena_report_t* report,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number);
+
+/*
+ *  @brief libcache_create_shared    creates a cache object in a named shared memory segment
+ *
+ *  @param name                  POSIX shared memory name (e.g. "/imsi_cache"),
+ *                               or a file path on a hugetlbfs mount (e.g. "/dev/hugepages/imsi_cache").
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param free_entry            function to free entry and key, it can be NULL if there isn't any resource to release.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL if the segment already exists or on failure.
+ *  NOTE:  libcache_destroy removes the segment name, libcache_detach_shared only unmaps it.
+ */
+void* libcache_create_shared(
+        const char* name,
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number);
+
+/*
+ *  @brief libcache_attach_shared    attaches to a cache object created by libcache_create_shared.
+ *
+ *  @param name                  name used by libcache_create_shared.
+ *  @param free_entry            function to free entry and key, it can be NULL.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL on failure.
+ *  NOTE:  The callbacks are kept in a handle of this process, so every process may bind its own ones.
+ *         The cache itself is not protected against concurrent access, the callers must serialize it.
+ */
+void* libcache_attach_shared(
+        const char* name,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number);
+
+/*
+ *  @brief libcache_detach_shared    detaches from a shared cache object, the entries are kept in the segment.
+ *
+ *  @param libcache                  cache object returned by libcache_create_shared/libcache_attach_shared.
+ *  @return
+ *      LIBCACHE_FAILURE             the cache object is not a shared one.
+ *      LIBCACHE_SUCCESS             the cache was unmapped from this process.
+ */
+libcache_ret_t libcache_detach_shared(void* libcache);
+
 /*
  *  @brief libcache_lookup   To look up an cache entry with a given key.
  *
@@ -45,6 +223,30 @@ void* libcache_create(
  */
 void* libcache_lookup(void* libcache, const void* key, void* dst_entry);
 
+/*
+ *  @brief libcache_peek     looks up an entry without locking it or moving it in the LRU list.
+ *
+ *  @param libcache          cache object, cannot be NULL.
+ *  @param key               key, cannot be NULL.
+ *  @param dst_entry         a copy of entry that fetch by key. it could be NULL.
+ *  @return NULL             didn't find out such entry with the key.
+ *          pointer          points to the entry in the cache (not to dst_entry).
+ *  NOTE:  The cache is only read, so several readers may peek at once while nobody modifies it.
+ *         libcache_promote_entry applies the hit to the LRU list later.
+ */
+void* libcache_peek(const void* libcache, const void* key, void* dst_entry);
+
+/*
+ *  @brief libcache_promote_entry   moves an entry to the head of the LRU list, e.g. for a deferred hit.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry in the cache.
+ *  @return
+ *          LIBCACHE_NOT_FOUND      the entry isn't in the cache (any more).
+ *          LIBCACHE_SUCCESS        the entry was moved.
+ */
+libcache_ret_t libcache_promote_entry(void* libcache, void* entry);
+
 /*
  *  @brief libcache_add         attempts to add an entry with a given key.
  *
@@ -58,6 +260,71 @@ void* libcache_lookup(void* libcache, const void* key, void* dst_entry);
  */
 void* libcache_add(void * libcache, const void* key, const void* src_entry);
 
+/*
+ *  @brief libcache_get_or_add  looks up the entry with a given key and adds it if it isn't in the cache,
+ *                              the key is hashed once and its bucket chain walked once.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param key                  key, cannot be NULL.
+ *  @param init_entry           entry copied into the cache when the key is added, it could be NULL.
+ *  @param inserted             output, TRUE if the entry was added, FALSE if it was found. it could be NULL.
+ *  @return NULL                the key wasn't found and could not be added because all entries are locked.
+ *          pointer             points to the entry with the key.
+ *  NOTE:   The returned entry is locked either way, libcache_unlock_entry should be called when the entry
+ *          is not being used this time. A found entry is moved to the head of the LRU list like by libcache_lookup.
+ */
+void* libcache_get_or_add(void * libcache, const void* key, const void* init_entry, int* inserted);
+
+/*
+ *  @brief libcache_put         adds an entry with a given key or overwrites the entry of the key in place.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param key                  key, cannot be NULL.
+ *  @param src_entry            entry with the value to store, cannot be NULL.
+ *  @param flags                LIBCACHE_PUT_NO_PROMOTE | LIBCACHE_PUT_REPLACE, or 0.
+ *  @return
+ *          LIBCACHE_NOT_FOUND  LIBCACHE_PUT_REPLACE is set and no entry has the key.
+ *          LIBCACHE_FULL       the key could not be added because all entries are locked.
+ *          LIBCACHE_SUCCESS    the entry was stored.
+ *  NOTE:   An existing entry is overwritten even if it's locked, its slot and key aren't touched.
+ *          The entry isn't locked after the call.
+ */
+libcache_ret_t libcache_put(void * libcache, const void* key, const void* src_entry, int flags);
+
+/*
+ *  @brief libcache_add_batch   adds entries, like libcache_add with src_entry for each key.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param keys                 count keys, key i is at (char*) keys + i * key_size, cannot be NULL.
+ *  @param src_entries          count entries, entry i is at (char*) src_entries + i * entry_size, cannot be NULL.
+ *  @param count                number of keys.
+ *  @param results              output, count results, it could be NULL.
+ *          LIBCACHE_FAILURE    an entry with the same key is existing (or was added before in the batch).
+ *          LIBCACHE_FULL       all entries are locked, nothing could be swapped out.
+ *          LIBCACHE_SUCCESS    the entry was added.
+ *  @return                     number of entries added.
+ *  NOTE:   Keys are handled in groups, the buckets of a group are prefetched before its chains are walked.
+ */
+libcache_scale_t libcache_add_batch(void * libcache, const void* keys, const void* src_entries,
+        libcache_scale_t count, libcache_ret_t results[]);
+
+/*
+ *  @brief libcache_delete_batch    deletes entries, like libcache_delete_by_key for each key.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param keys                     count keys, key i is at (char*) keys + i * key_size, cannot be NULL.
+ *  @param count                    number of keys.
+ *  @param results                  output, count results, it could be NULL.
+ *          LIBCACHE_NOT_FOUND      entry wasn't found.
+ *          LIBCACHE_LOCKED         the entry was unable to deleted because it's locked.
+ *          LIBCACHE_SUCCESS        the entry was deleted successfully.
+ *  @return                         number of entries deleted.
+ *  NOTE:   Keys are handled in groups, the buckets of a group are prefetched before its chains are walked,
+ *          the records deleted in a group go back to their pools together.
+ */
+libcache_scale_t libcache_delete_batch(void * libcache, const void* keys, libcache_scale_t count,
+        libcache_ret_t results[]);
+
 /*
  *  @brief libcache_delete_by_key attempts to delete an entry with a given key.
  *
@@ -112,6 +379,192 @@ libcache_scale_t libcache_get_max_entry_number(const void * libcache);
  */
 libcache_scale_t libcache_get_entry_number(const void * libcache);
 
+/*
+ *  @brief libcache_resize          changes the maximum number of entries of a cache in use.
+ *
+ *  @param libcache                 cache object, cannot be NULL, it cannot be a shared one.
+ *  @param max_entry_number         the new maximum entry number.
+ *  @return
+ *      LIBCACHE_FAILURE            the cache is shared, or memory for the new capacity can't be had.
+ *      LIBCACHE_LOCKED             the work of the last resize isn't finished, see libcache_resize_step.
+ *      LIBCACHE_SUCCESS            the new maximum is in force, entries above it are swapped out
+ *                                  and memory not needed is returned in slices by the next calls
+ *                                  of libcache_add, libcache_delete_by_key and libcache_resize_step.
+ */
+libcache_ret_t libcache_resize(void * libcache, libcache_scale_t max_entry_number);
+
+/*
+ *  @brief libcache_resize_step     does one bounded slice of the work left by libcache_resize.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @return
+ *      LIBCACHE_LOCKED             work is left, locked entries keep their chunk until they are unlocked.
+ *      LIBCACHE_SUCCESS            the resize is finished.
+ */
+libcache_ret_t libcache_resize_step(void * libcache);
+
+/*
+ *  @brief libcache_set_clock       sets the tick stamped on entries when they are added or looked up.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param now                      current tick, e.g. seconds, it may wrap around.
+ */
+void libcache_set_clock(void * libcache, uint32_t now);
+
+/*
+ *  @brief libcache_set_expiry      sets the tick at which an entry expires, see libcache_expire.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @param expiry                   the tick, 0: never (the default of a new entry).
+ *  @return
+ *      LIBCACHE_NOT_FOUND          the entry isn't in the cache (any more).
+ *      LIBCACHE_SUCCESS            the expiry was set.
+ */
+libcache_ret_t libcache_set_expiry(void * libcache, void* entry, uint32_t expiry);
+
+/*
+ *  @brief libcache_set_tag         sets a tag of an entry, e.g. its service group or gateway, see libcache_count_tags.
+ *                                  The entries of a tag other than 0 are linked, see libcache_foreach_tag.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @param tag                      the tag, 0 for a new entry.
+ *  @return
+ *      LIBCACHE_NOT_FOUND          the entry isn't in the cache (any more).
+ *      LIBCACHE_SUCCESS            the tag was set.
+ */
+libcache_ret_t libcache_set_tag(void * libcache, void* entry, uint8_t tag);
+
+/*
+ *  @brief libcache_expire          deletes the unlocked entries whose expiry is now or before,
+ *                                  or which were not accessed for more than max_idle ticks.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param now                      current tick.
+ *  @param max_idle                 ticks since the last add or lookup, 0: entries don't expire by idling.
+ *  @return                         the number of entries deleted.
+ *  NOTE:   free_entry isn't called, like for the entries swapped out by libcache_add.
+ *          The ticks may wrap, an expiry is in the future while it's less than 2^31 ticks after now.
+ */
+libcache_scale_t libcache_expire(void * libcache, uint32_t now, uint32_t max_idle);
+
+/*
+ *  @brief libcache_count_tags      counts the entries by their tag.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param counts                   output, counts[tag] is the number of entries with the tag.
+ *  @return
+ *      LIBCACHE_SUCCESS            counts was filled.
+ */
+libcache_ret_t libcache_count_tags(const void * libcache, libcache_scale_t counts[256]);
+
+/*
+ *  @brief libcache_count_by_tag    gets the number of entries with a tag, it's kept up to date by the cache.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param tag                      the tag.
+ *  @return                         the number, 0 if libcache is NULL.
+ */
+libcache_scale_t libcache_count_by_tag(const void * libcache, uint8_t tag);
+
+/*
+ *  @brief libcache_foreach_tag     visits the entries with a tag, in time proportional to their number.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param tag                      the tag, not 0: untagged entries aren't indexed.
+ *  @param callback                 called for each entry with the tag, cannot be NULL.
+ *                                  It must not add or delete entries, nor change tags.
+ *  @param arg                      passed to callback.
+ *  @return                         the number of entries visited.
+ */
+libcache_scale_t libcache_foreach_tag(const void * libcache, uint8_t tag, LIBCACHE_SCAN_ENTRY* callback, void* arg);
+
+/*
+ *  @brief libcache_delete_by_tag   deletes the unlocked entries with a tag, e.g. the sessions of a gateway
+ *                                  which went down, in time proportional to the number of entries with the tag.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param tag                      the tag, not 0: untagged entries aren't indexed.
+ *  @return                         the number of entries deleted, locked entries keep the tag.
+ *  NOTE:   free_entry isn't called, like for the entries swapped out by libcache_add.
+ */
+libcache_scale_t libcache_delete_by_tag(void * libcache, uint8_t tag);
+
+/*
+ *  @brief libcache_scan        visits the entries of a slice of the index, the scan is resumed by the cursor
+ *                              returned, until it returns 0.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param cursor               0 to start a scan, else the cursor returned by the previous call.
+ *  @param max_items            the call returns once about max_items entries, or ten times as many
+ *                              empty buckets, were visited. A bucket is always visited as a whole.
+ *  @param callback             called for each entry visited, cannot be NULL.
+ *  @param arg                  passed to callback.
+ *  @return                     cursor of the next call, 0 when the scan is done.
+ *  NOTE:   The cache may be changed and resized between two calls. An entry in the cache for the whole
+ *          scan is visited at least once, one added or deleted meanwhile may be visited or not.
+ *          callback must not add or delete entries.
+ */
+uint32_t libcache_scan(const void * libcache, uint32_t cursor, libcache_scale_t max_items,
+        LIBCACHE_SCAN_ENTRY* callback, void* arg);
+
+/*
+ *  @brief libcache_add_secondary   adds a secondary index, which finds an entry by a key kept inside the entry,
+ *                                  e.g. the F-TEID of a session cached by its IMSI.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param key_offset               offset of the key in an entry, bytes.
+ *  @param key_size                 size of the key, bytes, key_offset + key_size isn't larger than entry_size.
+ *  @param cmp_key                  function to compare two keys, only LIBCACHE_EQU is used.
+ *  @param key_to_number            function to translate key to a number, all 32 bits are used.
+ *  @return                         id of the index, -1 on failure, e.g. for a shared cache
+ *                                  or if LIBCACHE_MAX_SECONDARIES indexes exist.
+ *  NOTE:   The entries in the cache are indexed by their current content. Adds with a source entry,
+ *          libcache_put, deletes, swaps and libcache_resize keep every index up to date in the same call.
+ *          An entry added without a source, or whose key is changed in place, is indexed
+ *          by libcache_link_secondary. Several entries may have the same secondary key.
+ */
+int libcache_add_secondary(void * libcache, size_t key_offset, size_t key_size,
+        LIBCACHE_CMP_KEY* cmp_key, LIBCACHE_KEY_TO_NUMBER* key_to_number);
+
+/*
+ *  @brief libcache_link_secondary  indexes an entry again by the keys in it, after it was written in place.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @return
+ *      LIBCACHE_NOT_FOUND          the entry isn't in the cache (any more).
+ *      LIBCACHE_SUCCESS            the entry is in every secondary index by its current keys.
+ */
+libcache_ret_t libcache_link_secondary(void * libcache, void* entry);
+
+/*
+ *  @brief libcache_lookup_secondary    looks up an entry by the key of a secondary index, like libcache_lookup.
+ *
+ *  @param libcache                     cache object, cannot be NULL.
+ *  @param secondary                    id returned by libcache_add_secondary.
+ *  @param key                          key, cannot be NULL.
+ *  @param dst_entry                    a copy of entry that fetch by key. it could be NULL.
+ *  @return NULL                        didn't find out such entry with the key.
+ *          pointer                     points to an entry with the key.
+ *  NOTE:  The entry in cache will be locked if dst_entry is NULL, libcache_unlock_entry unlocks it.
+ */
+void* libcache_lookup_secondary(void * libcache, int secondary, const void* key, void* dst_entry);
+
+/*
+ *  @brief libcache_delete_by_secondary    deletes the entry of a key of a secondary index, like libcache_delete_by_key.
+ *
+ *  @param libcache                        cache object, cannot be NULL.
+ *  @param secondary                       id returned by libcache_add_secondary.
+ *  @param key                             key, cannot be NULL.
+ *  @return
+ *          LIBCACHE_NOT_FOUND             entry wasn't found.
+ *          LIBCACHE_LOCKED                the entry was unable to deleted because it's locked.
+ *          LIBCACHE_SUCCESS               the entry was deleted from the cache and all its indexes.
+ */
+libcache_ret_t libcache_delete_by_secondary(void * libcache, int secondary, const void* key);
+
 /*
  *  @brief libcache_clean         attempts to delete all entries.
  *
@@ -0,0 +1,400 @@
+/*
+ * libcache_coro.hpp
+ *
+ *  C++20 coroutine interface over the sharded cache (libshard.h).
+ *
+ *      libcache::executor exec(shards);
+ *      libcache::async_cache<key_t, entry_t> cache(shards, exec);
+ *      exec.spawn([&]() -> libcache::task<void> {
+ *          std::optional<entry_t> entry = co_await cache.lookup(key);
+ *          libcache_ret_t ret = co_await cache.add(key, value);
+ *      }());
+ *      exec.run();
+ *
+ *  In owner mode an operation is queued on the ring of its shard and the coroutine
+ *  is suspended; the executor resumes the completed ones in batches. Otherwise the
+ *  operation runs at once under the shard lock and the coroutine does not suspend.
+ *  The C interface is only wrapped, nothing of its ABI changes.
+ */
+
+#ifndef LIBCACHE_CORO_HPP_
+#define LIBCACHE_CORO_HPP_
+
+#include <sched.h>
+
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "libshard.h"
+
+namespace libcache {
+
+template <typename T>
+class task;
+
+namespace detail {
+
+struct promise_base {
+    std::coroutine_handle<> continuation;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct promise : promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+    void return_value(T v) { value = std::move(v); }
+    T result() { return std::move(*value); }
+};
+
+template <>
+struct promise<void> : promise_base {
+    task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+    void result() noexcept {}
+};
+
+} // namespace detail
+
+/* A lazily started coroutine, it runs when it is awaited or spawned on an executor. */
+template <typename T>
+class task {
+public:
+    using promise_type = detail::promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    explicit task(handle_type handle) noexcept : handle_(handle) {}
+    task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    ~task()
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume() { return handle_.promise().result(); }
+
+    handle_type release() noexcept { return std::exchange(handle_, nullptr); }
+
+private:
+    handle_type handle_;
+};
+
+namespace detail {
+
+template <typename T>
+inline task<T> promise<T>::get_return_object() noexcept
+{
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object() noexcept
+{
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+/* Runs spawned tasks and resumes the coroutines whose requests are completed. */
+class executor {
+public:
+    /* poll_owners: the thread running this executor also owns every shard. */
+    explicit executor(void* shards, bool poll_owners = false)
+        : shards_(shards), poll_owners_(poll_owners) {}
+
+    executor(const executor&) = delete;
+    executor& operator=(const executor&) = delete;
+
+    /* The requests live in the frames, so the queued ones are drained before the frames are destroyed. */
+    ~executor()
+    {
+        drain();
+        for (std::coroutine_handle<> handle : tasks_) {
+            handle.destroy();
+        }
+    }
+
+    void spawn(task<void>&& t)
+    {
+        std::coroutine_handle<> handle = t.release();
+        tasks_.push_back(handle);
+        handle.resume();
+        reap();
+    }
+
+    /* Called by an awaiter: park the coroutine until its request is done,
+     * a request that found the ring full is submitted again by run_once. */
+    void suspend(libshard_request_t* request, bool queued, std::coroutine_handle<> handle)
+    {
+        waiting_.push_back(waiter{request, handle});
+        if (!queued) {
+            unsubmitted_.push_back(request);
+        }
+    }
+
+    /* One round: retry full rings, let owners work, resume completed coroutines in a batch. */
+    std::size_t run_once()
+    {
+        std::size_t i = 0;
+        while (i < unsubmitted_.size()) {
+            if (libshard_submit(shards_, unsubmitted_[i]) == LIBCACHE_SUCCESS) {
+                unsubmitted_[i] = unsubmitted_.back();
+                unsubmitted_.pop_back();
+            } else {
+                i++;
+            }
+        }
+
+        poll_owners();
+
+        batch_.clear();
+        i = 0;
+        while (i < waiting_.size()) {
+            if (libshard_request_done(waiting_[i].request)) {
+                batch_.push_back(waiting_[i].handle);
+                waiting_[i] = waiting_.back();
+                waiting_.pop_back();
+            } else {
+                i++;
+            }
+        }
+        for (std::coroutine_handle<> handle : batch_) {
+            handle.resume();
+        }
+        reap();
+        return batch_.size();
+    }
+
+    /* Runs until no coroutine is waiting, the CPU is yielded while no request completes. */
+    void run()
+    {
+        while (!waiting_.empty()) {
+            if (run_once() == 0) {
+                sched_yield();
+            }
+        }
+    }
+
+    /* Cancels the requests not queued yet and waits for the queued ones, no coroutine is resumed.
+     * Without poll_owners the owner threads must still be polling. */
+    void drain()
+    {
+        for (libshard_request_t* request : unsubmitted_) {
+            std::size_t i = 0;
+            while (waiting_[i].request != request) {
+                i++;
+            }
+            waiting_[i] = waiting_.back();
+            waiting_.pop_back();
+        }
+        unsubmitted_.clear();
+
+        while (!waiting_.empty()) {
+            poll_owners();
+            std::size_t i = 0;
+            while (i < waiting_.size()) {
+                if (libshard_request_done(waiting_[i].request)) {
+                    waiting_[i] = waiting_.back();
+                    waiting_.pop_back();
+                } else {
+                    i++;
+                }
+            }
+            if (!waiting_.empty()) {
+                sched_yield();
+            }
+        }
+    }
+
+    std::size_t pending() const noexcept { return waiting_.size(); }
+
+    void* shards() const noexcept { return shards_; }
+
+    static const int max_batch = 64;
+
+private:
+    struct waiter {
+        libshard_request_t* request;
+        std::coroutine_handle<> handle;
+    };
+
+    void poll_owners()
+    {
+        if (poll_owners_) {
+            int shard;
+            for (shard = 0; shard < libshard_get_shard_count(shards_); shard++) {
+                while (libshard_owner_poll(shards_, shard, max_batch) > 0) {
+                }
+            }
+        }
+    }
+
+    void reap()
+    {
+        std::size_t i = 0;
+        while (i < tasks_.size()) {
+            if (tasks_[i].done()) {
+                tasks_[i].destroy();
+                tasks_[i] = tasks_.back();
+                tasks_.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void* shards_;
+    bool poll_owners_;
+    std::vector<std::coroutine_handle<>> tasks_;
+    std::vector<waiter> waiting_;
+    std::vector<libshard_request_t*> unsubmitted_;
+    std::vector<std::coroutine_handle<>> batch_;
+};
+
+/* Typed view of a sharded cache, Key and Entry must match key_size and entry_size. */
+template <typename Key, typename Entry>
+class async_cache {
+    static_assert(std::is_trivially_copyable<Key>::value, "keys are copied into the cache");
+    static_assert(std::is_trivially_copyable<Entry>::value, "entries are copied into the cache");
+
+public:
+    async_cache(void* shards, executor& exec)
+        : shards_(shards), exec_(exec), owner_mode_(libshard_is_owner_mode(shards) != FALSE) {}
+
+    class operation {
+    public:
+        operation(async_cache& cache, libshard_op_e op, const Key& key, const Entry* entry)
+            : cache_(cache), key_(key)
+        {
+            std::memset(&request_, 0, sizeof(request_));
+            if (entry != nullptr) {
+                std::memcpy(&entry_, entry, sizeof(Entry));
+            }
+            request_.op = op;
+            request_.key = &key_;
+            request_.entry = &entry_;
+        }
+
+        operation(const operation&) = delete;
+        operation& operator=(const operation&) = delete;
+
+        /* Without owners the operation runs right away under the shard lock.
+         * In owner mode a full ring leaves it to the executor, a refused request completes at once. */
+        bool await_ready()
+        {
+            if (!cache_.owner_mode_) {
+                request_.result = run_locked();
+                return true;
+            }
+
+            libcache_ret_t ret = libshard_submit(cache_.shards_, &request_);
+            if (ret == LIBCACHE_FAILURE) {
+                request_.result = LIBCACHE_FAILURE;
+                return true;
+            }
+            queued_ = (ret == LIBCACHE_SUCCESS);
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            cache_.exec_.suspend(&request_, queued_, handle);
+        }
+
+        libcache_ret_t result() const noexcept { return request_.result; }
+        const Entry& entry() const noexcept { return entry_; }
+
+    private:
+        libcache_ret_t run_locked()
+        {
+            switch (request_.op) {
+            case LIBSHARD_OP_LOOKUP:
+                return libshard_lookup(cache_.shards_, &key_, &entry_) ? LIBCACHE_SUCCESS : LIBCACHE_NOT_FOUND;
+            case LIBSHARD_OP_ADD:
+                return libshard_add(cache_.shards_, &key_, &entry_) ? LIBCACHE_SUCCESS : LIBCACHE_FAILURE;
+            case LIBSHARD_OP_DELETE:
+                return libshard_delete_by_key(cache_.shards_, &key_);
+            default:
+                return LIBCACHE_FAILURE;
+            }
+        }
+
+        async_cache& cache_;
+        Key key_;
+        Entry entry_{};
+        libshard_request_t request_;
+        bool queued_ = false;
+    };
+
+    class lookup_operation : public operation {
+    public:
+        lookup_operation(async_cache& cache, const Key& key) : operation(cache, LIBSHARD_OP_LOOKUP, key, nullptr) {}
+
+        std::optional<Entry> await_resume() const
+        {
+            if (this->result() != LIBCACHE_SUCCESS) {
+                return std::nullopt;
+            }
+            return this->entry();
+        }
+    };
+
+    class update_operation : public operation {
+    public:
+        using operation::operation;
+
+        libcache_ret_t await_resume() const noexcept { return this->result(); }
+    };
+
+    /* co_await: the entry of key, std::nullopt when it is not cached. */
+    lookup_operation lookup(const Key& key) { return lookup_operation(*this, key); }
+
+    /* co_await: LIBCACHE_SUCCESS, or LIBCACHE_FAILURE when the key exists. */
+    update_operation add(const Key& key, const Entry& entry) { return update_operation(*this, LIBSHARD_OP_ADD, key, &entry); }
+
+    /* co_await: LIBCACHE_SUCCESS, LIBCACHE_NOT_FOUND or LIBCACHE_LOCKED. */
+    update_operation remove(const Key& key) { return update_operation(*this, LIBSHARD_OP_DELETE, key, nullptr); }
+
+private:
+    void* shards_;
+    executor& exec_;
+    bool owner_mode_;
+};
+
+} // namespace libcache
+
+#endif /* LIBCACHE_CORO_HPP_ */
@@ -17,6 +17,13 @@
  */
 typedef  uint32_t libcache_scale_t;
 
+/* Self-relative pointer: it stores the distance from the field itself
+ * to the target, so a structure stays valid wherever its memory region
+ * is mapped (e.g. a shared memory segment attached by several processes).
+ * 0 stands for NULL.
+ */
+typedef intptr_t offset_ptr_t;
+
 #define TRUE 1
 #define FALSE 0 
 
@@ -48,6 +55,7 @@ typedef void* LIBCACHE_ALLOCATE_MEMORY(size_t size);
 typedef void LIBCACHE_FREE_MEMORY(void* addr);
 typedef void LIBCACHE_FREE_ENTRY(void* key, void* entry);
 typedef libcache_scale_t LIBCACHE_KEY_TO_NUMBER(const void* key);
+typedef void LIBCACHE_SCAN_ENTRY(const void* key, void* entry, void* arg);
 
 #ifdef DEBUG
 #define DEBUG_INFO(fmt, ...) \
@@ -63,4 +71,28 @@ typedef libcache_scale_t LIBCACHE_KEY_TO_NUMBER(const void* key);
 #define likely(x)       __builtin_expect(!!(x), 1)
 #define unlikely(x)     __builtin_expect(!!(x), 0)
 
+/**
+ * @fn offset_ptr_get
+ *
+ * @brief resolve a self-relative pointer.
+ * @param [in] field - address of the offset_ptr_t field
+ * @return - the pointer, NULL if the field is NULL
+ */
+static inline void* offset_ptr_get(const offset_ptr_t* field)
+{
+    return (0 == *field) ? NULL : (void*) ((intptr_t) field + *field);
+}
+
+/**
+ * @fn offset_ptr_set
+ *
+ * @brief store a pointer into a self-relative field.
+ * @param [in] field   - address of the offset_ptr_t field
+ * @param [in] pointer - the pointer to store, can be NULL
+ */
+static inline void offset_ptr_set(offset_ptr_t* field, const void* pointer)
+{
+    *field = (NULL == pointer) ? 0 : ((intptr_t) pointer - (intptr_t) field);
+}
+
 #endif /* LIBCACHE_DEF_H_ */
@@ -0,0 +1,94 @@
+/*
+ * libcache_index.h
+ *
+ *  Lock-free resizable index (split-ordered list): key -> value.
+ *  Readers and writers never block, the bucket table doubles while they run.
+ */
+
+#ifndef LIBCACHE_INDEX_H_
+#define LIBCACHE_INDEX_H_
+#include "libcache_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  @brief libcache_index_create    creates an index object
+ *
+ *  @param max_entry_number      maximum entry number that this index is able to store.
+ *  @param key_size              size of a key, bytes
+ *  @param allocate_memory       function to allocate memory for this index object, e.g. malloc().
+ *  @param free_memory           function to free whole index object, e.g. free().
+ *  @param cmp_key               function to compare two keys, only LIBCACHE_EQU is used.
+ *  @param key_to_number         function to translate key to a number, all 32 bits are used.
+ *  @return                      pointer of an index object, NULL on failure.
+ */
+void* libcache_index_create(
+        libcache_scale_t max_entry_number,
+        size_t key_size,
+        LIBCACHE_ALLOCATE_MEMORY* allocate_memory,
+        LIBCACHE_FREE_MEMORY* free_memory,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number);
+
+/*
+ *  @brief libcache_index_add    attempts to add a value with a given key, the key is copied.
+ *
+ *  @param index                 index object, cannot be NULL.
+ *  @param key                   key, cannot be NULL.
+ *  @param value                 value to store, it can be NULL.
+ *  @return
+ *      LIBCACHE_FULL            max_entry_number entries are stored.
+ *      LIBCACHE_FAILURE         an entry with the same key is existing.
+ *      LIBCACHE_SUCCESS         the value was added.
+ */
+libcache_ret_t libcache_index_add(void* index, const void* key, void* value);
+
+/*
+ *  @brief libcache_index_lookup    looks up the value of a key.
+ *
+ *  @param index                    index object, cannot be NULL.
+ *  @param key                      key, cannot be NULL.
+ *  @param value                    output, the value of key.
+ *  @return
+ *      LIBCACHE_NOT_FOUND          no entry with the key.
+ *      LIBCACHE_SUCCESS            value was filled.
+ */
+libcache_ret_t libcache_index_lookup(void* index, const void* key, void** value);
+
+/*
+ *  @brief libcache_index_delete    attempts to delete the entry of a key.
+ *
+ *  @param index                    index object, cannot be NULL.
+ *  @param key                      key, cannot be NULL.
+ *  @return
+ *      LIBCACHE_NOT_FOUND          no entry with the key.
+ *      LIBCACHE_SUCCESS            the entry was deleted.
+ */
+libcache_ret_t libcache_index_delete(void* index, const void* key);
+
+/*
+ *  @brief libcache_index_get_entry_number    gets the number of entries, adds in progress are counted.
+ */
+libcache_scale_t libcache_index_get_entry_number(const void* index);
+
+/*
+ *  @brief libcache_index_get_bucket_number   gets the current size of the bucket table.
+ */
+libcache_scale_t libcache_index_get_bucket_number(const void* index);
+
+/*
+ *  @brief libcache_index_destroy    destroys the index, no other thread may use it any more.
+ *
+ *  @param index                     index object, cannot be NULL.
+ *  @return
+ *      LIBCACHE_SUCCESS             the index was destroyed.
+ */
+libcache_ret_t libcache_index_destroy(void* index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBCACHE_INDEX_H_ */
@@ -13,21 +13,47 @@ typedef struct pool_cb_t {
     LIBCACHE_FREE_MEMORY* free_memory;
 } pool_cb_t;
 
+/* Debug builds put a check value in front of every element,
+ * so elements which don't belong to a pool are detected.
+ */
+#if defined(DEBUG) && !defined(LIBPOOL_MAGIC_CHECK)
+#define LIBPOOL_MAGIC_CHECK
+#endif
+
+/* Elements are handed out from the untouched tail first (element_used grows),
+ * the free list is threaded through the elements given back, no per-element node is kept.
+ * It's a stack of element indexes, the tag is bumped by every change so a compare and swap
+ * of the head fails if the head was popped and pushed again meanwhile (ABA).
+ */
 typedef struct element_pool_t {
-    list_t free_list;
-    long long  element_size;
+    uint64_t free_list;         /* | tag:32 | index of the top element:32 |, POOL_NIL: empty */
+    long long element_size;
     long long element_acount;
-} __attribute__((packed)) element_pool_t;
+    long long element_used;
+    long long head_size;
+    long long elements_offset;  /* from the pool head to the head of element 0 */
+} element_pool_t;
 
-typedef struct element_usr_data_t{
-    node_t* to_node;
-    void* reserved_pointer;
-    int check_value;
-} __attribute__((packed)) element_usr_data_t;
+/* A freed entry holds | index of the next freed one:32 | POOL_FREE_POISON:32 | in its first 8 bytes,
+ * users that tell a freed entry from a live one by a field must keep it at POOL_FREE_POISON_OFFSET.
+ */
+#define POOL_FREE_POISON        (0xFFFFFFFFu)
+#define POOL_FREE_POISON_OFFSET (4)
+
+/* Layout of an element: | reserved_pointer (reserved pools only) | check_value (LIBPOOL_MAGIC_CHECK) | entry | */
+typedef struct element_head_t {
+    offset_ptr_t reserved_pointer;
+#ifdef LIBPOOL_MAGIC_CHECK
+    long long check_value;
+#endif
+} element_head_t;
 
 typedef struct pool_attr_t {
     size_t entry_size;
     libcache_scale_t entry_acount;
+    int reserved;               /* TRUE: elements keep a reserved pointer, see pool_set_reserved_pointer */
+    size_t alignment;           /* of every entry: 8 (or 0), 16, 64 ..., rounded up to a power of two.
+                                   64 keeps two entries off one cache line. */
 } pool_attr_t;
 
 typedef enum {
@@ -40,15 +66,43 @@ typedef enum {
     POOL_TYPE_HASH_T,
     POOL_TYPE_BUCKET_T,
     POOL_TYPE_HASH_DATA_T,
+    POOL_TYPE_META_T,
     POOL_TYPE_MAX,
 } pool_type_e;
 
+/* Occupancy of one pool */
+typedef struct pool_stats_t {
+    size_t element_size;        /* bytes per element, head and padding included */
+    long long capacity;
+    long long used;             /* handed out and not freed */
+    long long touched;          /* handed out at least once, so their pages are faulted in */
+    size_t bytes;               /* the pool head, padding and elements */
+} pool_stats_t;
+
 size_t pool_caculate_total_length(int pool_acount, pool_attr_t pool_attr[]);
 
+/**
+ * @fn pool_caculate_length
+ *
+ * @brief get the memory size of one pool in pools, as counted by pool_caculate_total_length.
+ * @param [in] pool_attr - describe the entry size and entry count of pool
+ * @return - size in bytes, the pointer to the pool not included
+ */
+size_t pool_caculate_length(const pool_attr_t* pool_attr);
+
+/**
+ * @fn pool_caculate_element_length
+ *
+ * @brief get the memory size of one element of a pool.
+ * @param [in] pool_attr - describe the entry size and entry count of pool
+ * @return - size in bytes, head and padding included
+ */
+size_t pool_caculate_element_length(const pool_attr_t* pool_attr);
+
 /**
  * @fn pools_init
  *
- * @brief Init memory to pool..
+ * @brief Init memory to pool, only the pool heads are written, elements are set up when they are first taken.
  * @param [in] large_memory   - a memory pointer
  * @param [in] large_mem_size - size of the memory
  * @param [in] pool_count     - count of pools
@@ -68,6 +122,51 @@ void* pools_init(void* large_memory, size_t large_mem_size, int pool_count, pool
  */
 void* pool_get_element(void* pools, int pool_type);
 
+/**
+ * @fn pool_get_used_element
+ *
+ * @brief get an element which was handed out before by its index, e.g. to walk all of them.
+ * @param [in] pools     - pools handle
+ * @param [in] pool_type - the type of pool
+ * @param [in] index     - index of the element, the elements taken so far have 0 .. n - 1
+ * @return -  the element, it may be free again. NULL when it has never been handed out
+ */
+void* pool_get_used_element(void* pools, int pool_type, long long index);
+
+/**
+ * @fn pool_get_touched_count
+ *
+ * @brief get how many elements were handed out at least once, they are the elements 0 .. n - 1.
+ *        The others were never written, their memory may hold anything.
+ * @param [in] pools     - pools handle
+ * @param [in] pool_type - the type of pool
+ * @return -  the count
+ */
+long long pool_get_touched_count(void* pools, int pool_type);
+
+/**
+ * @fn pool_get_elements
+ *
+ * @brief get where the elements of a pool are, element i is at (char*) base + i * element_size.
+ *        E.g. to link elements by their index instead of a pointer.
+ * @param [in] pools          - pools handle
+ * @param [in] pool_type      - the type of pool
+ * @param [out] element_size  - distance between two elements
+ * @return -  the base, element 0
+ */
+void* pool_get_elements(void* pools, int pool_type, size_t* element_size);
+
+/**
+ * @fn pool_get_stats
+ *
+ * @brief get the occupancy of a pool, the free list is walked so it takes O(free elements).
+ *        Not for pools in use by pool_magazine_* functions of other threads.
+ * @param [in] pools      - pools handle
+ * @param [in] pool_type  - the type of pool
+ * @param [out] stats     - the occupancy
+ */
+void pool_get_stats(void* pools, int pool_type, pool_stats_t* stats);
+
 /**
  * @fn pool_free_element
  *
@@ -78,11 +177,122 @@ void* pool_get_element(void* pools, int pool_type);
  */
 void pool_free_element(void* pools, int pool_type, void* element);
 
+/**
+ * @fn pool_free_elements
+ *
+ * @brief free used elements of one pool together, they are linked first and put on the free list at once.
+ * @param [in] pools     - pools handle
+ * @param [in] pool_type - the type of pool
+ * @param [in] elements  - the elements to free, none of them is NULL
+ * @param [in] count     - number of elements
+ */
+void pool_free_elements(void* pools, int pool_type, void* elements[], int count);
+
+/* Magazines: each thread keeps a small stack of free elements per pool,
+ * refilled from and flushed to the free list of the pool (the depot) in batches, lock free.
+ * A pool shared by threads is used only through the pool_magazine_* functions,
+ * pool_get_element / pool_free_element change the free list with plain stores.
+ */
+
+/**
+ * @fn pool_magazine_get_element
+ *
+ * @brief get an unused element memory from the magazine of this thread, the depot refills it when empty.
+ * @param [in] pools     - pools handle
+ * @param [in] pool_type - the type of pool
+ * @return -  a point to element memory (NULL for failed)
+ */
+void* pool_magazine_get_element(void* pools, int pool_type);
+
+/**
+ * @fn pool_magazine_free_element
+ *
+ * @brief free an used element memory to the magazine of this thread, half of a full one goes back to the depot.
+ * @param [in] pools     - pools handle
+ * @param [in] pool_type - the type of pool
+ * @param [in] element   - the element to free, it may have been taken by another thread
+ */
+void pool_magazine_free_element(void* pools, int pool_type, void* element);
+
+/**
+ * @fn pool_magazine_flush
+ *
+ * @brief give the elements in the magazine of this thread back to the depot.
+ *        Every thread which used a pool flushes it before the thread exits or the pool memory is released.
+ * @param [in] pools     - pools handle
+ * @param [in] pool_type - the type of pool
+ */
+void pool_magazine_flush(void* pools, int pool_type);
+
+/* Size classes: one pool per power of two from POOL_CLASS_MIN_SIZE to POOL_CLASS_MAX_SIZE,
+ * for payloads of variable length, e.g. strings kept next to the cache in one arena region.
+ * | pool_classes_t | offset_ptr_t pools[POOL_CLASS_COUNT] | pool 16 | pool 32 | ... | pool 4096 |
+ */
+#define POOL_CLASS_MIN_SIZE (16)
+#define POOL_CLASS_MAX_SIZE (4096)
+#define POOL_CLASS_COUNT    (9)
+
+typedef struct pool_class_stats_t {
+    size_t entry_size;
+    libcache_scale_t capacity;
+    libcache_scale_t in_use;
+    libcache_scale_t peak;      /* most elements in use at once */
+    libcache_scale_t failures;  /* allocations of this size which found this class and all larger ones full */
+} pool_class_stats_t;
+
+/**
+ * @fn pool_classes_caculate_length
+ *
+ * @brief get the memory size of the size classes.
+ * @param [in] class_acount - element count of each class, from POOL_CLASS_MIN_SIZE up
+ * @return - size in bytes for pool_classes_init
+ */
+size_t pool_classes_caculate_length(const libcache_scale_t class_acount[POOL_CLASS_COUNT]);
+
+/**
+ * @fn pool_classes_init
+ *
+ * @brief Init memory to size classes, the memory may be shared by processes.
+ * @param [in] memory       - a memory pointer, 8 bytes aligned at least
+ * @param [in] memory_size  - size of the memory
+ * @param [in] class_acount - element count of each class, from POOL_CLASS_MIN_SIZE up
+ * @return - classes handle, NULL when failed
+ */
+void* pool_classes_init(void* memory, size_t memory_size, const libcache_scale_t class_acount[POOL_CLASS_COUNT]);
+
+/**
+ * @fn pool_alloc
+ *
+ * @brief get memory of at least size bytes, 16 bytes aligned, from the smallest class with a free element.
+ * @param [in] classes - classes handle
+ * @param [in] size    - bytes wanted, POOL_CLASS_MAX_SIZE at most
+ * @return - the memory, NULL when size is too large or the classes are full
+ */
+void* pool_alloc(void* classes, size_t size);
+
+/**
+ * @fn pool_free
+ *
+ * @brief give back memory returned by pool_alloc, its class is found by the address.
+ * @param [in] classes - classes handle
+ * @param [in] element - the memory to free
+ */
+void pool_free(void* classes, void* element);
+
+/**
+ * @fn pool_get_class_stats
+ *
+ * @brief get the occupancy of every class.
+ * @param [in] classes - classes handle
+ * @param [out] stats  - one per class, from POOL_CLASS_MIN_SIZE up
+ */
+void pool_get_class_stats(void* classes, pool_class_stats_t stats[POOL_CLASS_COUNT]);
+
 /**
  * @fn pool_set_reserved_pointer
  *
  * @brief set a pointer value to the reservation of element
- * @param [in] element   - the element address
+ * @param [in] element   - the element address, taken from a pool created with reserved = TRUE
  * @param [in] to_set    - the pointer to set
  * @return -  OK / ERR
  */
@@ -92,7 +302,7 @@ return_t pool_set_reserved_pointer(void* element, void* to_set);
  * @fn pool_get_reserved_pointer
  *
  * @brief get a pointer value to the reservation of element
- * @param [in] element   - the element address
+ * @param [in] element   - the element address, taken from a pool created with reserved = TRUE
  * @return - the pointer
  */
 void* pool_get_reserved_pointer(void* element);
@@ -0,0 +1,195 @@
+/*
+ * libshard.h
+ *
+ *  A cache split into shards, each shard is a libcache object with its own lock
+ *  and its own memory region placed on a NUMA node.
+ */
+
+#ifndef LIBSHARD_H_
+#define LIBSHARD_H_
+#include "libcache_def.h"
+#include "libcache.h"
+#include "libarena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    LIBSHARD_ROUTE_BY_KEY,      /* shard = key number % shard count */
+    LIBSHARD_ROUTE_LOCAL_NODE,  /* shard among the ones on the caller's NUMA node, for keys partitioned by RSS queue */
+} libshard_route_e;
+
+typedef struct libshard_attr_t {
+    int shard_count;
+    libcache_scale_t max_entry_number;   /* per shard */
+    size_t entry_size;
+    size_t key_size;
+    LIBCACHE_FREE_ENTRY* free_entry;
+    LIBCACHE_CMP_KEY* cmp_key;
+    LIBCACHE_KEY_TO_NUMBER* key_to_number;
+    int numa_node_count;                 /* 0: detect, > 0: simulate this many nodes */
+    libshard_route_e route;
+    int owner_mode;                      /* TRUE: every shard is only touched by its owner thread */
+    unsigned int ring_size;              /* owner mode: request slots per shard, power of 2 */
+    int deferred_promotion;              /* TRUE: copying lookups share the lock, hits reach the LRU list in batches */
+    unsigned int hot_threshold;          /* lookups of a key in a window making it hot, 0: no replication */
+    unsigned int hot_window;             /* lookups of a shard per window, 0: default */
+    arena_pages_e pages;                 /* pages of the shard memory, smaller ones when they can't be had */
+    int populate;                        /* ARENA_PREFAULT | ARENA_MLOCK the shard memory at create, 0: on first use */
+} libshard_attr_t;
+
+typedef enum {
+    LIBSHARD_OP_LOOKUP,                  /* copy the entry of key into entry */
+    LIBSHARD_OP_ADD,                     /* add key with a copy of entry */
+    LIBSHARD_OP_DELETE,                  /* delete key */
+} libshard_op_e;
+
+/* Owner mode request, the submitter keeps it, key and entry alive until it is done. */
+typedef struct libshard_request_t {
+    libshard_op_e op;
+    const void* key;
+    void* entry;
+    libcache_ret_t result;               /* LIBCACHE_FAILURE for an add means the key exists */
+    int done;
+    void* user_data;
+} libshard_request_t;
+
+typedef struct libshard_shard_info_t {
+    int numa_node;
+    int numa_bound;                      /* TRUE when the memory policy was applied to the shard memory */
+    arena_report_t memory;               /* pages of the shard memory, why the wanted ones weren't used */
+    libcache_scale_t entry_number;
+    libcache_scale_t max_entry_number;
+    int replica_number;                  /* copies of hot keys of the shard, over all nodes */
+} libshard_shard_info_t;
+
+/*
+ *  @brief libshard_create    creates a sharded cache, shard i is placed on NUMA node i % node count.
+ *
+ *  @param attr               shard count, per-shard capacity, entry/key sizes, callbacks and placement.
+ *  @return                   pointer of a sharded cache object, NULL on failure.
+ */
+void* libshard_create(const libshard_attr_t* attr);
+
+/*
+ *  @brief libshard_destroy   destroys all the shards.
+ *
+ *  @param shards             sharded cache object, cannot be NULL.
+ *  @return
+ *      LIBCACHE_SUCCESS      all the shards were destroyed.
+ */
+libcache_ret_t libshard_destroy(void* shards);
+
+/*
+ *  @brief libshard_bind_thread   declares the NUMA node of the calling thread for LIBSHARD_ROUTE_LOCAL_NODE.
+ *
+ *  @param numa_node              node id, -1 to ask the kernel for the node of the current CPU.
+ */
+void libshard_bind_thread(int numa_node);
+
+/*
+ *  @brief libshard_route     gets the shard that owns a key.
+ *
+ *  @param shards             sharded cache object, cannot be NULL.
+ *  @param key                key, cannot be NULL.
+ *  @return                   shard index.
+ */
+int libshard_route(const void* shards, const void* key);
+
+/*
+ *  @brief libshard_lookup, libshard_add, libshard_get_or_add, libshard_put, libshard_delete_by_key,
+ *         libshard_delete_entry, libshard_unlock_entry
+ *         same as libcache_*, the operation runs on the shard of the key (or of the entry) under its lock.
+ *  NOTE:  With deferred_promotion a lookup with dst_entry takes the shard lock shared and records the hit
+ *         in a small per-thread buffer, the next writer of the shard moves the recorded entries to the head
+ *         of its LRU list. Hits are dropped while the buffer is full.
+ *  NOTE:  With hot_threshold a key looked up that many times in a window of its shard is copied into
+ *         a replica set on every NUMA node. Copying lookups of it are then served from the caller's node
+ *         without the shard lock. Any write to the shard of the key (add, delete, locking lookup, unlock)
+ *         drops its replicas, and a replica hit less than hot_threshold times in a window is torn down.
+ *         Replication is not used in owner mode.
+ */
+void* libshard_lookup(void* shards, const void* key, void* dst_entry);
+void* libshard_add(void* shards, const void* key, const void* src_entry);
+void* libshard_get_or_add(void* shards, const void* key, const void* init_entry, int* inserted);
+libcache_ret_t libshard_put(void* shards, const void* key, const void* src_entry, int flags);
+libcache_ret_t libshard_delete_by_key(void* shards, const void* key);
+libcache_ret_t libshard_delete_entry(void* shards, void* entry);
+libcache_ret_t libshard_unlock_entry(void* shards, void* entry);
+
+/*
+ *  @brief libshard_get_entry_number     gets the number of entries stored in all shards.
+ *
+ *  @param shards                        sharded cache object, cannot be NULL.
+ *  @return                              the number
+ *  NOTE:  In owner mode it's the number published by the owners after their last batch.
+ */
+libcache_scale_t libshard_get_entry_number(void* shards);
+
+/*
+ *  @brief libshard_get_shard_count      gets the number of shards.
+ */
+int libshard_get_shard_count(const void* shards);
+
+/*
+ *  @brief libshard_is_owner_mode        tells whether the shards were created in owner mode.
+ *
+ *  @param shards                        sharded cache object.
+ *  @return                              TRUE: requests go through libshard_submit, FALSE: the lock based API is used.
+ */
+int libshard_is_owner_mode(const void* shards);
+
+/*
+ *  @brief libshard_get_shard_info       gets placement and usage of one shard.
+ *
+ *  @param shards                        sharded cache object, cannot be NULL.
+ *  @param shard_index                   shard index.
+ *  @param info                          output.
+ *  @return
+ *      LIBCACHE_NOT_FOUND               no such shard.
+ *      LIBCACHE_SUCCESS                 info was filled.
+ *  NOTE:  In owner mode entry_number is the one published by the owner after its last batch.
+ */
+libcache_ret_t libshard_get_shard_info(void* shards, int shard_index, libshard_shard_info_t* info);
+
+/*
+ *  @brief libshard_clean                attempts to delete all entries of all shards.
+ */
+libcache_ret_t libshard_clean(void* shards);
+
+/*
+ *  @brief libshard_submit    queues a request to the owner of the shard of its key (owner mode only).
+ *
+ *  @param shards             sharded cache object, cannot be NULL.
+ *  @param request            request to queue, key cannot be NULL.
+ *  @return
+ *      LIBCACHE_SUCCESS      queued, libshard_request_done tells when the result is ready.
+ *      LIBCACHE_FULL         the ring of the shard is full, try again later.
+ *      LIBCACHE_FAILURE      not in owner mode or invalid request.
+ *  NOTE:  The lock based libshard_lookup/add/delete/unlock functions are refused in owner mode.
+ */
+libcache_ret_t libshard_submit(void* shards, libshard_request_t* request);
+
+/*
+ *  @brief libshard_request_done    tells whether the owner has completed a request.
+ *
+ *  @param request                  a submitted request.
+ *  @return                         TRUE when result is ready.
+ */
+int libshard_request_done(const libshard_request_t* request);
+
+/*
+ *  @brief libshard_owner_poll    runs a batch of queued requests on a shard, then completes them.
+ *
+ *  @param shards                 sharded cache object, cannot be NULL.
+ *  @param shard_index            the shard owned by the calling thread, only one thread may poll a shard.
+ *  @param max_batch              maximum number of requests handled in this call.
+ *  @return                       number of completed requests.
+ */
+int libshard_owner_poll(void* shards, int shard_index, int max_batch);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LIBSHARD_H_ */
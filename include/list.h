@@ -18,18 +18,66 @@ extern "C" {
 
 typedef struct node_t
 {
-    void *usr_data;
-    struct node_t *previous_node; /* pointer to previous child */
-    struct node_t *next_node; /* pointer to next child */
+    offset_ptr_t usr_data;
+    offset_ptr_t previous_node; /* offset to previous child */
+    offset_ptr_t next_node; /* offset to next child */
 }__attribute__((aligned(8))) node_t;
 
 typedef struct list_t
 {
     unsigned int total_nodes;
-    node_t *head_node;
-    node_t *tail_node;
+    offset_ptr_t head_node;
+    offset_ptr_t tail_node;
 } __attribute__((aligned(8))) list_t;
 
+/**
+ * @fn node_get_usr_data
+ *
+ * @brief Get the user data attached to node.
+ * @param [in] node - node pointer
+ * @return - user data pointer
+ */
+static inline void* node_get_usr_data(const node_t *node)
+{
+    return offset_ptr_get(&node->usr_data);
+}
+
+/**
+ * @fn node_set_usr_data
+ *
+ * @brief Attach user data to node.
+ * @param [in] node     - node pointer
+ * @param [in] usr_data - user data pointer
+ * @return - none
+ */
+static inline void node_set_usr_data(node_t *node, const void* usr_data)
+{
+    offset_ptr_set(&node->usr_data, usr_data);
+}
+
+/**
+ * @fn node_next
+ *
+ * @brief Get the next node.
+ * @param [in] node - node pointer
+ * @return node_t* - the next node, NULL for the last one
+ */
+static inline node_t* node_next(const node_t *node)
+{
+    return (node_t*) offset_ptr_get(&node->next_node);
+}
+
+/**
+ * @fn node_previous
+ *
+ * @brief Get the previous node.
+ * @param [in] node - node pointer
+ * @return node_t* - the previous node, NULL for the first one
+ */
+static inline node_t* node_previous(const node_t *node)
+{
+    return (node_t*) offset_ptr_get(&node->previous_node);
+}
 
 /**
  * @fn list_init
@@ -44,8 +92,8 @@ static inline void list_init(list_t *list)
         return;
     }
     list->total_nodes = 0;
-    list->head_node = NULL;
-    list->tail_node = NULL;
+    list->head_node = 0;
+    list->tail_node = 0;
 }
 
 
@@ -83,7 +131,7 @@ static inline int list_size(const list_t *list)
  */
 static inline node_t* list_front(list_t *list)
 {
-    return (NULL == list) ? NULL : list->head_node;
+    return (NULL == list) ? NULL : (node_t*) offset_ptr_get(&list->head_node);
 }
 
 /**
@@ -95,7 +143,7 @@ static inline node_t* list_front(list_t *list)
  */
 static inline node_t* list_back(list_t *list)
 {
-    return (NULL == list) ? NULL : list->tail_node;
+    return (NULL == list) ? NULL : (node_t*) offset_ptr_get(&list->tail_node);
 }
 
 /**
@@ -115,15 +163,16 @@ static inline void list_push_front(list_t *list, node_t *node)
     }
 
     if (0 == list->total_nodes) {
-        node->previous_node = NULL;
-        node->next_node = NULL;
-        list->head_node = node;
-        list->tail_node = node;
+        node->previous_node = 0;
+        node->next_node = 0;
+        offset_ptr_set(&list->head_node, node);
+        offset_ptr_set(&list->tail_node, node);
     } else {
-        list->head_node->previous_node = node;
-        node->next_node = list->head_node;
-        node->previous_node = NULL;
-        list->head_node = node;
+        node_t *head = (node_t*) offset_ptr_get(&list->head_node);
+        offset_ptr_set(&head->previous_node, node);
+        offset_ptr_set(&node->next_node, head);
+        node->previous_node = 0;
+        offset_ptr_set(&list->head_node, node);
     }
 
     list->total_nodes++;
@@ -144,16 +193,17 @@ static inline void list_push_back(list_t *list, node_t *node)
         return;
     }
     if (0 == list->total_nodes) {
-        node->previous_node = NULL;
-        node->next_node = NULL;
-        list->head_node = node;
-        list->tail_node = node;
+        node->previous_node = 0;
+        node->next_node = 0;
+        offset_ptr_set(&list->head_node, node);
+        offset_ptr_set(&list->tail_node, node);
 
     } else {
-        list->tail_node->next_node = node;
-        node->previous_node = list->tail_node;
-        node->next_node = NULL;
-        list->tail_node = node;
+        node_t *tail = (node_t*) offset_ptr_get(&list->tail_node);
+        offset_ptr_set(&tail->next_node, node);
+        offset_ptr_set(&node->previous_node, tail);
+        node->next_node = 0;
+        offset_ptr_set(&list->tail_node, node);
     }
 
     list->total_nodes++;
@@ -187,25 +237,27 @@ static inline int list_remove(list_t *list, node_t *node)
         return FALSE;
     }
 
-    if (node == list->head_node) {
-        if (list->head_node->next_node) {
-            list->head_node->next_node->previous_node = NULL;
-            list->head_node = list->head_node->next_node;
+    node_t *next = node_next(node);
+    node_t *previous = node_previous(node);
+    if (node == list_front(list)) {
+        if (next) {
+            next->previous_node = 0;
+            offset_ptr_set(&list->head_node, next);
         } else {
-            list->head_node = NULL;
-            list->tail_node = NULL;
+            list->head_node = 0;
+            list->tail_node = 0;
         }
-    } else if (node == list->tail_node) {
-        if (list->tail_node->previous_node) {
-            list->tail_node->previous_node->next_node = NULL;
-            list->tail_node = list->tail_node->previous_node;
+    } else if (node == list_back(list)) {
+        if (previous) {
+            previous->next_node = 0;
+            offset_ptr_set(&list->tail_node, previous);
         } else {
-            list->head_node = NULL;
-            list->tail_node = NULL;
+            list->head_node = 0;
+            list->tail_node = 0;
         }
     } else {
-        node->previous_node->next_node = node->next_node;
-        node->next_node->previous_node = node->previous_node;
+        offset_ptr_set(&previous->next_node, next);
+        offset_ptr_set(&next->previous_node, previous);
     }
 
     list->total_nodes--;
@@ -232,14 +284,15 @@ static inline node_t * list_pop_front(list_t *list)
         return NULL;
     }
 
-    node_t *node_to_be_removed = list->head_node;
+    node_t *node_to_be_removed = (node_t*) offset_ptr_get(&list->head_node);
 
     if (unlikely(1 == list->total_nodes)) {
-        list->head_node = NULL;
-        list->tail_node = NULL;
+        list->head_node = 0;
+        list->tail_node = 0;
     } else {
-        list->head_node->next_node->previous_node = NULL;
-        list->head_node = list->head_node->next_node;
+        node_t *next = node_next(node_to_be_removed);
+        next->previous_node = 0;
+        offset_ptr_set(&list->head_node, next);
     }
 
     list->total_nodes--;
@@ -267,14 +320,15 @@ static inline node_t * list_pop_back(list_t *list)
         return NULL;
     }
 
-    node_t *node_to_be_removed = list->tail_node;
+    node_t *node_to_be_removed = (node_t*) offset_ptr_get(&list->tail_node);
 
     if (unlikely(1 == list->total_nodes)) {
-        list->head_node = NULL;
-        list->tail_node = NULL;
+        list->head_node = 0;
+        list->tail_node = 0;
     } else {
-        list->tail_node->previous_node->next_node = NULL;
-        list->tail_node = list->tail_node->previous_node;
+        node_t *previous = node_previous(node_to_be_removed);
+        previous->next_node = 0;
+        offset_ptr_set(&list->tail_node, previous);
     }
 
     list->total_nodes--;
@@ -335,25 +389,29 @@ node_t * list_reverse_foreach(list_t *list, int (*traverse_node_cb)(node_t *node
  */
 static inline void list_swap_to_head(list_t *list, node_t *node)
 {
+    node_t *head = list_front(list);
     if (1 == list->total_nodes) {
         return;
-    } else if (node == list->head_node) {
+    } else if (node == head) {
         return;
-    } else if (node == list->tail_node) {
-        node->previous_node->next_node = NULL;
-        list->tail_node = node->previous_node;
-        node->next_node = list->head_node;
-        list->head_node->previous_node = node;
-        node->previous_node = NULL;
-        list->head_node = node;
+    } else if (node == list_back(list)) {
+        node_t *previous = node_previous(node);
+        previous->next_node = 0;
+        offset_ptr_set(&list->tail_node, previous);
+        offset_ptr_set(&node->next_node, head);
+        offset_ptr_set(&head->previous_node, node);
+        node->previous_node = 0;
+        offset_ptr_set(&list->head_node, node);
     } else {
-        node->previous_node->next_node = node->next_node;
-        node->next_node->previous_node = node->previous_node;
-
-        node->next_node = list->head_node;
-        list->head_node->previous_node = node;
-        node->previous_node = NULL;
-        list->head_node = node;
+        node_t *previous = node_previous(node);
+        node_t *next = node_next(node);
+        offset_ptr_set(&previous->next_node, next);
+        offset_ptr_set(&next->previous_node, previous);
+
+        offset_ptr_set(&node->next_node, head);
+        offset_ptr_set(&head->previous_node, node);
+        node->previous_node = 0;
+        offset_ptr_set(&list->head_node, node);
     }
 }
 
@@ -0,0 +1,89 @@
+/*
+ * ring.h
+ *
+ *  Bounded lock-free ring of pointers: many producers, one consumer.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include "libcache_def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RING_CACHE_LINE (64)
+
+typedef struct ring_slot_t
+{
+    size_t sequence;
+    void* data;
+} ring_slot_t;
+
+typedef struct ring_t
+{
+    size_t mask;
+    char pad0[RING_CACHE_LINE - sizeof(size_t)];
+    size_t enqueue_pos; /* shared by the producers */
+    char pad1[RING_CACHE_LINE - sizeof(size_t)];
+    size_t dequeue_pos; /* owned by the consumer */
+    char pad2[RING_CACHE_LINE - sizeof(size_t)];
+    ring_slot_t slots[];
+} __attribute__((aligned(RING_CACHE_LINE))) ring_t;
+
+/**
+ * @fn ring_get_memory_size
+ *
+ * @brief memory needed by a ring.
+ * @param [in] slot_count - number of slots, power of 2
+ * @return - size in bytes
+ */
+size_t ring_get_memory_size(unsigned int slot_count);
+
+/**
+ * @fn ring_init
+ *
+ * @brief init a ring in the given memory.
+ * @param [in] memory     - at least ring_get_memory_size() bytes, aligned to RING_CACHE_LINE
+ * @param [in] slot_count - number of slots, power of 2
+ * @return - ring pointer, NULL when slot_count is not a power of 2
+ */
+ring_t* ring_init(void* memory, unsigned int slot_count);
+
+/**
+ * @fn ring_enqueue
+ *
+ * @brief add a pointer at the tail, can be called by many threads at the same time.
+ * @param [in] ring - ring pointer
+ * @param [in] data - pointer to add, cannot be NULL
+ * @return TRUE  - added
+ * @return FALSE - the ring is full
+ */
+int ring_enqueue(ring_t* ring, void* data);
+
+/**
+ * @fn ring_dequeue
+ *
+ * @brief remove the pointer at the head, only one thread may call it.
+ * @param [in] ring - ring pointer
+ * @return - the pointer, NULL when the ring is empty
+ */
+void* ring_dequeue(ring_t* ring);
+
+/**
+ * @fn ring_dequeue_burst
+ *
+ * @brief remove up to max_count pointers at the head, only one thread may call it.
+ * @param [in] ring       - ring pointer
+ * @param [out] data      - removed pointers
+ * @param [in] max_count  - size of data
+ * @return - number of removed pointers
+ */
+int ring_dequeue_burst(ring_t* ring, void* data[], int max_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RING_H_ */
@@ -15,10 +15,10 @@
 
 void hash_free_node(node_t* node, void* pool_handle)
 {
-    hash_data_t* hd = (hash_data_t*) node->usr_data;
+    hash_data_t* hd = (hash_data_t*) node_get_usr_data(node);
     if (hd != NULL) {
-        if (hd->key != NULL) {
-            pool_free_element(pool_handle, POOL_TYPE_KEY_SIZE, hd->key);
+        if (hash_data_get_key(hd) != NULL) {
+            pool_free_element(pool_handle, POOL_TYPE_KEY_SIZE, hash_data_get_key(hd));
         }
         pool_free_element(pool_handle, POOL_TYPE_HASH_DATA_T, hd);
     }
@@ -29,7 +29,7 @@ void hash_free_node(node_t* node, void* pool_handle)
 void* hash_init(size_t key_size, LIBCACHE_CMP_KEY* key_cmp, LIBCACHE_KEY_TO_NUMBER* key_to_num, void *pool_handle)
 {
     hash_t* hash = (hash_t*) pool_get_element(pool_handle, POOL_TYPE_HASH_T);
-    hash->bucket_list = (bucket_t*) pool_get_element(pool_handle, POOL_TYPE_BUCKET_T);
+    offset_ptr_set(&hash->bucket_list, pool_get_element(pool_handle, POOL_TYPE_BUCKET_T));
     hash->entry_count = 0;
     hash->key_size = key_size;
     hash->kcmp = key_cmp;
@@ -38,8 +38,8 @@ void* hash_init(size_t key_size, LIBCACHE_CMP_KEY* key_cmp, LIBCACHE_KEY_TO_NUMB
 
     int i = 0;
     while (i < HASH_BUCKETS) {
-        hash->bucket_list[i].list_count = 0;
-        hash->bucket_list[i].list = NULL;
+        hash_get_bucket(hash, i)->list_count = 0;
+        hash_get_bucket(hash, i)->list = 0;
         i++;
     }
     return hash;
@@ -54,25 +54,29 @@ void* hash_add(void* hash_table, const void* key, void* hash_node, void* cache_n
         return NULL;
     }
     node_t* node = (node_t*) hash_node;
+    hash_data_t* hash_data;
     if (node == NULL) {
         node = (node_t*) pool_get_element(pool_handle, POOL_TYPE_NODE_T);
-        node->usr_data = (hash_data_t*) pool_get_element(pool_handle, POOL_TYPE_HASH_DATA_T);
-        ((hash_data_t*) node->usr_data)->key = pool_get_element(pool_handle, POOL_TYPE_KEY_SIZE);
+        hash_data = (hash_data_t*) pool_get_element(pool_handle, POOL_TYPE_HASH_DATA_T);
+        offset_ptr_set(&hash_data->key, pool_get_element(pool_handle, POOL_TYPE_KEY_SIZE));
+        node_set_usr_data(node, hash_data);
+    } else {
+        hash_data = (hash_data_t*) node_get_usr_data(node);
     }
 
-    memset(((hash_data_t*) node->usr_data)->key, 0, hash->key_size);
-    memcpy(((hash_data_t*) node->usr_data)->key, key, hash->key_size);
+    memset(hash_data_get_key(hash_data), 0, hash->key_size);
+    memcpy(hash_data_get_key(hash_data), key, hash->key_size);
 
-    ((hash_data_t*) node->usr_data)->cache_node_ptr = cache_node;
-    node->next_node = NULL;
-    node->previous_node = NULL;
-    bucket_t* bucket = &(hash->bucket_list[hash_code]);
-    if (bucket->list == NULL) {
-        bucket->list = (list_t*) pool_get_element(pool_handle, POOL_TYPE_LIST_T);
+    offset_ptr_set(&hash_data->cache_node_ptr, cache_node);
+    node->next_node = 0;
+    node->previous_node = 0;
+    bucket_t* bucket = hash_get_bucket(hash, hash_code);
+    if (bucket->list == 0) {
+        offset_ptr_set(&bucket->list, pool_get_element(pool_handle, POOL_TYPE_LIST_T));
         bucket->list_count = 0;
-        list_init(bucket->list);
+        list_init(bucket_get_list(bucket));
     }
-    list_push_back(bucket->list, node);
+    list_push_back(bucket_get_list(bucket), node);
 
     bucket->list_count++;
     hash->entry_count++;
@@ -89,13 +93,13 @@ void* hash_del(void* hash_table, const void* key, void* hash_node, void* pool_ha
         return NULL;
     }
 
-    bucket_t* bucket = &(hash->bucket_list[hash_code]);
-    if (unlikely(bucket->list == NULL)) {
+    bucket_t* bucket = hash_get_bucket(hash, hash_code);
+    if (unlikely(bucket->list == 0)) {
         DEBUG_ERROR("delete hash fail: hash list haven't element");
         return NULL;
     } else {
         node_t* node = (node_t*) hash_node;
-        list_remove(bucket->list, node);
+        list_remove(bucket_get_list(bucket), node);
     }
     bucket->list_count--;
     hash->entry_count--;
@@ -110,15 +114,15 @@ void* hash_find(void* hash_table, const void* key)
         DEBUG_ERROR("hash_find failed: hash key[%d] is invalid", hash_code);
         return NULL;
     }
-    bucket_t* bucket = &(hash->bucket_list[hash_code]);
+    bucket_t* bucket = hash_get_bucket(hash, hash_code);
     node_t* node = NULL;
     if (likely(bucket->list)) {
-        node = bucket->list->head_node;
+        node = list_front(bucket_get_list(bucket));
         while (node) {
-            if (!hash->kcmp(key, ((hash_data_t*) node->usr_data)->key)) {
+            if (!hash->kcmp(key, hash_data_get_key((hash_data_t*) node_get_usr_data(node)))) {
                 break;
             }
-            node = node->next_node;
+            node = node_next(node);
         }
     }
     return node;
@@ -135,19 +139,19 @@ static void hash_release(void* hash_table, int is_destroy, void* pool_handle)
     hash_t* hash = (hash_t*) hash_table;
     int i = 0;
     for (i = 0; i < hash->max_buckets; i++) {
-        bucket_t* bucket = &(hash->bucket_list[i]);
+        bucket_t* bucket = hash_get_bucket(hash, i);
         node_t *bucket_node;
-        if (bucket->list != NULL) {
-            while (NULL != (bucket_node = list_pop_front(bucket->list))) {
+        if (bucket->list != 0) {
+            while (NULL != (bucket_node = list_pop_front(bucket_get_list(bucket)))) {
                 hash_free_node(bucket_node, pool_handle);
             }
-            (void) pool_free_element(pool_handle, POOL_TYPE_LIST_T, bucket->list);
-            bucket->list = NULL;
+            (void) pool_free_element(pool_handle, POOL_TYPE_LIST_T, bucket_get_list(bucket));
+            bucket->list = 0;
             bucket->list_count = 0;
         }
     }
     if (is_destroy) {
-        pool_free_element(pool_handle, POOL_TYPE_BUCKET_T, hash->bucket_list);
+        pool_free_element(pool_handle, POOL_TYPE_BUCKET_T, hash_get_bucket(hash, 0));
         pool_free_element(pool_handle, POOL_TYPE_HASH_T, hash);
     } else {
         hash->entry_count = 0;
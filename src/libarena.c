@@ -0,0 +1,328 @@
+/*
+ * libarena.c
+ *
+ *  Memory regions backing the cache pools.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "libarena.h"
+
+#define ARENA_MPOL_PREFERRED (1)
+#define ARENA_NUMA_MAX_NODES (64)
+#define ARENA_NUMA_ONLINE_PATH "/sys/devices/system/node/online"
+#define ARENA_MAP_HUGE_SHIFT (26)
+#define ARENA_PAGE_SIZE (4096UL)
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB (0x40000)
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE (14)
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE (23)
+#endif
+
+/* "/name" is a POSIX shared memory object, anything with more
+ * directories in it is a file, e.g. on a hugetlbfs mount.
+ */
+static inline int arena_is_file_path(const char* name)
+{
+    return strchr(name + 1, '/') != NULL;
+}
+
+static int arena_open(const char* name, int flags)
+{
+    if (arena_is_file_path(name)) {
+        return open(name, flags, 0600);
+    }
+    return shm_open(name, flags, 0600);
+}
+
+static size_t arena_round_up(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+void* arena_shm_create(const char* name, size_t* size)
+{
+    if (unlikely(name == NULL || name[0] != '/' || size == NULL || *size == 0)) {
+        DEBUG_ERROR("argument %s is invalid.", "name");
+        return NULL;
+    }
+
+    if (arena_is_file_path(name)) {
+        *size = arena_round_up(*size, ARENA_HUGE_PAGE_SIZE);
+    }
+
+    int fd = arena_open(name, O_RDWR | O_CREAT | O_EXCL);
+    if (fd < 0) {
+        DEBUG_ERROR("create %s failed.", name);
+        return NULL;
+    }
+
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, *size) == 0) {
+        addr = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        DEBUG_ERROR("map %s failed.", name);
+        arena_shm_unlink(name);
+        return NULL;
+    }
+    return addr;
+}
+
+void* arena_shm_attach(const char* name, size_t* size)
+{
+    if (unlikely(name == NULL || size == NULL)) {
+        DEBUG_ERROR("input parameter %s is null.", (NULL == name) ? "name" : "size");
+        return NULL;
+    }
+
+    int fd = arena_open(name, O_RDWR);
+    if (fd < 0) {
+        DEBUG_ERROR("open %s failed.", name);
+        return NULL;
+    }
+
+    void* addr = MAP_FAILED;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        DEBUG_ERROR("map %s failed.", name);
+        return NULL;
+    }
+    *size = st.st_size;
+    return addr;
+}
+
+void arena_shm_detach(void* addr, size_t size)
+{
+    if (likely(addr != NULL)) {
+        munmap(addr, size);
+    }
+}
+
+return_t arena_shm_unlink(const char* name)
+{
+    if (unlikely(name == NULL)) {
+        return ERR;
+    }
+    int ret = arena_is_file_path(name) ? unlink(name) : shm_unlink(name);
+    return (ret == 0) ? OK : ERR;
+}
+
+void* arena_alloc(size_t size)
+{
+    if (unlikely(size == 0)) {
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        DEBUG_ERROR("map %zu bytes failed.", size);
+        return NULL;
+    }
+    return addr;
+}
+
+void arena_free(void* addr, size_t size)
+{
+    if (likely(addr != NULL)) {
+        munmap(addr, size);
+    }
+}
+
+static inline void arena_report_reason(arena_report_t* report, const char* reason)
+{
+    if (report != NULL && report->reason == NULL) {
+        report->reason = reason;
+    }
+}
+
+static void* arena_map_hugetlb(size_t size, size_t page_size, int page_shift)
+{
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (page_shift << ARENA_MAP_HUGE_SHIFT), -1, 0);
+    return (addr == MAP_FAILED) ? NULL : addr;
+}
+
+/* Note: THP only backs whole 2M aligned ranges, a plain mmap is aligned to 4K only.
+ *       Map 2M more, then unmap the head and the tail outside the aligned range.
+ */
+static void* arena_map_huge_aligned(size_t size)
+{
+    void* addr = arena_alloc(size + ARENA_HUGE_PAGE_SIZE);
+    if (addr == NULL) {
+        return NULL;
+    }
+
+    size_t head = arena_round_up((uintptr_t) addr, ARENA_HUGE_PAGE_SIZE) - (uintptr_t) addr;
+    if (head > 0) {
+        munmap(addr, head);
+    }
+    munmap((char*) addr + head + size, ARENA_HUGE_PAGE_SIZE - head);
+    return (char*) addr + head;
+}
+
+size_t arena_get_page_size(arena_pages_e pages)
+{
+    switch (pages) {
+    case ARENA_PAGES_HUGE_1G:
+        return ARENA_GIGA_PAGE_SIZE;
+    case ARENA_PAGES_HUGE_2M:
+    case ARENA_PAGES_THP:
+        return ARENA_HUGE_PAGE_SIZE;
+    default:
+        return ARENA_PAGE_SIZE;
+    }
+}
+
+void* arena_alloc_pages(size_t* size, arena_pages_e pages, arena_report_t* report)
+{
+    if (unlikely(size == NULL || *size == 0)) {
+        DEBUG_ERROR("argument %s is invalid.", "size");
+        return NULL;
+    }
+    if (report != NULL) {
+        memset(report, 0, sizeof(arena_report_t));
+    }
+
+    void* addr = NULL;
+    // Note: hugetlb pages come from a pool reserved by the administrator, they fail when it is short
+    if (pages == ARENA_PAGES_HUGE_1G) {
+        size_t huge_size = arena_round_up(*size, ARENA_GIGA_PAGE_SIZE);
+        if (NULL != (addr = arena_map_hugetlb(huge_size, ARENA_GIGA_PAGE_SIZE, 30))) {
+            *size = huge_size;
+        } else {
+            arena_report_reason(report, "no free 1G hugetlb pages");
+            pages = ARENA_PAGES_HUGE_2M;
+        }
+    }
+    if (addr == NULL && pages == ARENA_PAGES_HUGE_2M) {
+        size_t huge_size = arena_round_up(*size, ARENA_HUGE_PAGE_SIZE);
+        if (NULL != (addr = arena_map_hugetlb(huge_size, ARENA_HUGE_PAGE_SIZE, 21))) {
+            *size = huge_size;
+        } else {
+            arena_report_reason(report, "no free 2M hugetlb pages");
+            pages = ARENA_PAGES_THP;
+        }
+    }
+    if (addr == NULL) {
+        *size = arena_round_up(*size, (pages == ARENA_PAGES_THP) ? ARENA_HUGE_PAGE_SIZE : ARENA_PAGE_SIZE);
+        addr = (pages == ARENA_PAGES_THP) ? arena_map_huge_aligned(*size) : arena_alloc(*size);
+        if (NULL == addr) {
+            return NULL;
+        }
+        if (pages == ARENA_PAGES_THP && madvise(addr, *size, MADV_HUGEPAGE) != 0) {
+            arena_report_reason(report, "transparent huge pages are disabled");
+            pages = ARENA_PAGES_DEFAULT;
+        }
+    }
+
+    if (report != NULL) {
+        report->pages = pages;
+    }
+    return addr;
+}
+
+return_t arena_populate(void* addr, size_t size, int flags, arena_report_t* report)
+{
+    if (unlikely(addr == NULL || size == 0)) {
+        DEBUG_ERROR("input parameter %s is null.", (NULL == addr) ? "addr" : "size");
+        return ERR;
+    }
+
+    return_t ret = OK;
+    if (flags & ARENA_MLOCK) {
+        // Note: mlock faults the pages in as well
+        if (mlock(addr, size) == 0) {
+            if (report != NULL) {
+                report->locked = TRUE;
+                report->prefaulted = TRUE;
+            }
+            return ret;
+        }
+        arena_report_reason(report, "mlock refused, see RLIMIT_MEMLOCK");
+        ret = ERR;
+    }
+
+    if (flags & ARENA_PREFAULT) {
+        if (madvise(addr, size, MADV_POPULATE_WRITE) != 0) {
+            // Note: older kernels, write every page with what it holds
+            volatile char* page;
+            for (page = (volatile char*) addr; page < (volatile char*) addr + size; page += ARENA_PAGE_SIZE) {
+                *page = *page;
+            }
+        }
+        if (report != NULL) {
+            report->prefaulted = TRUE;
+        }
+    }
+    return ret;
+}
+
+int arena_numa_node_count(void)
+{
+    // Note: the file looks like "0" or "0-1" or "0,2-3"
+    FILE* file = fopen(ARENA_NUMA_ONLINE_PATH, "r");
+    if (file == NULL) {
+        return 1;
+    }
+
+    int max_node = 0;
+    int node;
+    while (fscanf(file, "%d", &node) == 1) {
+        if (node > max_node) {
+            max_node = node;
+        }
+        if (fgetc(file) == EOF) {
+            break;
+        }
+    }
+    fclose(file);
+    return max_node + 1;
+}
+
+int arena_numa_current_node(void)
+{
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        return 0;
+    }
+    return (int) node;
+}
+
+return_t arena_numa_bind(void* addr, size_t size, int node)
+{
+    if (unlikely(addr == NULL || node < 0 || node >= ARENA_NUMA_MAX_NODES || node >= arena_numa_node_count())) {
+        return ERR;
+    }
+
+    unsigned long node_mask[(ARENA_NUMA_MAX_NODES + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long))];
+    memset(node_mask, 0, sizeof(node_mask));
+    node_mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    // Note: the kernel drops the last bit of maxnode, pass one more as libnuma does
+    if (syscall(SYS_mbind, addr, size, ARENA_MPOL_PREFERRED, node_mask, ARENA_NUMA_MAX_NODES + 1, 0) != 0) {
+        DEBUG_ERROR("mbind to node %d failed.", node);
+        return ERR;
+    }
+    return OK;
+}
@@ -5,28 +5,372 @@
 #include "libcache.h"
 #include "libcache_def.h"
 #include "libpool.h"
-#include "hash.h"
+#include "libarena.h"
+
+#define LIBCACHE_SHM_MAGIC (0x4C434D3A)
+#define LIBCACHE_SHM_NAME_LENGTH (64)
+#define LIBCACHE_GOLDEN_RATIO_PRIME_32 (0x9e370001U)
+#define LIBCACHE_MAX_CHUNKS (32)
+#define LIBCACHE_RESIZE_SLICE (64)
+#define LIBCACHE_NIL (0)
+#define LIBCACHE_CHUNK_SHIFT (27)
+#define LIBCACHE_SLOT_MASK ((1U << LIBCACHE_CHUNK_SHIFT) - 1)
+#define LIBCACHE_MAX_CHUNK_RECORDS (LIBCACHE_SLOT_MASK - 1)
+#define LIBCACHE_SCAN_BLOCK (64)
+#define LIBCACHE_BATCH_GROUP (16)
+#define LIBCACHE_SCAN_EMPTY_FACTOR (10)
+#define LIBCACHE_TAG_COUNT (256)
+#define LIBCACHE_UNLINKED (0xFFFFFFFFU)
+
+/* All the links below are self-relative (offset_ptr_t) or handles, so the whole
+ * cache can live in a shared memory segment mapped at different
+ * addresses by different processes.
+ * The bucket table of a cache not in zero-filled memory, extra chunks and secondary
+ * indexes are mapped apart from the block, a byte copy of the block isn't a cache.
+ */
+
+/* Records are linked by handles: | chunk:5 | slot + 1:27 |, LIBCACHE_NIL (0) is no record */
+typedef uint32_t libcache_handle_t;
 
-typedef struct libcache_node_usr_data_t
+/* One cached entry is one record taken from a chunk:
+ *     | libcache_record_t | key (8 bytes aligned) | entry |
+ * handle is the record's own one while it is in the cache. A freed record holds the pool's
+ * POOL_FREE_POISON there instead, so a stale entry pointer is not taken for a cached one.
+ */
+typedef struct libcache_record_t
 {
-    void* key;
-    node_t* hash_node_ptr;
-    void* pool_element_ptr;
+    libcache_handle_t hash_next;    /* next record in the same bucket */
+    libcache_handle_t handle;
+    libcache_handle_t lru_previous; /* towards the most recently used */
+    libcache_handle_t lru_next;
+    uint32_t fingerprint;           /* key_to_number(key), compared before the key itself */
     uint32_t lock_counter;
-}libcache_node_usr_data_t;
+}libcache_record_t;
+
+typedef char libcache_record_handle_check[(offsetof(libcache_record_t, handle) == POOL_FREE_POISON_OFFSET) ? 1 : -1];
+
+/* Records come from chunks: chunk 0 is POOL_TYPE_DATA of the cache block,
+ * libcache_resize appends the others, each one a pools object of one pool in its own mapping.
+ */
+/* Metadata of the records of a chunk, kept apart by slot so scans read contiguous arrays:
+ *     | uint32_t expiry[n] | uint32_t access[n] | handle tag_previous[n] | handle tag_next[n] | uint8_t tag[n] | uint8_t cached[n] |
+ * n is the capacity rounded up to LIBCACHE_SCAN_BLOCK, the arrays of a slot are valid while cached is 1.
+ * Nothing is cleared at create: cached is only valid for the slots the pool has handed out, see pool_get_touched_count.
+ */
+typedef struct libcache_meta_t
+{
+    uint32_t* expiry;           /* tick at which the entry expires, 0: never */
+    uint32_t* access;           /* tick of the last add or lookup */
+    libcache_handle_t* tag_previous;    /* list of the records with the same tag, tag 0 isn't linked */
+    libcache_handle_t* tag_next;
+    uint8_t* tag;
+    uint8_t* cached;
+}libcache_meta_t;
+
+typedef struct libcache_chunk_t
+{
+    offset_ptr_t pools;
+    offset_ptr_t records;       /* record of slot 0 */
+    offset_ptr_t meta;
+    size_t memory_size;         /* bytes mapped by arena_alloc, 0 for chunk 0 */
+    libcache_scale_t capacity;
+    libcache_scale_t live;      /* records in use */
+}libcache_chunk_t;
+
+/* A secondary index finds an entry by a key kept inside the entry, at key_offset.
+ * Its links are mapped per chunk: | handle next[capacity] | uint32_t fingerprint[capacity] |,
+ * next is LIBCACHE_UNLINKED while the record isn't in the index. fingerprint is the one the record
+ * was linked with, so the record is found in its bucket even after the key in the entry was overwritten.
+ */
+typedef struct libcache_secondary_t
+{
+    size_t key_offset;
+    size_t key_size;
+    uint32_t bucket_bits;
+    offset_ptr_t buckets;       /* libcache_handle_t[1 << bucket_bits], mapped by arena_alloc */
+    size_t buckets_size;
+    offset_ptr_t old_buckets;   /* while resizing, like the primary index */
+    size_t old_buckets_size;
+    uint32_t old_bucket_bits;
+    uint32_t rehash_index;
+    offset_ptr_t links[LIBCACHE_MAX_CHUNKS];
+    LIBCACHE_CMP_KEY* cmp_key;
+    LIBCACHE_KEY_TO_NUMBER* key_to_number;
+}libcache_secondary_t;
+
+/* The callbacks a cache object is used with, they are the first member of the cache object. Function addresses
+ * mean nothing to another process, so each process uses a shared cache through its own handle of this type. */
+typedef struct libcache_callbacks_t
+{
+    struct libcache_t* shared;  /* NULL: this is the cache object, otherwise the cache object in the segment */
+    LIBCACHE_FREE_ENTRY* free_entry;
+    LIBCACHE_CMP_KEY* cmp_key;
+    LIBCACHE_KEY_TO_NUMBER* key_to_number;
+}libcache_callbacks_t;
 
 typedef struct libcache_t
 {
-    void* pool;
-    void* hash_table;
-    list_t* list;
+    libcache_callbacks_t callbacks;
+    offset_ptr_t pool;
+    offset_ptr_t buckets;       /* libcache_handle_t[1 << bucket_bits], the heads of the record chains */
+    size_t buckets_size;        /* > 0: the buckets were mapped by arena_alloc */
+    offset_ptr_t old_buckets;   /* while resizing the index: buckets from rehash_index on aren't moved yet */
+    size_t old_buckets_size;
+    uint32_t old_bucket_bits;
+    uint32_t rehash_index;
+    int chunk_count;
+    int kept_chunk_count;       /* chunks from this one on are emptied and released */
+    long long release_index;    /* next record of the last chunk to move out */
+    libcache_chunk_t chunks[LIBCACHE_MAX_CHUNKS];
+    size_t record_stride;       /* distance between two records of a chunk */
+    libcache_handle_t lru_head; /* most recently used */
+    libcache_handle_t lru_tail;
+    libcache_scale_t entry_number;
+    libcache_handle_t tag_heads[LIBCACHE_TAG_COUNT];
+    libcache_scale_t tag_counts[LIBCACHE_TAG_COUNT];   /* entries by tag, tag 0 included */
+    uint32_t clock;             /* tick stamped on access, see libcache_set_clock */
+    int secondary_count;
+    libcache_secondary_t secondaries[LIBCACHE_MAX_SECONDARIES];
+    offset_ptr_t shm_header; /* NULL when the cache is private to the process */
+    size_t arena_size;       /* > 0: the memory was mapped by arena_alloc_pages */
     size_t entry_size;
     size_t key_size;
     libcache_scale_t max_entry_number;
+    uint32_t bucket_bits;
     LIBCACHE_FREE_MEMORY* free_memory;
-    LIBCACHE_FREE_ENTRY* free_entry;
 }libcache_t;
 
+/* Head of a shared segment: | libcache_shm_header_t | pools ... | */
+typedef struct libcache_shm_header_t
+{
+    uint32_t magic;
+    volatile uint32_t ready;
+    size_t segment_size;
+    offset_ptr_t libcache;
+    char name[LIBCACHE_SHM_NAME_LENGTH];
+}libcache_shm_header_t;
+
+/* Note: a cache object, or the handle of a shared cache made by this process */
+static inline libcache_t* libcache_get_object(const void* libcache)
+{
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    return (NULL == callbacks || NULL == callbacks->shared) ? (libcache_t*) (uintptr_t) libcache : callbacks->shared;
+}
+
+static inline void* libcache_get_pool(const libcache_t* libcache)
+{
+    return offset_ptr_get(&libcache->pool);
+}
+
+static inline size_t libcache_get_key_length(size_t key_size)
+{
+    return (key_size + 7) & ~((size_t) 7);
+}
+
+static inline size_t libcache_get_record_length(size_t entry_size, size_t key_size)
+{
+    return sizeof(libcache_record_t) + libcache_get_key_length(key_size) + entry_size;
+}
+
+/* Note: one bucket per entry at least, so the chains stay short */
+static inline uint32_t libcache_get_bucket_bits(int max_entry)
+{
+    uint32_t bucket_bits = 1;
+    while ((1U << bucket_bits) < (uint32_t) max_entry) {
+        bucket_bits++;
+    }
+    return bucket_bits;
+}
+
+static inline size_t libcache_get_buckets_length(uint32_t bucket_bits)
+{
+    return sizeof(libcache_handle_t) << bucket_bits;
+}
+
+static inline uint32_t libcache_get_hash_code(uint32_t fingerprint, uint32_t bucket_bits)
+{
+    return (uint32_t) (fingerprint * LIBCACHE_GOLDEN_RATIO_PRIME_32) >> (32 - bucket_bits);
+}
+
+static inline libcache_handle_t* libcache_get_bucket(const libcache_t* libcache, uint32_t fingerprint)
+{
+    if (unlikely(0 != libcache->old_buckets)) {
+        uint32_t old_hash_code = libcache_get_hash_code(fingerprint, libcache->old_bucket_bits);
+        if (old_hash_code >= libcache->rehash_index) {
+            return (libcache_handle_t*) offset_ptr_get(&libcache->old_buckets) + old_hash_code;
+        }
+    }
+    return (libcache_handle_t*) offset_ptr_get(&libcache->buckets) + libcache_get_hash_code(fingerprint, libcache->bucket_bits);
+}
+
+static inline libcache_record_t* libcache_get_record(const libcache_t* libcache, libcache_handle_t handle)
+{
+    if (LIBCACHE_NIL == handle) {
+        return NULL;
+    }
+    const libcache_chunk_t* chunk = &libcache->chunks[handle >> LIBCACHE_CHUNK_SHIFT];
+    return (libcache_record_t*) ((char*) offset_ptr_get(&chunk->records)
+            + libcache->record_stride * ((handle & LIBCACHE_SLOT_MASK) - 1));
+}
+
+/* Note: libpool writes POOL_FREE_POISON over the handle of a freed record, see POOL_FREE_POISON_OFFSET.
+ *       As a handle it names slot LIBCACHE_SLOT_MASK, past the capacity of any chunk, so it's never cached.
+ *       A slot the pool hasn't handed out yet may hold anything there, the record address check catches it.
+ */
+static inline int libcache_is_cached(const libcache_t* libcache, libcache_record_t* record)
+{
+    libcache_handle_t handle = record->handle;
+    return LIBCACHE_NIL != handle && (int) (handle >> LIBCACHE_CHUNK_SHIFT) < libcache->chunk_count
+            && (handle & LIBCACHE_SLOT_MASK) <= libcache->chunks[handle >> LIBCACHE_CHUNK_SHIFT].capacity
+            && libcache_get_record(libcache, handle) == record;
+}
+
+static inline void* libcache_get_record_key(libcache_record_t* record)
+{
+    return (char*) record + sizeof(libcache_record_t);
+}
+
+static inline void* libcache_get_record_entry(const libcache_t* libcache, libcache_record_t* record)
+{
+    return (char*) record + sizeof(libcache_record_t) + libcache_get_key_length(libcache->key_size);
+}
+
+/* Note: NULL if the entry isn't in the cache (any more) */
+static inline libcache_record_t* libcache_get_entry_record(const libcache_t* libcache, void* entry)
+{
+    libcache_record_t* record = (libcache_record_t*) ((char*) entry - sizeof(libcache_record_t)
+            - libcache_get_key_length(libcache->key_size));
+    return libcache_is_cached(libcache, record) ? record : NULL;
+}
+
+static inline size_t libcache_get_meta_stride(libcache_scale_t capacity)
+{
+    return ((size_t) capacity + LIBCACHE_SCAN_BLOCK - 1) & ~((size_t) LIBCACHE_SCAN_BLOCK - 1);
+}
+
+static inline size_t libcache_get_meta_length(libcache_scale_t capacity)
+{
+    return libcache_get_meta_stride(capacity) * (sizeof(uint32_t) * 2 + sizeof(libcache_handle_t) * 2 + sizeof(uint8_t) * 2);
+}
+
+static inline size_t libcache_get_secondary_links_length(libcache_scale_t capacity)
+{
+    return (size_t) capacity * (sizeof(libcache_handle_t) + sizeof(uint32_t));
+}
+
+static inline libcache_meta_t libcache_get_meta(const libcache_chunk_t* chunk)
+{
+    size_t stride = libcache_get_meta_stride(chunk->capacity);
+    libcache_meta_t meta;
+    meta.expiry = (uint32_t*) offset_ptr_get(&chunk->meta);
+    meta.access = meta.expiry + stride;
+    meta.tag_previous = meta.access + stride;
+    meta.tag_next = meta.tag_previous + stride;
+    meta.tag = (uint8_t*) (meta.tag_next + stride);
+    meta.cached = meta.tag + stride;
+    return meta;
+}
+
+static inline libcache_scale_t libcache_get_record_slot(const libcache_record_t* record)
+{
+    return (record->handle & LIBCACHE_SLOT_MASK) - 1;
+}
+
+/* Note: the bucket table is only in the block when the block is known to be zero-filled, e.g. fresh anonymous pages.
+ *       Otherwise it's mapped zero-filled by arena_alloc, so nothing of O(capacity) is written at create. */
+static void libcache_init_pool_attr(pool_attr_t pool_attr[], int max_entry, size_t entry_size, size_t key_size,
+        int buckets_in_block)
+{
+    pool_attr_t attr[] = {
+            { libcache_get_record_length(entry_size, key_size), max_entry },
+            { sizeof(libcache_t), 1 } ,
+            { 0, 0 }, // POOL_TYPE_LIST_T
+            { sizeof(node_t), 0 },
+            { 0, 0 }, // POOL_TYPE_LIBCACHE_NODE_USR_DATA_T
+            { key_size, 0 },
+            { 0, 0 }, // POOL_TYPE_HASH_T
+            { libcache_get_buckets_length(libcache_get_bucket_bits(max_entry)), buckets_in_block ? 1 : 0 }, // POOL_TYPE_BUCKET_T
+            { 0, 0 }, // POOL_TYPE_HASH_DATA_T
+            { libcache_get_meta_length(max_entry), 1, FALSE, LIBCACHE_SCAN_BLOCK }, // POOL_TYPE_META_T
+            };
+    memcpy(pool_attr, attr, sizeof(attr));
+}
+
+static libcache_t* libcache_init(
+        void* large_memory,
+        size_t large_mem_size,
+        pool_attr_t pool_attr[],
+        int max_entry,
+        size_t entry_size,
+        size_t key_size,
+        LIBCACHE_FREE_MEMORY* free_memory,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    if (unlikely((uint32_t) max_entry > LIBCACHE_MAX_CHUNK_RECORDS)) {
+        DEBUG_ERROR("argument %s is too large.", "max_entry_number");
+        return NULL;
+    }
+
+    void * pools = pools_init(large_memory, large_mem_size, POOL_TYPE_MAX, pool_attr);
+    if (unlikely(pools == NULL)) {
+        DEBUG_ERROR("%s failed!", "pools_init");
+        return NULL;
+    }
+
+    libcache_t* libcache = (libcache_t*) pool_get_element(pools, POOL_TYPE_LIBCACHE_T);
+    offset_ptr_set(&libcache->pool, pools);
+
+    libcache->bucket_bits = libcache_get_bucket_bits(max_entry);
+    libcache->buckets_size = 0;
+    void* buckets = pool_get_element(pools, POOL_TYPE_BUCKET_T);
+    if (NULL == buckets) {
+        libcache->buckets_size = libcache_get_buckets_length(libcache->bucket_bits);
+        buckets = arena_alloc(libcache->buckets_size);
+        if (unlikely(buckets == NULL)) {
+            DEBUG_ERROR("Memory map of %zu bytes failed!", libcache->buckets_size);
+            return NULL;
+        }
+    }
+    offset_ptr_set(&libcache->buckets, buckets);
+    libcache->old_buckets = 0;
+    libcache->old_buckets_size = 0;
+    libcache->old_bucket_bits = 0;
+    libcache->rehash_index = 0;
+
+    offset_ptr_set(&libcache->chunks[0].pools, pools);
+    offset_ptr_set(&libcache->chunks[0].records, pool_get_elements(pools, POOL_TYPE_DATA, &libcache->record_stride));
+    offset_ptr_set(&libcache->chunks[0].meta, pool_get_element(pools, POOL_TYPE_META_T));
+    libcache->chunks[0].memory_size = 0;
+    libcache->chunks[0].capacity = max_entry;
+    libcache->chunks[0].live = 0;
+    libcache->chunk_count = 1;
+    libcache->kept_chunk_count = 1;
+    libcache->release_index = 0;
+
+    libcache->lru_head = LIBCACHE_NIL;
+    libcache->lru_tail = LIBCACHE_NIL;
+    libcache->entry_number = 0;
+    memset(libcache->tag_heads, 0, sizeof(libcache->tag_heads));
+    memset(libcache->tag_counts, 0, sizeof(libcache->tag_counts));
+    libcache->clock = 0;
+    libcache->secondary_count = 0;
+
+    libcache->shm_header = 0;
+    libcache->arena_size = 0;
+    libcache->entry_size = entry_size;
+    libcache->key_size = key_size;
+    libcache->max_entry_number = max_entry;
+    libcache->free_memory = free_memory;
+    libcache->callbacks.shared = NULL;
+    libcache->callbacks.free_entry = free_entry;
+    libcache->callbacks.cmp_key = cmp_key;
+    libcache->callbacks.key_to_number = key_to_number;
+
+    return libcache;
+}
+
 /*
  *  @brief libcache_create    creates a cache object
  *
@@ -56,373 +400,2284 @@ void* libcache_create(
     }
     int max_entry = max_entry_number + 1;
 
-    pool_attr_t pool_attr[] = {
-            { entry_size, max_entry },
-            { sizeof(libcache_t), 1 } ,
-            { sizeof(list_t), max_entry + 1},
-            { sizeof(node_t), max_entry * 2},
-            { sizeof(libcache_node_usr_data_t), max_entry },
-            { key_size, max_entry * 2},
-            { sizeof(hash_t), 1 }, // POOL_TYPE_HASH_T
-            { sizeof(bucket_t)*HASH_BUCKETS, 1 }, // POOL_TYPE_BUCKET_T
-            { sizeof(hash_data_t), max_entry},
-            };
-
+    pool_attr_t pool_attr[POOL_TYPE_MAX];
+    libcache_init_pool_attr(pool_attr, max_entry, entry_size, key_size, FALSE);
 
     size_t large_mem_size = pool_caculate_total_length(POOL_TYPE_MAX, pool_attr);
 
     void *large_memory = allocate_memory(large_mem_size);
     if (unlikely(large_memory == NULL)) {
         DEBUG_ERROR("Memory malloc failed!")
+        return NULL;
     }
 
-    void * pools = pools_init(large_memory, large_mem_size, POOL_TYPE_MAX, pool_attr);
+    libcache_t* libcache = libcache_init(large_memory, large_mem_size, pool_attr, max_entry, entry_size, key_size,
+            free_memory, free_entry, cmp_key, key_to_number);
+    if (unlikely(libcache == NULL)) {
+        free_memory(large_memory);
+        return NULL;
+    }
+    return libcache;
+}
 
-    libcache_t* libcache = (libcache_t*) pool_get_element(pools, POOL_TYPE_LIBCACHE_T);
-    libcache->pool = pools;
+/*
+ *  @brief libcache_get_memory_size  gets the memory size a cache object needs.
+ *
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @return                      size in bytes for libcache_create_in_memory.
+ */
+size_t libcache_get_memory_size(libcache_scale_t max_entry_number, size_t entry_size, size_t key_size)
+{
+    pool_attr_t pool_attr[POOL_TYPE_MAX];
+    libcache_init_pool_attr(pool_attr, max_entry_number + 1, entry_size, key_size, FALSE);
+    return pool_caculate_total_length(POOL_TYPE_MAX, pool_attr);
+}
+
+/* Note: only the keys and entries of POOL_TYPE_DATA are payload, the other pools are all overhead */
+static void libcache_set_pool_stats(libcache_pool_stats_t* stats, size_t element_size, long long capacity,
+        long long used, size_t bytes, size_t payload_size)
+{
+    stats->element_size = element_size;
+    stats->capacity = (libcache_scale_t) capacity;
+    stats->used = (libcache_scale_t) used;
+    stats->free = (libcache_scale_t) (capacity - used);
+    stats->bytes = bytes;
+    stats->overhead_ratio = (0 == bytes) ? 0 : 1.0 - (double) payload_size * (double) capacity / (double) bytes;
+}
+
+static void libcache_set_total_stats(libcache_memory_stats_t* stats, libcache_scale_t max_entry)
+{
+    stats->total_bytes = stats->block_bytes + stats->chunk_bytes + stats->bucket_bytes + stats->secondary_bytes;
+    stats->bytes_per_entry = (double) stats->total_bytes / max_entry;
+}
 
-    libcache->hash_table = hash_init(key_size, cmp_key, key_to_number, libcache->pool);
+/*
+ *  @brief libcache_estimate_memory  gets the memory a cache object needs and how it's made up.
+ *
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param options               how the cache will be created, NULL: by libcache_create / libcache_create_in_memory.
+ *  @param stats                 output, the bytes of each pool, nothing is used yet. It can be NULL.
+ *  @return                      total size in bytes.
+ */
+size_t libcache_estimate_memory(
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        const libcache_memory_options_t* options,
+        libcache_memory_stats_t* stats)
+{
+    int max_entry = max_entry_number + 1;
+    int buckets_in_block = (NULL != options && (options->on_pages || options->shared));
+    pool_attr_t pool_attr[POOL_TYPE_MAX];
+    libcache_init_pool_attr(pool_attr, max_entry, entry_size, key_size, buckets_in_block);
 
-    libcache->list = (list_t*) pool_get_element(pools, POOL_TYPE_LIST_T);
-    list_init(libcache->list);
+    size_t block_bytes = pool_caculate_total_length(POOL_TYPE_MAX, pool_attr);
+    if (NULL != options && options->shared) {
+        block_bytes += sizeof(libcache_shm_header_t);
+    }
+    if (NULL != options && options->on_pages) {
+        size_t page_size = arena_get_page_size(options->pages);
+        block_bytes = (block_bytes + page_size - 1) / page_size * page_size;
+    }
 
-    libcache->entry_size = entry_size;
-    libcache->key_size = key_size;
-    libcache->max_entry_number = max_entry;
-    libcache->free_memory = free_memory;
-    libcache->free_entry = free_entry;
+    if (NULL != stats) {
+        memset(stats, 0, sizeof(libcache_memory_stats_t));
+        int i;
+        for (i = 0; i < POOL_TYPE_MAX; i++) {
+            libcache_set_pool_stats(&stats->pools[i], pool_caculate_element_length(&pool_attr[i]), pool_attr[i].entry_acount,
+                    0, pool_caculate_length(&pool_attr[i]), (POOL_TYPE_DATA == i) ? entry_size + key_size : 0);
+        }
+        stats->block_bytes = block_bytes;
+        stats->bucket_bytes = buckets_in_block ? 0 : libcache_get_buckets_length(libcache_get_bucket_bits(max_entry));
+        libcache_set_total_stats(stats, max_entry);
+    }
+    return block_bytes;
+}
+
+/*
+ *  @brief libcache_get_memory_stats  gets the memory of a cache object and how much of each pool is used.
+ *
+ *  @param libcache              cache object, cannot be NULL.
+ *  @param stats                 output, cannot be NULL.
+ *  @return
+ *      LIBCACHE_SUCCESS         stats was filled.
+ *  NOTE:   The free elements of each pool are counted, it takes O(free entries).
+ */
+libcache_ret_t libcache_get_memory_stats(const void* libcache, libcache_memory_stats_t* stats)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == stats)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "stats");
+        return LIBCACHE_FAILURE;
+    }
+
+    memset(stats, 0, sizeof(libcache_memory_stats_t));
+    void* pools = libcache_get_pool(libcache_ptr);
+    int i;
+    for (i = 0; i < POOL_TYPE_MAX; i++) {
+        pool_stats_t pool_stats;
+        pool_get_stats(pools, i, &pool_stats);
+        libcache_set_pool_stats(&stats->pools[i], pool_stats.element_size, pool_stats.capacity, pool_stats.used,
+                pool_stats.bytes, (POOL_TYPE_DATA == i) ? libcache_ptr->entry_size + libcache_ptr->key_size : 0);
+    }
+
+    const libcache_shm_header_t* header = (const libcache_shm_header_t*) offset_ptr_get(&libcache_ptr->shm_header);
+    if (NULL != header) {
+        stats->block_bytes = header->segment_size;
+    } else if (0 != libcache_ptr->arena_size) {
+        stats->block_bytes = libcache_ptr->arena_size;
+    } else {
+        pool_attr_t pool_attr[POOL_TYPE_MAX];
+        libcache_init_pool_attr(pool_attr, libcache_ptr->chunks[0].capacity, libcache_ptr->entry_size, libcache_ptr->key_size, FALSE);
+        stats->block_bytes = pool_caculate_total_length(POOL_TYPE_MAX, pool_attr);
+    }
+
+    for (i = 1; i < libcache_ptr->chunk_count; i++) {
+        stats->chunk_bytes += libcache_ptr->chunks[i].memory_size;
+    }
+    stats->bucket_bytes = libcache_ptr->buckets_size + libcache_ptr->old_buckets_size;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        stats->secondary_bytes += libcache_ptr->secondaries[i].buckets_size + libcache_ptr->secondaries[i].old_buckets_size;
+        int j;
+        for (j = 0; j < libcache_ptr->chunk_count; j++) {
+            stats->secondary_bytes += libcache_get_secondary_links_length(libcache_ptr->chunks[j].capacity);
+        }
+    }
+    libcache_set_total_stats(stats, libcache_ptr->max_entry_number);
+    return LIBCACHE_SUCCESS;
+}
+
+/*
+ *  @brief libcache_create_in_memory    creates a cache object in memory given by the caller
+ *
+ *  @param memory                memory for this cache object, e.g. a region bound to a NUMA node.
+ *  @param memory_size           size of memory, at least libcache_get_memory_size() bytes.
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param free_memory           function to free memory when the cache is destroyed,
+ *                               it can be NULL if the caller releases memory itself.
+ *  @param free_entry            function to free entry and key, it can be NULL if there isn't any resource to release.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL if memory is too small.
+ */
+void* libcache_create_in_memory(
+        void* memory,
+        size_t memory_size,
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        LIBCACHE_FREE_MEMORY* free_memory,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    if (unlikely(memory == NULL)) {
+        DEBUG_ERROR("input parameter %s is null", "memory");
+        return NULL;
+    }
+    int max_entry = max_entry_number + 1;
+
+    pool_attr_t pool_attr[POOL_TYPE_MAX];
+    libcache_init_pool_attr(pool_attr, max_entry, entry_size, key_size, FALSE);
+
+    return libcache_init(memory, memory_size, pool_attr, max_entry, entry_size, key_size,
+            free_memory, free_entry, cmp_key, key_to_number);
+}
+
+/*
+ *  @brief libcache_create_on_pages    creates a cache object in a private region of (huge) pages
+ *
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param pages                 pages wanted, smaller pages are used when they can't be had.
+ *  @param populate              ARENA_PREFAULT and/or ARENA_MLOCK the region now, 0: pages are faulted in on first use.
+ *  @param report                pages used and why the wanted ones or populate failed, it can be NULL.
+ *  @param free_entry            function to free entry and key, it can be NULL if there isn't any resource to release.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL on failure.
+ */
+void* libcache_create_on_pages(
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        arena_pages_e pages,
+        int populate,
+        arena_report_t* report,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    // Note: fresh anonymous pages are zero-filled, so the bucket table is in the block and gets its pages
+    int max_entry = max_entry_number + 1;
+    pool_attr_t pool_attr[POOL_TYPE_MAX];
+    libcache_init_pool_attr(pool_attr, max_entry, entry_size, key_size, TRUE);
+
+    size_t memory_size = pool_caculate_total_length(POOL_TYPE_MAX, pool_attr);
+    void* memory = arena_alloc_pages(&memory_size, pages, report);
+    if (unlikely(memory == NULL)) {
+        DEBUG_ERROR("Memory map of %zu bytes failed!", memory_size);
+        return NULL;
+    }
+
+    // Note: a failed populate leaves the pages to be faulted in on first use, report tells why
+    if (populate) {
+        arena_populate(memory, memory_size, populate, report);
+    }
+
+    libcache_t* libcache = libcache_init(memory, memory_size, pool_attr, max_entry, entry_size, key_size,
+            NULL, free_entry, cmp_key, key_to_number);
+    if (unlikely(libcache == NULL)) {
+        arena_free(memory, memory_size);
+        return NULL;
+    }
+    libcache->arena_size = memory_size;
+
+    return libcache;
+}
+
+/* Note: the handle is private to the calling process, the segment keeps no function address */
+static libcache_callbacks_t* libcache_new_shared_handle(libcache_t* libcache, LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key, LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    libcache_callbacks_t* handle = (libcache_callbacks_t*) malloc(sizeof(libcache_callbacks_t));
+    if (unlikely(handle == NULL)) {
+        DEBUG_ERROR("%s failed!", "malloc");
+        return NULL;
+    }
+    handle->shared = libcache;
+    handle->free_entry = free_entry;
+    handle->cmp_key = cmp_key;
+    handle->key_to_number = key_to_number;
+    return handle;
+}
+
+/*
+ *  @brief libcache_create_shared    creates a cache object in a named shared memory segment
+ *
+ *  @param name                  POSIX shared memory name (e.g. "/imsi_cache"),
+ *                               or a file path on a hugetlbfs mount (e.g. "/dev/hugepages/imsi_cache").
+ *  @param max_entry_number      maximum entry number that this cache is able to store.
+ *  @param entry_size            size of an entry, bytes
+ *  @param key_size              size of a key, bytes
+ *  @param free_entry            function to free entry and key, it can be NULL if there isn't any resource to release.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL if the segment already exists or on failure.
+ */
+void* libcache_create_shared(
+        const char* name,
+        libcache_scale_t max_entry_number,
+        size_t entry_size,
+        size_t key_size,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    if (unlikely(name == NULL || strlen(name) >= LIBCACHE_SHM_NAME_LENGTH)) {
+        DEBUG_ERROR("argument %s is invalid.", "name");
+        return NULL;
+    }
+    int max_entry = max_entry_number + 1;
+
+    pool_attr_t pool_attr[POOL_TYPE_MAX];
+    // Note: other processes must follow the bucket table, it's in the segment, which is created zero-filled
+    libcache_init_pool_attr(pool_attr, max_entry, entry_size, key_size, TRUE);
+
+    size_t large_mem_size = pool_caculate_total_length(POOL_TYPE_MAX, pool_attr);
+    size_t segment_size = sizeof(libcache_shm_header_t) + large_mem_size;
+
+    libcache_shm_header_t* header = (libcache_shm_header_t*) arena_shm_create(name, &segment_size);
+    if (unlikely(header == NULL)) {
+        DEBUG_ERROR("create shared memory %s failed!", name);
+        return NULL;
+    }
+
+    // Note: the callbacks in the segment are left NULL, every process uses its own handle
+    libcache_t* libcache = libcache_init(header + 1, large_mem_size, pool_attr, max_entry, entry_size, key_size,
+            NULL, NULL, NULL, NULL);
+    libcache_callbacks_t* handle = (NULL == libcache) ? NULL
+            : libcache_new_shared_handle(libcache, free_entry, cmp_key, key_to_number);
+    if (unlikely(handle == NULL)) {
+        arena_shm_detach(header, segment_size);
+        arena_shm_unlink(name);
+        return NULL;
+    }
+    offset_ptr_set(&libcache->shm_header, header);
+
+    header->segment_size = segment_size;
+    offset_ptr_set(&header->libcache, libcache);
+    strncpy(header->name, name, LIBCACHE_SHM_NAME_LENGTH - 1);
+    header->magic = LIBCACHE_SHM_MAGIC;
+    __sync_synchronize();
+    header->ready = TRUE;
+
+    return handle;
+}
+
+/*
+ *  @brief libcache_attach_shared    attaches to a cache object created by libcache_create_shared.
+ *
+ *  @param name                  name used by libcache_create_shared.
+ *  @param free_entry            function to free entry and key, it can be NULL.
+ *  @param cmp_key               function to compare two keys.
+ *  @param key_to_number         function to translate key to a number.
+ *  @return                      pointer of a cache object, NULL on failure.
+ *  NOTE:  The callbacks are kept in a handle of this process, so every process may bind its own ones.
+ *         The cache itself is not protected against concurrent access, the callers must serialize it.
+ */
+void* libcache_attach_shared(
+        const char* name,
+        LIBCACHE_FREE_ENTRY* free_entry,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    if (unlikely(name == NULL)) {
+        DEBUG_ERROR("input parameter %s is null", "name");
+        return NULL;
+    }
+
+    size_t segment_size = 0;
+    libcache_shm_header_t* header = (libcache_shm_header_t*) arena_shm_attach(name, &segment_size);
+    if (unlikely(header == NULL)) {
+        DEBUG_ERROR("attach shared memory %s failed!", name);
+        return NULL;
+    }
+
+    if (unlikely(segment_size < sizeof(libcache_shm_header_t) || header->magic != LIBCACHE_SHM_MAGIC
+            || !header->ready || header->segment_size != segment_size)) {
+        DEBUG_ERROR("shared memory %s is not a cache.", name);
+        arena_shm_detach(header, segment_size);
+        return NULL;
+    }
+
+    libcache_callbacks_t* handle = libcache_new_shared_handle((libcache_t*) offset_ptr_get(&header->libcache),
+            free_entry, cmp_key, key_to_number);
+    if (unlikely(handle == NULL)) {
+        arena_shm_detach(header, segment_size);
+        return NULL;
+    }
+    return handle;
+}
+
+/*
+ *  @brief libcache_detach_shared    detaches from a shared cache object, the entries are kept in the segment.
+ *
+ *  @param libcache                  cache object returned by libcache_create_shared/libcache_attach_shared.
+ *  @return
+ *      LIBCACHE_FAILURE             the cache object is not a shared one.
+ *      LIBCACHE_SUCCESS             the cache was unmapped from this process.
+ */
+libcache_ret_t libcache_detach_shared(void* libcache)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_shm_header_t* header = (libcache_shm_header_t*) offset_ptr_get(&libcache_ptr->shm_header);
+    if (unlikely(header == NULL)) {
+        DEBUG_ERROR("%s is not shared.", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    arena_shm_detach(header, header->segment_size);
+    free(libcache);
+    return LIBCACHE_SUCCESS;
+}
+
+/*
+ *  @brief libcache_find_in_bucket    finds the record of the entry with a given key in the chain of a bucket.
+ *
+ *  @return NULL                      didn't find out such entry with the key.
+ */
+static libcache_record_t* libcache_find_in_bucket(const libcache_t* libcache_ptr,
+        const libcache_callbacks_t* callbacks, const libcache_handle_t* bucket, const void* key, uint32_t fingerprint)
+{
+    libcache_record_t* record = libcache_get_record(libcache_ptr, *bucket);
+    while (NULL != record) {
+        if (record->fingerprint == fingerprint
+                && LIBCACHE_EQU == callbacks->cmp_key(key, libcache_get_record_key(record))) {
+            return record;
+        }
+        record = libcache_get_record(libcache_ptr, record->hash_next);
+    }
+    return NULL;
+}
+
+/*
+ *  @brief libcache_find_record    finds the record of the entry with a given key.
+ *
+ *  @return NULL                   didn't find out such entry with the key.
+ */
+static inline libcache_record_t* libcache_find_record(const libcache_t* libcache_ptr,
+        const libcache_callbacks_t* callbacks, const void* key, uint32_t fingerprint)
+{
+    return libcache_find_in_bucket(libcache_ptr, callbacks, libcache_get_bucket(libcache_ptr, fingerprint), key, fingerprint);
+}
+
+static inline void libcache_link_record(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    libcache_handle_t* bucket = libcache_get_bucket(libcache_ptr, record->fingerprint);
+    record->hash_next = *bucket;
+    *bucket = record->handle;
+}
+
+/* Note: the bucket or the hash_next of the record before, which holds the handle of the record */
+static libcache_handle_t* libcache_find_link(const libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    libcache_handle_t* link = libcache_get_bucket(libcache_ptr, record->fingerprint);
+    while (record->handle != *link) {
+        link = &libcache_get_record(libcache_ptr, *link)->hash_next;
+    }
+    return link;
+}
+
+static inline void libcache_unlink_record(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    *libcache_find_link(libcache_ptr, record) = record->hash_next;
+}
+
+static void libcache_lru_push_front(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    record->lru_previous = LIBCACHE_NIL;
+    record->lru_next = libcache_ptr->lru_head;
+    if (LIBCACHE_NIL == libcache_ptr->lru_head) {
+        libcache_ptr->lru_tail = record->handle;
+    } else {
+        libcache_get_record(libcache_ptr, libcache_ptr->lru_head)->lru_previous = record->handle;
+    }
+    libcache_ptr->lru_head = record->handle;
+    libcache_ptr->entry_number++;
+}
+
+static void libcache_lru_remove(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    if (LIBCACHE_NIL == record->lru_previous) {
+        libcache_ptr->lru_head = record->lru_next;
+    } else {
+        libcache_get_record(libcache_ptr, record->lru_previous)->lru_next = record->lru_next;
+    }
+    if (LIBCACHE_NIL == record->lru_next) {
+        libcache_ptr->lru_tail = record->lru_previous;
+    } else {
+        libcache_get_record(libcache_ptr, record->lru_next)->lru_previous = record->lru_previous;
+    }
+    libcache_ptr->entry_number--;
+}
+
+static inline void libcache_lru_move_to_front(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    if (libcache_ptr->lru_head != record->handle) {
+        libcache_lru_remove(libcache_ptr, record);
+        libcache_lru_push_front(libcache_ptr, record);
+    }
+}
+
+/* Note: the least recently used record which isn't locked, NULL if all are */
+static libcache_record_t* libcache_find_unlocked_record(const libcache_t* libcache_ptr)
+{
+    libcache_record_t* record = libcache_get_record(libcache_ptr, libcache_ptr->lru_tail);
+    while (NULL != record && record->lock_counter > 0) {
+        record = libcache_get_record(libcache_ptr, record->lru_previous);
+    }
+    return record;
+}
+
+static inline void* libcache_get_chunk_pools(const libcache_chunk_t* chunk)
+{
+    return offset_ptr_get(&chunk->pools);
+}
+
+static inline libcache_meta_t libcache_get_record_meta(const libcache_t* libcache_ptr, const libcache_record_t* record)
+{
+    return libcache_get_meta(&libcache_ptr->chunks[record->handle >> LIBCACHE_CHUNK_SHIFT]);
+}
+
+static inline void libcache_touch_record(const libcache_t* libcache_ptr, const libcache_record_t* record)
+{
+    libcache_get_record_meta(libcache_ptr, record).access[libcache_get_record_slot(record)] = libcache_ptr->clock;
+}
+
+static inline libcache_handle_t* libcache_get_tag_previous(const libcache_t* libcache_ptr, libcache_handle_t handle)
+{
+    return &libcache_get_meta(&libcache_ptr->chunks[handle >> LIBCACHE_CHUNK_SHIFT]).tag_previous[(handle & LIBCACHE_SLOT_MASK) - 1];
+}
+
+static inline libcache_handle_t* libcache_get_tag_next(const libcache_t* libcache_ptr, libcache_handle_t handle)
+{
+    return &libcache_get_meta(&libcache_ptr->chunks[handle >> LIBCACHE_CHUNK_SHIFT]).tag_next[(handle & LIBCACHE_SLOT_MASK) - 1];
+}
+
+/* Note: every tag is counted, tag 0 (untagged) isn't linked as most entries have it */
+static void libcache_tag_unlink(libcache_t* libcache_ptr, const libcache_record_t* record)
+{
+    libcache_meta_t meta = libcache_get_record_meta(libcache_ptr, record);
+    libcache_scale_t slot = libcache_get_record_slot(record);
+    uint8_t tag = meta.tag[slot];
+    libcache_ptr->tag_counts[tag]--;
+    if (0 == tag) {
+        return;
+    }
+
+    if (LIBCACHE_NIL == meta.tag_previous[slot]) {
+        libcache_ptr->tag_heads[tag] = meta.tag_next[slot];
+    } else {
+        *libcache_get_tag_next(libcache_ptr, meta.tag_previous[slot]) = meta.tag_next[slot];
+    }
+    if (LIBCACHE_NIL != meta.tag_next[slot]) {
+        *libcache_get_tag_previous(libcache_ptr, meta.tag_next[slot]) = meta.tag_previous[slot];
+    }
+}
+
+static void libcache_tag_link(libcache_t* libcache_ptr, const libcache_record_t* record, uint8_t tag)
+{
+    libcache_meta_t meta = libcache_get_record_meta(libcache_ptr, record);
+    libcache_scale_t slot = libcache_get_record_slot(record);
+    meta.tag[slot] = tag;
+    libcache_ptr->tag_counts[tag]++;
+    if (0 == tag) {
+        return;
+    }
+
+    meta.tag_previous[slot] = LIBCACHE_NIL;
+    meta.tag_next[slot] = libcache_ptr->tag_heads[tag];
+    if (LIBCACHE_NIL != libcache_ptr->tag_heads[tag]) {
+        *libcache_get_tag_previous(libcache_ptr, libcache_ptr->tag_heads[tag]) = record->handle;
+    }
+    libcache_ptr->tag_heads[tag] = record->handle;
+}
+
+static inline void libcache_set_record_tag(libcache_t* libcache_ptr, const libcache_record_t* record, uint8_t tag)
+{
+    if (libcache_get_record_meta(libcache_ptr, record).tag[libcache_get_record_slot(record)] != tag) {
+        libcache_tag_unlink(libcache_ptr, record);
+        libcache_tag_link(libcache_ptr, record, tag);
+    }
+}
+
+static inline libcache_handle_t* libcache_get_secondary_next(const libcache_t* libcache_ptr,
+        const libcache_secondary_t* secondary, libcache_handle_t handle)
+{
+    return (libcache_handle_t*) offset_ptr_get(&secondary->links[handle >> LIBCACHE_CHUNK_SHIFT]) + (handle & LIBCACHE_SLOT_MASK) - 1;
+}
+
+static inline uint32_t* libcache_get_secondary_fingerprint(const libcache_t* libcache_ptr,
+        const libcache_secondary_t* secondary, libcache_handle_t handle)
+{
+    uint32_t chunk = handle >> LIBCACHE_CHUNK_SHIFT;
+    return (uint32_t*) offset_ptr_get(&secondary->links[chunk]) + libcache_ptr->chunks[chunk].capacity
+            + (handle & LIBCACHE_SLOT_MASK) - 1;
+}
+
+static inline libcache_handle_t* libcache_get_secondary_bucket(const libcache_secondary_t* secondary, uint32_t fingerprint)
+{
+    if (unlikely(0 != secondary->old_buckets)) {
+        uint32_t old_hash_code = libcache_get_hash_code(fingerprint, secondary->old_bucket_bits);
+        if (old_hash_code >= secondary->rehash_index) {
+            return (libcache_handle_t*) offset_ptr_get(&secondary->old_buckets) + old_hash_code;
+        }
+    }
+    return (libcache_handle_t*) offset_ptr_get(&secondary->buckets) + libcache_get_hash_code(fingerprint, secondary->bucket_bits);
+}
+
+/* Note: the bucket or the next link of the record before, which holds the handle, NULL if the record isn't linked */
+static libcache_handle_t* libcache_find_secondary_link(const libcache_t* libcache_ptr,
+        const libcache_secondary_t* secondary, libcache_handle_t handle)
+{
+    if (LIBCACHE_UNLINKED == *libcache_get_secondary_next(libcache_ptr, secondary, handle)) {
+        return NULL;
+    }
+
+    libcache_handle_t* link = libcache_get_secondary_bucket(secondary,
+            *libcache_get_secondary_fingerprint(libcache_ptr, secondary, handle));
+    while (handle != *link) {
+        link = libcache_get_secondary_next(libcache_ptr, secondary, *link);
+    }
+    return link;
+}
+
+static void libcache_link_secondary_record(libcache_t* libcache_ptr, libcache_secondary_t* secondary, libcache_record_t* record)
+{
+    uint32_t fingerprint = secondary->key_to_number((char*) libcache_get_record_entry(libcache_ptr, record) + secondary->key_offset);
+    libcache_handle_t* bucket = libcache_get_secondary_bucket(secondary, fingerprint);
+    *libcache_get_secondary_fingerprint(libcache_ptr, secondary, record->handle) = fingerprint;
+    *libcache_get_secondary_next(libcache_ptr, secondary, record->handle) = *bucket;
+    *bucket = record->handle;
+}
+
+static void libcache_link_secondaries(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        libcache_link_secondary_record(libcache_ptr, &libcache_ptr->secondaries[i], record);
+    }
+}
+
+static void libcache_unlink_secondaries(libcache_t* libcache_ptr, const libcache_record_t* record)
+{
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        libcache_secondary_t* secondary = &libcache_ptr->secondaries[i];
+        libcache_handle_t* link = libcache_find_secondary_link(libcache_ptr, secondary, record->handle);
+        if (NULL != link) {
+            libcache_handle_t* next = libcache_get_secondary_next(libcache_ptr, secondary, record->handle);
+            *link = *next;
+            *next = LIBCACHE_UNLINKED;
+        }
+    }
+}
+
+/* Note: the target takes the place of the record in the chains, the record is left unlinked */
+static void libcache_move_secondaries(libcache_t* libcache_ptr, const libcache_record_t* record, const libcache_record_t* target)
+{
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        libcache_secondary_t* secondary = &libcache_ptr->secondaries[i];
+        libcache_handle_t* link = libcache_find_secondary_link(libcache_ptr, secondary, record->handle);
+        if (NULL != link) {
+            libcache_handle_t* next = libcache_get_secondary_next(libcache_ptr, secondary, record->handle);
+            *libcache_get_secondary_next(libcache_ptr, secondary, target->handle) = *next;
+            *libcache_get_secondary_fingerprint(libcache_ptr, secondary, target->handle)
+                    = *libcache_get_secondary_fingerprint(libcache_ptr, secondary, record->handle);
+            *link = target->handle;
+            *next = LIBCACHE_UNLINKED;
+        }
+    }
+}
+
+/* Note: every record of a new chunk is unlinked */
+static libcache_ret_t libcache_map_secondary_links(libcache_t* libcache_ptr, libcache_secondary_t* secondary, int chunk)
+{
+    libcache_scale_t capacity = libcache_ptr->chunks[chunk].capacity;
+    size_t links_size = libcache_get_secondary_links_length(capacity);
+    void* links = arena_alloc(links_size);
+    if (unlikely(links == NULL)) {
+        DEBUG_ERROR("Memory map of %zu bytes failed!", links_size);
+        return LIBCACHE_FAILURE;
+    }
+    memset(links, 0xFF, sizeof(libcache_handle_t) * capacity);
+    offset_ptr_set(&secondary->links[chunk], links);
+    return LIBCACHE_SUCCESS;
+}
+
+static void libcache_free_secondary_links(libcache_t* libcache_ptr, int chunk)
+{
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        arena_free(offset_ptr_get(&libcache_ptr->secondaries[i].links[chunk]),
+                libcache_get_secondary_links_length(libcache_ptr->chunks[chunk].capacity));
+    }
+}
+
+/* Note: the last chunk must be empty, its secondary links and memory are unmapped */
+static void libcache_unmap_last_chunk(libcache_t* libcache_ptr)
+{
+    libcache_chunk_t* chunk = &libcache_ptr->chunks[libcache_ptr->chunk_count - 1];
+    libcache_free_secondary_links(libcache_ptr, libcache_ptr->chunk_count - 1);
+    arena_free(libcache_get_chunk_pools(chunk), chunk->memory_size);
+    libcache_ptr->chunk_count--;
+}
+
+/* Note: a larger table is mapped for every secondary index with fewer buckets, the others are left NULL */
+static libcache_ret_t libcache_map_secondary_buckets(const libcache_t* libcache_ptr, uint32_t bucket_bits, void* buckets[])
+{
+    size_t buckets_size = libcache_get_buckets_length(bucket_bits);
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        if (bucket_bits > libcache_ptr->secondaries[i].bucket_bits) {
+            buckets[i] = arena_alloc(buckets_size);
+            if (unlikely(buckets[i] == NULL)) {
+                DEBUG_ERROR("Memory map of %zu bytes failed!", buckets_size);
+                return LIBCACHE_FAILURE;
+            }
+        }
+    }
+    return LIBCACHE_SUCCESS;
+}
+
+static void libcache_unmap_secondary_buckets(const libcache_t* libcache_ptr, uint32_t bucket_bits, void* buckets[])
+{
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        if (NULL != buckets[i]) {
+            arena_free(buckets[i], libcache_get_buckets_length(bucket_bits));
+        }
+    }
+}
+
+/* Note: the records are moved to the new table by libcache_resize_work, by the fingerprints they keep */
+static void libcache_resize_secondary_buckets(libcache_secondary_t* secondary, uint32_t bucket_bits, void* buckets)
+{
+    offset_ptr_set(&secondary->old_buckets, offset_ptr_get(&secondary->buckets));
+    secondary->old_buckets_size = secondary->buckets_size;
+    secondary->old_bucket_bits = secondary->bucket_bits;
+    secondary->rehash_index = 0;
+
+    offset_ptr_set(&secondary->buckets, buckets);
+    secondary->buckets_size = libcache_get_buckets_length(bucket_bits);
+    secondary->bucket_bits = bucket_bits;
+}
+
+/*
+ *  @brief libcache_rehash_secondary    moves buckets of the old table of a secondary index to the new one.
+ *
+ *  @return                             the budget left.
+ */
+static int libcache_rehash_secondary(libcache_t* libcache_ptr, libcache_secondary_t* secondary, int budget)
+{
+    while (budget > 0 && 0 != secondary->old_buckets) {
+        libcache_handle_t* old_bucket = (libcache_handle_t*) offset_ptr_get(&secondary->old_buckets) + secondary->rehash_index;
+        libcache_handle_t handle = *old_bucket;
+        *old_bucket = LIBCACHE_NIL;
+        secondary->rehash_index++;
+        budget--;
+
+        while (LIBCACHE_NIL != handle) {
+            libcache_handle_t* next = libcache_get_secondary_next(libcache_ptr, secondary, handle);
+            libcache_handle_t* bucket = libcache_get_secondary_bucket(secondary,
+                    *libcache_get_secondary_fingerprint(libcache_ptr, secondary, handle));
+            libcache_handle_t following = *next;
+            *next = *bucket;
+            *bucket = handle;
+            handle = following;
+            budget--;
+        }
+
+        if (secondary->rehash_index == (1U << secondary->old_bucket_bits)) {
+            arena_free(offset_ptr_get(&secondary->old_buckets), secondary->old_buckets_size);
+            secondary->old_buckets = 0;
+            secondary->old_buckets_size = 0;
+        }
+    }
+    return budget;
+}
+
+/* Note: the oldest chunks are filled first, the ones being released are skipped */
+static libcache_record_t* libcache_take_record(libcache_t* libcache_ptr)
+{
+    int i;
+    for (i = 0; i < libcache_ptr->kept_chunk_count; i++) {
+        libcache_chunk_t* chunk = &libcache_ptr->chunks[i];
+        libcache_record_t* record = (libcache_record_t*) pool_get_element(libcache_get_chunk_pools(chunk), POOL_TYPE_DATA);
+        if (NULL != record) {
+            chunk->live++;
+            size_t slot = (size_t) ((char*) record - (char*) offset_ptr_get(&chunk->records)) / libcache_ptr->record_stride;
+            record->handle = ((libcache_handle_t) i << LIBCACHE_CHUNK_SHIFT) | (libcache_handle_t) (slot + 1);
+
+            libcache_meta_t meta = libcache_get_meta(chunk);
+            meta.expiry[slot] = 0;
+            meta.access[slot] = libcache_ptr->clock;
+            meta.tag[slot] = 0;
+            meta.cached[slot] = TRUE;
+            libcache_ptr->tag_counts[0]++;
+            return record;
+        }
+    }
+    return NULL;
+}
+
+static void libcache_free_record(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    libcache_chunk_t* chunk = &libcache_ptr->chunks[record->handle >> LIBCACHE_CHUNK_SHIFT];
+    chunk->live--;
+    libcache_tag_unlink(libcache_ptr, record);
+    libcache_unlink_secondaries(libcache_ptr, record);
+    libcache_get_meta(chunk).cached[libcache_get_record_slot(record)] = FALSE;
+
+    // Note: the pool link overwrites the handle, the entry isn't found by its pointer any more
+    pool_free_element(libcache_get_chunk_pools(chunk), POOL_TYPE_DATA, record);
+}
+
+/*
+ *  @brief libcache_remove_record    removes an unlocked record from the cache and frees it.
+ */
+static void libcache_remove_record(libcache_t* libcache_ptr, libcache_record_t* record)
+{
+    libcache_unlink_record(libcache_ptr, record);
+    libcache_lru_remove(libcache_ptr, record);
+    libcache_free_record(libcache_ptr, record);
+}
+
+/*
+ *  @brief libcache_move_record    moves an unlocked record into a free one, the neighbours in the LRU list
+ *                                 and in the bucket are linked to the new place.
+ */
+static void libcache_move_record(libcache_t* libcache_ptr, libcache_record_t* record, libcache_record_t* target)
+{
+    libcache_handle_t* link = libcache_find_link(libcache_ptr, record);
+    libcache_handle_t handle = target->handle;
+
+    libcache_meta_t meta = libcache_get_record_meta(libcache_ptr, record);
+    libcache_meta_t target_meta = libcache_get_record_meta(libcache_ptr, target);
+    libcache_scale_t slot = libcache_get_record_slot(record);
+    libcache_scale_t target_slot = libcache_get_record_slot(target);
+    target_meta.expiry[target_slot] = meta.expiry[slot];
+    target_meta.access[target_slot] = meta.access[slot];
+    uint8_t tag = meta.tag[slot];
+    libcache_set_record_tag(libcache_ptr, record, 0);
+    libcache_move_secondaries(libcache_ptr, record, target);
+
+    memcpy(target, record, libcache_get_record_length(libcache_ptr->entry_size, libcache_ptr->key_size));
+    target->handle = handle;
+    *link = handle;
+    libcache_set_record_tag(libcache_ptr, target, tag);
+
+    if (LIBCACHE_NIL == target->lru_previous) {
+        libcache_ptr->lru_head = handle;
+    } else {
+        libcache_get_record(libcache_ptr, target->lru_previous)->lru_next = handle;
+    }
+    if (LIBCACHE_NIL == target->lru_next) {
+        libcache_ptr->lru_tail = handle;
+    } else {
+        libcache_get_record(libcache_ptr, target->lru_next)->lru_previous = handle;
+    }
+
+    libcache_free_record(libcache_ptr, record);
+}
+
+static inline int libcache_resize_pending(const libcache_t* libcache_ptr)
+{
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        if (0 != libcache_ptr->secondaries[i].old_buckets) {
+            return TRUE;
+        }
+    }
+    return 0 != libcache_ptr->old_buckets || libcache_ptr->kept_chunk_count < libcache_ptr->chunk_count
+            || libcache_ptr->entry_number > libcache_ptr->max_entry_number;
+}
+
+/*
+ *  @brief libcache_resize_work    does one slice of the work left by libcache_resize:
+ *                                 moves buckets to the new index, swaps out the entries above
+ *                                 the new maximum, empties and releases the chunks not needed.
+ *
+ *  @param budget                  buckets and records to visit at most.
+ *  @return                        TRUE if work is left.
+ */
+static int libcache_resize_work(libcache_t* libcache_ptr, int budget)
+{
+    while (budget > 0 && 0 != libcache_ptr->old_buckets) {
+        libcache_handle_t* old_bucket = (libcache_handle_t*) offset_ptr_get(&libcache_ptr->old_buckets) + libcache_ptr->rehash_index;
+        libcache_record_t* record = libcache_get_record(libcache_ptr, *old_bucket);
+        *old_bucket = LIBCACHE_NIL;
+        libcache_ptr->rehash_index++;
+        budget--;
+
+        while (NULL != record) {
+            libcache_record_t* next = libcache_get_record(libcache_ptr, record->hash_next);
+            libcache_link_record(libcache_ptr, record);
+            record = next;
+            budget--;
+        }
+
+        if (libcache_ptr->rehash_index == (1U << libcache_ptr->old_bucket_bits)) {
+            if (0 != libcache_ptr->old_buckets_size) {
+                arena_free(offset_ptr_get(&libcache_ptr->old_buckets), libcache_ptr->old_buckets_size);
+            }
+            libcache_ptr->old_buckets = 0;
+            libcache_ptr->old_buckets_size = 0;
+        }
+    }
+
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        budget = libcache_rehash_secondary(libcache_ptr, &libcache_ptr->secondaries[i], budget);
+    }
+
+    while (budget > 0 && libcache_ptr->entry_number > libcache_ptr->max_entry_number) {
+        libcache_record_t* unlocked_record = libcache_find_unlocked_record(libcache_ptr);
+        if (NULL == unlocked_record) {
+            break;
+        }
+        libcache_remove_record(libcache_ptr, unlocked_record);
+        budget--;
+    }
+
+    while (budget > 0 && libcache_ptr->kept_chunk_count < libcache_ptr->chunk_count) {
+        libcache_chunk_t* chunk = &libcache_ptr->chunks[libcache_ptr->chunk_count - 1];
+        if (0 == chunk->live) {
+            libcache_unmap_last_chunk(libcache_ptr);
+            libcache_ptr->release_index = 0;
+            continue;
+        }
+
+        libcache_record_t* record = (libcache_record_t*) pool_get_used_element(libcache_get_chunk_pools(chunk),
+                POOL_TYPE_DATA, libcache_ptr->release_index++);
+        if (NULL == record) {
+            // Note: locked records stay where they are, the chunk is walked again later
+            libcache_ptr->release_index = 0;
+            break;
+        }
+        budget--;
+
+        libcache_record_t* target;
+        if (libcache_is_cached(libcache_ptr, record) && 0 == record->lock_counter && NULL != (target = libcache_take_record(libcache_ptr))) {
+            libcache_move_record(libcache_ptr, record, target);
+        }
+    }
+
+    return libcache_resize_pending(libcache_ptr);
+}
+
+/*
+ *  @brief libcache_lookup   To look up an cache entry with a given key.
+ *
+ *  @param libcache          cache object, cannot be NULL.
+ *  @param key               key, cannot be NULL.
+ *  @param dst_entry         a copy of entry that fetch by key. it could be NULL.
+ *  @return NULL             didn't find out such entry with the key.
+ *          pointer          points to an entry with the key.
+ *  NOTE:  The entry in cache will be locked if dst_entry is NULL, one entry can be locked many times.
+ *         libcache_unlock_entry should be called to unlock the entry when the entry is not being used this time.
+ */
+void* libcache_lookup(void* libcache, const void* key, void* dst_entry)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return NULL;
+    }
+
+    if (unlikely(NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", "key");
+        return NULL;
+    }
+
+    void* return_value = NULL;
+
+    do {
+        // Note: find the entry according to key
+        libcache_record_t* record = libcache_find_record(libcache_ptr, callbacks, key, callbacks->key_to_number(key));
+        if (unlikely(NULL == record)) {
+            break;
+        }
+
+        if (NULL == dst_entry) {
+            // Note: lock should be added here
+            record->lock_counter++;
+
+            return_value = libcache_get_record_entry(libcache_ptr, record);
+        } else {
+            // Note: copy into dst_entry and return NULL, no lock added too
+            memcpy(dst_entry, libcache_get_record_entry(libcache_ptr, record), libcache_ptr->entry_size);
+            return_value = dst_entry;
+        }
+
+        // Note: put the newest found node in front of list
+       // list_remove(libcache_ptr->list, libcache_node);
+       // list_push_front(libcache_ptr->list, libcache_node);
+
+        libcache_lru_move_to_front(libcache_ptr, record);
+        libcache_touch_record(libcache_ptr, record);
+
+    } while(0);
+
+    return return_value;
+}
+
+/*
+ *  @brief libcache_peek     looks up an entry without locking it or moving it in the LRU list.
+ *
+ *  @param libcache          cache object, cannot be NULL.
+ *  @param key               key, cannot be NULL.
+ *  @param dst_entry         a copy of entry that fetch by key. it could be NULL.
+ *  @return NULL             didn't find out such entry with the key.
+ *          pointer          points to the entry in the cache (not to dst_entry).
+ *  NOTE:  The cache is only read, so several readers may peek at once while nobody modifies it.
+ */
+void* libcache_peek(const void* libcache, const void* key, void* dst_entry)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return NULL;
+    }
+
+    if (unlikely(NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", "key");
+        return NULL;
+    }
+
+    libcache_record_t* record = libcache_find_record(libcache_ptr, callbacks, key, callbacks->key_to_number(key));
+    if (NULL == record) {
+        return NULL;
+    }
+
+    void* entry = libcache_get_record_entry(libcache_ptr, record);
+    if (NULL != dst_entry) {
+        memcpy(dst_entry, entry, libcache_ptr->entry_size);
+    }
+    return entry;
+}
+
+/*
+ *  @brief libcache_promote_entry   moves an entry to the head of the LRU list, e.g. for a deferred hit.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry in the cache.
+ *  @return
+ *          LIBCACHE_NOT_FOUND      the entry isn't in the cache (any more).
+ *          LIBCACHE_SUCCESS        the entry was moved.
+ */
+libcache_ret_t libcache_promote_entry(void* libcache, void* entry)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == entry)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "entry");
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_record_t* record = libcache_get_entry_record(libcache_ptr, entry);
+    if (NULL == record) {
+        return LIBCACHE_NOT_FOUND;
+    }
+
+    libcache_lru_move_to_front(libcache_ptr, record);
+    libcache_touch_record(libcache_ptr, record);
+    return LIBCACHE_SUCCESS;
+}
+
+/*
+ *  @brief libcache_insert_record    takes a record for a key that isn't in the cache and links it at the head
+ *                                   of its bucket and of the LRU list, the oldest unlocked entry is swapped out
+ *                                   if the cache is full. The entry isn't written.
+ *
+ *  @param bucket                    bucket of fingerprint, found before by the caller.
+ *  @return NULL                     all entries are locked.
+ *  NOTE:   The bucket stays valid as swapping out only changes the chains, not the bucket table.
+ */
+static libcache_record_t* libcache_insert_record(libcache_t* libcache_ptr, libcache_handle_t* bucket,
+        const void* key, uint32_t fingerprint)
+{
+    // Note: if cache pool is full, check unlocked node in libcache list back
+    if (unlikely(libcache_ptr->max_entry_number <= libcache_ptr->entry_number)) {
+        // Note: if no unlocked node in libcache list, return directly
+        DEBUG_INFO("the cache is full, try to swap old data out");
+        libcache_record_t* unlocked_record = libcache_find_unlocked_record(libcache_ptr);
+        if (unlikely(NULL == unlocked_record)) {
+            DEBUG_INFO("all data are in use, swap failed!");
+            return NULL;
+        }
+        DEBUG_INFO("swap data successfully!");
+        libcache_remove_record(libcache_ptr, unlocked_record);
+    }
+
+    // Note: after a shrink the swapped out record may be in a chunk being released, which frees no slot
+    //       of the kept chunks. Entries are swapped out until a kept chunk has a free slot.
+    libcache_record_t* record;
+    while (NULL == (record = libcache_take_record(libcache_ptr))) {
+        libcache_record_t* unlocked_record = libcache_find_unlocked_record(libcache_ptr);
+        if (unlikely(NULL == unlocked_record)) {
+            DEBUG_INFO("all data are in use, swap failed!");
+            return NULL;
+        }
+        libcache_remove_record(libcache_ptr, unlocked_record);
+    }
+    record->lock_counter = 0;
+    libcache_lru_push_front(libcache_ptr, record);
+
+    memcpy(libcache_get_record_key(record), key, libcache_ptr->key_size);
+    // Note: add record into hash
+    record->fingerprint = fingerprint;
+    record->hash_next = *bucket;
+    *bucket = record->handle;
+    return record;
+}
+
+/*
+ *  @brief libcache_add         attempts to add an entry with a given key.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param key                  key, cannot be NULL.
+ *  @param src_entry            entry with an expected value to add.
+ *  @return NULL                could not add the entry because an entry with the same key is existing.
+ *          pointer             points to an entry with the key, so user can write value to it.
+ *  NOTE:   The entry in cache will be locked if src_entry is NULL, one entry can be locked many times.
+ *          libcache_unlock_entry should be called to unlock the e ntry when the entry is not being used this time.
+ */
+void* libcache_add(void * libcache, const void* key, const void* src_entry)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return NULL;
+    }
+
+    if (unlikely(NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", "key");
+        return NULL;
+    }
+
+    if (unlikely(libcache_resize_pending(libcache_ptr))) {
+        libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+    }
+
+    void* return_value = NULL;
+
+    // Note: find node, if node isn't existed and add it
+    do {
+        // Note: find node from hash by key, so not add the data
+        uint32_t fingerprint = callbacks->key_to_number(key);
+        libcache_handle_t* bucket = libcache_get_bucket(libcache_ptr, fingerprint);
+        if (unlikely(NULL != libcache_find_in_bucket(libcache_ptr, callbacks, bucket, key, fingerprint))) {
+            DEBUG_INFO("the key is existed in cache");
+            break;
+        }
+
+        libcache_record_t* record = libcache_insert_record(libcache_ptr, bucket, key, fingerprint);
+        if (unlikely(NULL == record)) {
+            break;
+        }
+
+        return_value = libcache_get_record_entry(libcache_ptr, record);
+        if (NULL != src_entry) {
+            memcpy(return_value, src_entry, libcache_ptr->entry_size);
+            libcache_link_secondaries(libcache_ptr, record);
+        } else {
+            record->lock_counter++;
+        }
+    } while (0);
+
+return return_value;
+}
+
+/*
+ *  @brief libcache_get_or_add  looks up the entry with a given key and adds it if it isn't in the cache,
+ *                              the key is hashed once and its bucket chain walked once.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param key                  key, cannot be NULL.
+ *  @param init_entry           entry copied into the cache when the key is added, it could be NULL.
+ *  @param inserted             output, TRUE if the entry was added, FALSE if it was found. it could be NULL.
+ *  @return NULL                the key wasn't found and could not be added because all entries are locked.
+ *          pointer             points to the entry with the key.
+ *  NOTE:   The returned entry is locked either way, libcache_unlock_entry should be called when the entry
+ *          is not being used this time. A found entry is moved to the head of the LRU list like by libcache_lookup.
+ */
+void* libcache_get_or_add(void * libcache, const void* key, const void* init_entry, int* inserted)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return NULL;
+    }
+
+    if (unlikely(NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", "key");
+        return NULL;
+    }
+
+    if (NULL != inserted) {
+        *inserted = FALSE;
+    }
+
+    // Note: the resize slice runs first, it may move the key to another bucket
+    if (unlikely(libcache_resize_pending(libcache_ptr))) {
+        libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+    }
+
+    uint32_t fingerprint = callbacks->key_to_number(key);
+    libcache_handle_t* bucket = libcache_get_bucket(libcache_ptr, fingerprint);
+    libcache_record_t* record = libcache_find_in_bucket(libcache_ptr, callbacks, bucket, key, fingerprint);
+    if (NULL != record) {
+        libcache_lru_move_to_front(libcache_ptr, record);
+        libcache_touch_record(libcache_ptr, record);
+    } else {
+        record = libcache_insert_record(libcache_ptr, bucket, key, fingerprint);
+        if (unlikely(NULL == record)) {
+            return NULL;
+        }
+        if (NULL != init_entry) {
+            memcpy(libcache_get_record_entry(libcache_ptr, record), init_entry, libcache_ptr->entry_size);
+            libcache_link_secondaries(libcache_ptr, record);
+        }
+        if (NULL != inserted) {
+            *inserted = TRUE;
+        }
+    }
+
+    record->lock_counter++;
+    return libcache_get_record_entry(libcache_ptr, record);
+}
+
+/*
+ *  @brief libcache_put         adds an entry with a given key or overwrites the entry of the key in place.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param key                  key, cannot be NULL.
+ *  @param src_entry            entry with the value to store, cannot be NULL.
+ *  @param flags                LIBCACHE_PUT_NO_PROMOTE | LIBCACHE_PUT_REPLACE, or 0.
+ *  @return
+ *          LIBCACHE_NOT_FOUND  LIBCACHE_PUT_REPLACE is set and no entry has the key.
+ *          LIBCACHE_FULL       the key could not be added because all entries are locked.
+ *          LIBCACHE_SUCCESS    the entry was stored.
+ *  NOTE:   An existing entry is overwritten even if it's locked, its slot and key aren't touched.
+ *          The entry isn't locked after the call.
+ */
+libcache_ret_t libcache_put(void * libcache, const void* key, const void* src_entry, int flags)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(NULL == key || NULL == src_entry)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == key) ? "key" : "src_entry");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libcache_resize_pending(libcache_ptr))) {
+        libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+    }
+
+    uint32_t fingerprint = callbacks->key_to_number(key);
+    libcache_handle_t* bucket = libcache_get_bucket(libcache_ptr, fingerprint);
+    libcache_record_t* record = libcache_find_in_bucket(libcache_ptr, callbacks, bucket, key, fingerprint);
+    if (NULL != record) {
+        // Note: the access time is still updated, the entry isn't idle for libcache_expire
+        if (0 == (flags & LIBCACHE_PUT_NO_PROMOTE)) {
+            libcache_lru_move_to_front(libcache_ptr, record);
+        }
+        libcache_touch_record(libcache_ptr, record);
+        // Note: the keys of the secondary indexes may change with the entry
+        libcache_unlink_secondaries(libcache_ptr, record);
+    } else {
+        if (flags & LIBCACHE_PUT_REPLACE) {
+            return LIBCACHE_NOT_FOUND;
+        }
+        record = libcache_insert_record(libcache_ptr, bucket, key, fingerprint);
+        if (unlikely(NULL == record)) {
+            return LIBCACHE_FULL;
+        }
+    }
+
+    memcpy(libcache_get_record_entry(libcache_ptr, record), src_entry, libcache_ptr->entry_size);
+    libcache_link_secondaries(libcache_ptr, record);
+    return LIBCACHE_SUCCESS;
+}
+
+/*
+ *  @brief libcache_prefetch_group    hashes a group of keys and prefetches their buckets, then the first record
+ *                                    of each chain, so the chain walks of the group don't wait on each other.
+ */
+static void libcache_prefetch_group(const libcache_t* libcache_ptr, const libcache_callbacks_t* callbacks,
+        const char* keys, int count, uint32_t fingerprints[], libcache_handle_t* buckets[])
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        fingerprints[i] = callbacks->key_to_number(keys + i * libcache_ptr->key_size);
+        buckets[i] = libcache_get_bucket(libcache_ptr, fingerprints[i]);
+        __builtin_prefetch(buckets[i], 0, 3);
+    }
+    for (i = 0; i < count; i++) {
+        libcache_record_t* record = libcache_get_record(libcache_ptr, *buckets[i]);
+        if (NULL != record) {
+            __builtin_prefetch(record, 0, 3);
+        }
+    }
+}
+
+/*
+ *  @brief libcache_free_records    frees unlinked records, the ones of a chunk go back to its pool together.
+ */
+static void libcache_free_records(libcache_t* libcache_ptr, libcache_record_t* records[], int count)
+{
+    void* elements[LIBCACHE_BATCH_GROUP];
+    int i;
+    for (i = 0; i < count; i++) {
+        libcache_tag_unlink(libcache_ptr, records[i]);
+        libcache_unlink_secondaries(libcache_ptr, records[i]);
+    }
+    while (count > 0) {
+        libcache_chunk_t* chunk = &libcache_ptr->chunks[records[0]->handle >> LIBCACHE_CHUNK_SHIFT];
+        libcache_meta_t meta = libcache_get_meta(chunk);
+        int element_count = 0;
+        int rest = 0;
+        for (i = 0; i < count; i++) {
+            if (&libcache_ptr->chunks[records[i]->handle >> LIBCACHE_CHUNK_SHIFT] == chunk) {
+                meta.cached[libcache_get_record_slot(records[i])] = FALSE;
+                elements[element_count++] = records[i];
+            } else {
+                records[rest++] = records[i];
+            }
+        }
+        chunk->live -= element_count;
+        pool_free_elements(libcache_get_chunk_pools(chunk), POOL_TYPE_DATA, elements, element_count);
+        count = rest;
+    }
+}
+
+/*
+ *  @brief libcache_add_batch   adds entries, like libcache_add with src_entry for each key.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param keys                 count keys, key i is at (char*) keys + i * key_size, cannot be NULL.
+ *  @param src_entries          count entries, entry i is at (char*) src_entries + i * entry_size, cannot be NULL.
+ *  @param count                number of keys.
+ *  @param results              output, count results, it could be NULL.
+ *          LIBCACHE_FAILURE    an entry with the same key is existing (or was added before in the batch).
+ *          LIBCACHE_FULL       all entries are locked, nothing could be swapped out.
+ *          LIBCACHE_SUCCESS    the entry was added.
+ *  @return                     number of entries added.
+ *  NOTE:   Keys are handled in groups, the buckets of a group are prefetched before its chains are walked.
+ */
+libcache_scale_t libcache_add_batch(void * libcache, const void* keys, const void* src_entries,
+        libcache_scale_t count, libcache_ret_t results[])
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return 0;
+    }
+
+    if (unlikely(NULL == keys || NULL == src_entries)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == keys) ? "keys" : "src_entries");
+        return 0;
+    }
+
+    uint32_t fingerprints[LIBCACHE_BATCH_GROUP];
+    libcache_handle_t* buckets[LIBCACHE_BATCH_GROUP];
+    libcache_scale_t added = 0;
+    libcache_scale_t first;
+    for (first = 0; first < count; first += LIBCACHE_BATCH_GROUP) {
+        // Note: the resize slice runs between groups, the buckets of a group stay where they are
+        if (unlikely(libcache_resize_pending(libcache_ptr))) {
+            libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+        }
+
+        int group = (count - first < LIBCACHE_BATCH_GROUP) ? (int) (count - first) : LIBCACHE_BATCH_GROUP;
+        const char* key = (const char*) keys + first * libcache_ptr->key_size;
+        const char* src_entry = (const char*) src_entries + first * libcache_ptr->entry_size;
+        libcache_prefetch_group(libcache_ptr, callbacks, key, group, fingerprints, buckets);
+
+        int i;
+        for (i = 0; i < group; i++, key += libcache_ptr->key_size, src_entry += libcache_ptr->entry_size) {
+            libcache_ret_t ret = LIBCACHE_FAILURE;
+            if (NULL == libcache_find_in_bucket(libcache_ptr, callbacks, buckets[i], key, fingerprints[i])) {
+                libcache_record_t* record = libcache_insert_record(libcache_ptr, buckets[i], key, fingerprints[i]);
+                if (NULL != record) {
+                    memcpy(libcache_get_record_entry(libcache_ptr, record), src_entry, libcache_ptr->entry_size);
+                    libcache_link_secondaries(libcache_ptr, record);
+                    added++;
+                    ret = LIBCACHE_SUCCESS;
+                } else {
+                    ret = LIBCACHE_FULL;
+                }
+            }
+            if (NULL != results) {
+                results[first + i] = ret;
+            }
+        }
+    }
+
+    return added;
+}
+
+/*
+ *  @brief libcache_delete_batch    deletes entries, like libcache_delete_by_key for each key.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param keys                     count keys, key i is at (char*) keys + i * key_size, cannot be NULL.
+ *  @param count                    number of keys.
+ *  @param results                  output, count results, it could be NULL.
+ *          LIBCACHE_NOT_FOUND      entry wasn't found.
+ *          LIBCACHE_LOCKED         the entry was unable to deleted because it's locked.
+ *          LIBCACHE_SUCCESS        the entry was deleted successfully.
+ *  @return                         number of entries deleted.
+ *  NOTE:   Keys are handled in groups, the buckets of a group are prefetched before its chains are walked,
+ *          the records deleted in a group go back to their pools together.
+ */
+libcache_scale_t libcache_delete_batch(void * libcache, const void* keys, libcache_scale_t count,
+        libcache_ret_t results[])
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return 0;
+    }
+
+    if (unlikely(NULL == keys)) {
+        DEBUG_ERROR("input parameter %s is null", "keys");
+        return 0;
+    }
+
+    uint32_t fingerprints[LIBCACHE_BATCH_GROUP];
+    libcache_handle_t* buckets[LIBCACHE_BATCH_GROUP];
+    libcache_record_t* records[LIBCACHE_BATCH_GROUP];
+    libcache_scale_t deleted = 0;
+    libcache_scale_t first;
+    for (first = 0; first < count; first += LIBCACHE_BATCH_GROUP) {
+        if (unlikely(libcache_resize_pending(libcache_ptr))) {
+            libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+        }
+
+        int group = (count - first < LIBCACHE_BATCH_GROUP) ? (int) (count - first) : LIBCACHE_BATCH_GROUP;
+        const char* key = (const char*) keys + first * libcache_ptr->key_size;
+        libcache_prefetch_group(libcache_ptr, callbacks, key, group, fingerprints, buckets);
+
+        int record_count = 0;
+        int i;
+        for (i = 0; i < group; i++, key += libcache_ptr->key_size) {
+            libcache_ret_t ret = LIBCACHE_SUCCESS;
+            libcache_record_t* record = libcache_find_in_bucket(libcache_ptr, callbacks, buckets[i], key, fingerprints[i]);
+            if (NULL == record) {
+                ret = LIBCACHE_NOT_FOUND;
+            } else if (record->lock_counter > 0) {
+                ret = LIBCACHE_LOCKED;
+            } else {
+                // Note: unlinked now, freed with the rest of the group
+                libcache_unlink_record(libcache_ptr, record);
+                libcache_lru_remove(libcache_ptr, record);
+                records[record_count++] = record;
+            }
+            if (NULL != results) {
+                results[first + i] = ret;
+            }
+        }
+
+        libcache_free_records(libcache_ptr, records, record_count);
+        deleted += record_count;
+    }
+
+    return deleted;
+}
+
+/*
+ *  @brief libcache_delete_by_key attempts to delete an entry with a given key.
+ *
+ *  @param libcache               cache object, cannot be NULL.
+ *  @param key                    key, cannot be NULL.
+ *  @return
+ *          LIBCACHE_NOT_FOUND    entry wasn't found.
+ *          LIBCACHE_LOCKED       the entry was unable to deleted because it's locked.
+ *          LIBCACHE_SUCCESS      the entry was deleted successfully.
+ */
+libcache_ret_t  libcache_delete_by_key(void * libcache, const void* key)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", "key");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libcache_resize_pending(libcache_ptr))) {
+        libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+    }
+
+    libcache_ret_t return_value = LIBCACHE_SUCCESS;
+    do {
+        libcache_record_t* record = libcache_find_record(libcache_ptr, callbacks, key, callbacks->key_to_number(key));
+        if (NULL == record) {
+            return_value = LIBCACHE_NOT_FOUND;
+            break;
+        }
+
+        // Note: if the entry is locked, just return
+        if (record->lock_counter > 0) {
+            return_value = LIBCACHE_LOCKED;
+            break;
+        }
+
+        libcache_remove_record(libcache_ptr, record);
+
+        return_value = LIBCACHE_SUCCESS;
+    } while(0);
+
+    return return_value;
+}
+
+/*
+ *  @brief libcache_delete_entry   attempts to delete an entry.
+ *
+ *  @param libcache                cache object, cannot be NULL.
+ *  @param entry                   entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @return
+*           LIBCACHE_NOT_FOUND     entry wasn't found.
+*           LIBCACHE_LOCKED        entry was unable to deleted while it's locked.
+ *          LIBCACHE_SUCCESS       entry was deleted successfully.
+ */
+libcache_ret_t  libcache_delete_entry(void * libcache, void* entry)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_ret_t return_value = LIBCACHE_FAILURE;
+
+    do {
+        // Note: judge whether entry is existed in cache
+        libcache_record_t* record = libcache_get_entry_record(libcache_ptr, entry);
+        if (record == NULL) {
+            return_value = LIBCACHE_NOT_FOUND;
+            break;
+        }
+
+        // Note: judge whether entry is locked
+        if (record->lock_counter > 0) {
+            return_value = LIBCACHE_LOCKED;
+            break;
+        }
+
+        libcache_remove_record(libcache_ptr, record);
+        return_value = LIBCACHE_SUCCESS;
+    } while(0);
+
+    return return_value;
+}
+
+/*
+ *  @brief libcache_unlock_entry    attempts to unlock an entry.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @return
+ *          LIBCACHE_UNLOCKED       the entry is already unlocked,
+ *                                  this indicates unpaired locking & unlocking issue happened.
+ *          LIBCACHE_SUCCESS        the entry was unlocked successfully once.
+ */
+libcache_ret_t libcache_unlock_entry(void * libcache, void* entry)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(entry == NULL)) {
+        DEBUG_ERROR("input parameter %s is null", "entry");
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_ret_t return_value = LIBCACHE_FAILURE;
+
+    libcache_record_t* record = libcache_get_entry_record(libcache_ptr, entry);
+
+    if (NULL == record) {
+        return_value = LIBCACHE_NOT_FOUND;
+    } else {
+        // Note: unlock entry
+        if (record->lock_counter == 0) {
+            return_value = LIBCACHE_UNLOCKED;
+        } else {
+            record->lock_counter--;
+            return_value = LIBCACHE_SUCCESS;
+        }
+    }
+
+    return return_value;
+}
+
+/*
+ *  @brief libcache_get_max_entry_number    gets a capacity of the maximum number of entries this cache can store.
+ *
+ *  @param libcache                         cache object, cannot be NULL.
+ *  @return
+ *         the number
+ */
+libcache_scale_t libcache_get_max_entry_number(const void * libcache)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+    return libcache_ptr->max_entry_number -1;
+}
+
+/*
+ *  @brief libcache_get_entry_number         gets the number of entries this cache stores.
+ *
+ *  @param libcache                          cache object, cannot be NULL.
+ *  @return
+ *         the number
+ */
+libcache_scale_t libcache_get_entry_number(const void * libcache)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    return libcache_ptr->entry_number;
+}
+
+static libcache_ret_t libcache_add_chunk(libcache_t* libcache_ptr, libcache_scale_t capacity)
+{
+    if (unlikely(capacity > LIBCACHE_MAX_CHUNK_RECORDS)) {
+        DEBUG_ERROR("argument %s is too large.", "max_entry_number");
+        return LIBCACHE_FAILURE;
+    }
+
+    // Note: | pools of the records | metadata |, the mapping is zeroed so no record is cached yet
+    pool_attr_t pool_attr = { libcache_get_record_length(libcache_ptr->entry_size, libcache_ptr->key_size), capacity };
+    size_t pools_size = (pool_caculate_total_length(1, &pool_attr) + LIBCACHE_SCAN_BLOCK - 1) & ~((size_t) LIBCACHE_SCAN_BLOCK - 1);
+    size_t memory_size = pools_size + libcache_get_meta_length(capacity);
+    void* memory = arena_alloc(memory_size);
+    if (unlikely(memory == NULL)) {
+        DEBUG_ERROR("Memory map of %zu bytes failed!", memory_size);
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_chunk_t* chunk = &libcache_ptr->chunks[libcache_ptr->chunk_count];
+    chunk->capacity = capacity;
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        if (unlikely(LIBCACHE_SUCCESS != libcache_map_secondary_links(libcache_ptr, &libcache_ptr->secondaries[i],
+                libcache_ptr->chunk_count))) {
+            while (--i >= 0) {
+                arena_free(offset_ptr_get(&libcache_ptr->secondaries[i].links[libcache_ptr->chunk_count]),
+                        libcache_get_secondary_links_length(capacity));
+            }
+            arena_free(memory, memory_size);
+            return LIBCACHE_FAILURE;
+        }
+    }
+
+    void* pools = pools_init(memory, memory_size, 1, &pool_attr);
+    size_t record_stride;
+    offset_ptr_set(&chunk->pools, pools);
+    offset_ptr_set(&chunk->records, pool_get_elements(pools, POOL_TYPE_DATA, &record_stride));
+    offset_ptr_set(&chunk->meta, (char*) memory + pools_size);
+    chunk->memory_size = memory_size;
+    chunk->live = 0;
+    libcache_ptr->chunk_count++;
+    libcache_ptr->kept_chunk_count = libcache_ptr->chunk_count;
+    return LIBCACHE_SUCCESS;
+}
+
+/* Note: the new table is mapped zeroed, the records are moved to it by libcache_resize_work */
+static libcache_ret_t libcache_resize_buckets(libcache_t* libcache_ptr, uint32_t bucket_bits)
+{
+    size_t buckets_size = libcache_get_buckets_length(bucket_bits);
+    void* buckets = arena_alloc(buckets_size);
+    if (unlikely(buckets == NULL)) {
+        DEBUG_ERROR("Memory map of %zu bytes failed!", buckets_size);
+        return LIBCACHE_FAILURE;
+    }
+
+    offset_ptr_set(&libcache_ptr->old_buckets, offset_ptr_get(&libcache_ptr->buckets));
+    libcache_ptr->old_buckets_size = libcache_ptr->buckets_size;
+    libcache_ptr->old_bucket_bits = libcache_ptr->bucket_bits;
+    libcache_ptr->rehash_index = 0;
+
+    offset_ptr_set(&libcache_ptr->buckets, buckets);
+    libcache_ptr->buckets_size = buckets_size;
+    libcache_ptr->bucket_bits = bucket_bits;
+    return LIBCACHE_SUCCESS;
+}
+
+/*
+ *  @brief libcache_resize          changes the maximum number of entries of a cache in use.
+ *
+ *  @param libcache                 cache object, cannot be NULL, it cannot be a shared one.
+ *  @param max_entry_number         the new maximum entry number.
+ *  @return
+ *      LIBCACHE_FAILURE            the cache is shared, or memory for the new capacity can't be had.
+ *      LIBCACHE_LOCKED             the work of the last resize isn't finished, see libcache_resize_step.
+ *      LIBCACHE_SUCCESS            the new maximum is in force, entries above it are swapped out
+ *                                  and memory not needed is returned in slices by the next calls
+ *                                  of libcache_add, libcache_delete_by_key and libcache_resize_step.
+ */
+libcache_ret_t libcache_resize(void * libcache, libcache_scale_t max_entry_number)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
+
+    // Note: another process may be using the records of a shared cache
+    if (unlikely(0 != libcache_ptr->shm_header)) {
+        DEBUG_ERROR("%s", "a shared cache can't be resized");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (libcache_resize_pending(libcache_ptr)) {
+        return LIBCACHE_LOCKED;
+    }
+
+    libcache_scale_t max_entry = max_entry_number + 1;
+    libcache_scale_t capacity = 0;
+    int kept_chunk_count;
+    for (kept_chunk_count = 0; kept_chunk_count < libcache_ptr->chunk_count && capacity < max_entry; kept_chunk_count++) {
+        capacity += libcache_ptr->chunks[kept_chunk_count].capacity;
+    }
+
+    int chunk_added = FALSE;
+    if (capacity < max_entry) {
+        if (unlikely(LIBCACHE_MAX_CHUNKS == libcache_ptr->chunk_count)) {
+            DEBUG_ERROR("%s", "no chunk left to grow the cache");
+            return LIBCACHE_FAILURE;
+        }
+        if (unlikely(LIBCACHE_SUCCESS != libcache_add_chunk(libcache_ptr, max_entry - capacity))) {
+            return LIBCACHE_FAILURE;
+        }
+        chunk_added = TRUE;
+    } else {
+        // Note: chunk 0 lives in the cache block, it's never released
+        libcache_ptr->kept_chunk_count = kept_chunk_count;
+        libcache_ptr->release_index = 0;
+    }
+
+    // Note: every table is mapped before one is switched, a failure leaves all the indexes as they were
+    uint32_t bucket_bits = libcache_get_bucket_bits(max_entry);
+    void* secondary_buckets[LIBCACHE_MAX_SECONDARIES] = { NULL };
+    if (unlikely(LIBCACHE_SUCCESS != libcache_map_secondary_buckets(libcache_ptr, bucket_bits, secondary_buckets))
+            || (bucket_bits != libcache_ptr->bucket_bits
+                    && unlikely(LIBCACHE_SUCCESS != libcache_resize_buckets(libcache_ptr, bucket_bits)))) {
+        libcache_unmap_secondary_buckets(libcache_ptr, bucket_bits, secondary_buckets);
+        // Note: the chunk added above holds no record yet, the old capacity stays in force
+        if (chunk_added) {
+            libcache_unmap_last_chunk(libcache_ptr);
+        }
+        libcache_ptr->kept_chunk_count = libcache_ptr->chunk_count;
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_ptr->max_entry_number = max_entry;
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        if (NULL != secondary_buckets[i]) {
+            libcache_resize_secondary_buckets(&libcache_ptr->secondaries[i], bucket_bits, secondary_buckets[i]);
+        }
+    }
+    libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
+    return LIBCACHE_SUCCESS;
+}
+
+/*
+ *  @brief libcache_resize_step     does one bounded slice of the work left by libcache_resize.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @return
+ *      LIBCACHE_LOCKED             work is left, locked entries keep their chunk until they are unlocked.
+ *      LIBCACHE_SUCCESS            the resize is finished.
+ */
+libcache_ret_t libcache_resize_step(void * libcache)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return LIBCACHE_FAILURE;
+    }
 
-    return libcache;
+    return libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE) ? LIBCACHE_LOCKED : LIBCACHE_SUCCESS;
 }
 
 /*
- *  @brief libcache_lookup   To look up an cache entry with a given key.
+ *  @brief libcache_set_clock       sets the tick stamped on entries when they are added or looked up.
  *
- *  @param libcache          cache object, cannot be NULL.
- *  @param key               key, cannot be NULL.
- *  @param dst_entry         a copy of entry that fetch by key. it could be NULL.
- *  @return NULL             didn't find out such entry with the key.
- *          pointer          points to an entry with the key.
- *  NOTE:  The entry in cache will be locked if dst_entry is NULL, one entry can be locked many times.
- *         libcache_unlock_entry should be called to unlock the entry when the entry is not being used this time.
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param now                      current tick, e.g. seconds, it may wrap around.
  */
-void* libcache_lookup(void* libcache, const void* key, void* dst_entry)
+void libcache_set_clock(void * libcache, uint32_t now)
 {
-    libcache_t* libcache_ptr = (libcache_t*)libcache;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
     if (unlikely(NULL == libcache_ptr)) {
         DEBUG_ERROR("input parameter %s is null", "libcache");
-        return NULL;
+        return;
     }
+    libcache_ptr->clock = now;
+}
 
-    if (unlikely(NULL == key)) {
-        DEBUG_ERROR("input parameter %s is null", "key");
-        return NULL;
+/*
+ *  @brief libcache_set_expiry      sets the tick at which an entry expires, see libcache_expire.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @param expiry                   the tick, 0: never (the default of a new entry).
+ *  @return
+ *      LIBCACHE_NOT_FOUND          the entry isn't in the cache (any more).
+ *      LIBCACHE_SUCCESS            the expiry was set.
+ */
+libcache_ret_t libcache_set_expiry(void * libcache, void* entry, uint32_t expiry)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == entry)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "entry");
+        return LIBCACHE_FAILURE;
     }
 
-    void* return_value = NULL;
+    libcache_record_t* record = libcache_get_entry_record(libcache_ptr, entry);
+    if (NULL == record) {
+        return LIBCACHE_NOT_FOUND;
+    }
+    libcache_get_record_meta(libcache_ptr, record).expiry[libcache_get_record_slot(record)] = expiry;
+    return LIBCACHE_SUCCESS;
+}
 
-    do {
-        // Note: find the entry according to key
-        node_t* hash_node = (node_t*)hash_find(libcache_ptr->hash_table, key);
-        if (unlikely(NULL == hash_node)) {
-            break;
-        }
+/*
+ *  @brief libcache_set_tag         sets a tag of an entry, e.g. its service group or gateway, see libcache_count_tags.
+ *                                  The entries of a tag other than 0 are linked, see libcache_foreach_tag.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
+ *  @param tag                      the tag, 0 for a new entry.
+ *  @return
+ *      LIBCACHE_NOT_FOUND          the entry isn't in the cache (any more).
+ *      LIBCACHE_SUCCESS            the tag was set.
+ */
+libcache_ret_t libcache_set_tag(void * libcache, void* entry, uint8_t tag)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == entry)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "entry");
+        return LIBCACHE_FAILURE;
+    }
 
-        node_t* libcache_node = (node_t*)((hash_data_t*)hash_node->usr_data)->cache_node_ptr;
-        if (unlikely(NULL == libcache_node)) {
-            break;
-        }
+    libcache_record_t* record = libcache_get_entry_record(libcache_ptr, entry);
+    if (NULL == record) {
+        return LIBCACHE_NOT_FOUND;
+    }
+    libcache_set_record_tag(libcache_ptr, record, tag);
+    return LIBCACHE_SUCCESS;
+}
 
-        if (NULL == dst_entry) {
-            // Note: lock should be added here
-            ((libcache_node_usr_data_t*)libcache_node->usr_data)->lock_counter++;
+/*
+ *  @brief libcache_expire          deletes the unlocked entries whose expiry is now or before,
+ *                                  or which were not accessed for more than max_idle ticks.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param now                      current tick.
+ *  @param max_idle                 ticks since the last add or lookup, 0: entries don't expire by idling.
+ *  @return                         the number of entries deleted.
+ *  NOTE:   free_entry isn't called, like for the entries swapped out by libcache_add.
+ *          The ticks may wrap, an expiry is in the future while it's less than 2^31 ticks after now.
+ */
+libcache_scale_t libcache_expire(void * libcache, uint32_t now, uint32_t max_idle)
+{
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return 0;
+    }
 
-            return_value = ((libcache_node_usr_data_t*)libcache_node->usr_data)->pool_element_ptr;
-        } else {
-            // Note: copy into dst_entry and return NULL, no lock added too
-            memcpy(dst_entry, ((libcache_node_usr_data_t*)libcache_node->usr_data)->pool_element_ptr, libcache_ptr->entry_size);
-            return_value = dst_entry;
+    uint32_t idle_limit = (0 == max_idle) ? UINT32_MAX : max_idle;
+    libcache_scale_t expired_number = 0;
+    int i;
+    for (i = 0; i < libcache_ptr->chunk_count; i++) {
+        libcache_meta_t meta = libcache_get_meta(&libcache_ptr->chunks[i]);
+        // Note: the metadata of the slots never handed out isn't cleared at create, it's masked out
+        size_t touched = (size_t) pool_get_touched_count(libcache_get_chunk_pools(&libcache_ptr->chunks[i]), POOL_TYPE_DATA);
+        size_t base;
+        for (base = 0; base < touched; base += LIBCACHE_SCAN_BLOCK) {
+            // Note: a block of slots is tested without branches, the compiler turns the loop into vector code
+            uint8_t hits[LIBCACHE_SCAN_BLOCK];
+            uint8_t any = 0;
+            int j;
+            for (j = 0; j < LIBCACHE_SCAN_BLOCK; j++) {
+                // Note: an expiry of 0 never comes, the others are compared modulo 2^32 like the ticks
+                uint8_t expired = (0 != meta.expiry[base + j]) & ((int32_t) (now - meta.expiry[base + j]) >= 0);
+                uint8_t idle = (uint32_t) (now - meta.access[base + j]) > idle_limit;
+                hits[j] = meta.cached[base + j] & (expired | idle) & (base + j < touched);
+                any |= hits[j];
+            }
+            if (likely(!any)) {
+                continue;
+            }
+
+            for (j = 0; j < LIBCACHE_SCAN_BLOCK; j++) {
+                if (hits[j]) {
+                    libcache_handle_t handle = ((libcache_handle_t) i << LIBCACHE_CHUNK_SHIFT) | (libcache_handle_t) (base + j + 1);
+                    libcache_record_t* record = libcache_get_record(libcache_ptr, handle);
+                    if (0 == record->lock_counter) {
+                        libcache_remove_record(libcache_ptr, record);
+                        expired_number++;
+                    }
+                }
+            }
         }
+    }
+    return expired_number;
+}
 
-        // Note: put the newest found node in front of list
-       // list_remove(libcache_ptr->list, libcache_node);
-       // list_push_front(libcache_ptr->list, libcache_node);
+/*
+ *  @brief libcache_count_tags      counts the entries by their tag.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param counts                   output, counts[tag] is the number of entries with the tag.
+ *  @return
+ *      LIBCACHE_SUCCESS            counts was filled.
+ */
+libcache_ret_t libcache_count_tags(const void * libcache, libcache_scale_t counts[256])
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == counts)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "counts");
+        return LIBCACHE_FAILURE;
+    }
 
-        list_swap_to_head(libcache_ptr->list, libcache_node);
+    memcpy(counts, libcache_ptr->tag_counts, sizeof(libcache_ptr->tag_counts));
+    return LIBCACHE_SUCCESS;
+}
 
-    } while(0);
+/*
+ *  @brief libcache_count_by_tag    gets the number of entries with a tag, it's kept up to date by the cache.
+ *
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param tag                      the tag.
+ *  @return                         the number, 0 if libcache is NULL.
+ */
+libcache_scale_t libcache_count_by_tag(const void * libcache, uint8_t tag)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "libcache");
+        return 0;
+    }
 
-    return return_value;
+    return libcache_ptr->tag_counts[tag];
 }
 
 /*
- *  @brief libcache_get_unlock_node  find unlocked node in list.
+ *  @brief libcache_foreach_tag     visits the entries with a tag, in time proportional to their number.
  *
- *  @param node             node in list.
- *  @return 0: traversing over; 1: continue traversing
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param tag                      the tag, not 0: untagged entries aren't indexed.
+ *  @param callback                 called for each entry with the tag, cannot be NULL.
+ *                                  It must not add or delete entries, nor change tags.
+ *  @param arg                      passed to callback.
+ *  @return                         the number of entries visited.
  */
-static inline int libcache_get_unlock_node(node_t *node) {
-    return (((libcache_node_usr_data_t*)node->usr_data)->lock_counter) ? 1 : 0;
+libcache_scale_t libcache_foreach_tag(const void * libcache, uint8_t tag, LIBCACHE_SCAN_ENTRY* callback, void* arg)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == callback)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "callback");
+        return 0;
+    }
+
+    libcache_scale_t items = 0;
+    libcache_handle_t handle = (0 == tag) ? LIBCACHE_NIL : libcache_ptr->tag_heads[tag];
+    while (LIBCACHE_NIL != handle) {
+        libcache_record_t* record = libcache_get_record(libcache_ptr, handle);
+        callback(libcache_get_record_key(record), libcache_get_record_entry(libcache_ptr, record), arg);
+        items++;
+        handle = *libcache_get_tag_next(libcache_ptr, handle);
+    }
+    return items;
 }
 
 /*
- *  @brief libcache_add         attempts to add an entry with a given key.
+ *  @brief libcache_delete_by_tag   deletes the unlocked entries with a tag, e.g. the sessions of a gateway
+ *                                  which went down, in time proportional to the number of entries with the tag.
  *
- *  @param libcache             cache object, cannot be NULL.
- *  @param key                  key, cannot be NULL.
- *  @param src_entry            entry with an expected value to add.
- *  @return NULL                could not add the entry because an entry with the same key is existing.
- *          pointer             points to an entry with the key, so user can write value to it.
- *  NOTE:   The entry in cache will be locked if src_entry is NULL, one entry can be locked many times.
- *          libcache_unlock_entry should be called to unlock the e ntry when the entry is not being used this time.
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param tag                      the tag, not 0: untagged entries aren't indexed.
+ *  @return                         the number of entries deleted, locked entries keep the tag.
+ *  NOTE:   free_entry isn't called, like for the entries swapped out by libcache_add.
  */
-void* libcache_add(void * libcache, const void* key, const void* src_entry)
+libcache_scale_t libcache_delete_by_tag(void * libcache, uint8_t tag)
 {
-    libcache_t* libcache_ptr = (libcache_t*) libcache;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
     if (unlikely(NULL == libcache_ptr)) {
         DEBUG_ERROR("input parameter %s is null", "libcache");
-        return NULL;
+        return 0;
     }
 
-    if (unlikely(NULL == key)) {
-        DEBUG_ERROR("input parameter %s is null", "key");
-        return NULL;
+    libcache_scale_t deleted = 0;
+    libcache_handle_t handle = (0 == tag) ? LIBCACHE_NIL : libcache_ptr->tag_heads[tag];
+    while (LIBCACHE_NIL != handle) {
+        libcache_record_t* record = libcache_get_record(libcache_ptr, handle);
+        // Note: the next one is read before the record is freed
+        handle = *libcache_get_tag_next(libcache_ptr, handle);
+        if (0 == record->lock_counter) {
+            libcache_remove_record(libcache_ptr, record);
+            deleted++;
+        }
     }
+    return deleted;
+}
 
-    void* return_value = NULL;
-
-    // Note: find node, if node isn't existed and add it
-    do {
-        // Note: find node from hash by key, so not add the data
-        node_t* hash_node = (node_t*) hash_find(libcache_ptr->hash_table, key);
-        if (unlikely(NULL != hash_node)) {
-            DEBUG_INFO("the key is existed in cache");
-            break;
+/*
+ *  @brief libcache_scan_range    visits the records of the buckets of a table which cover bucket index of
+ *                                a table with bits, bits isn't larger than table_bits.
+ */
+static libcache_scale_t libcache_scan_range(const libcache_t* libcache_ptr, const libcache_handle_t* table,
+        uint32_t table_bits, uint32_t index, uint32_t bits, LIBCACHE_SCAN_ENTRY* callback, void* arg)
+{
+    libcache_scale_t items = 0;
+    uint32_t bucket = index << (table_bits - bits);
+    uint32_t end = bucket + (1U << (table_bits - bits));
+    for (; bucket < end; bucket++) {
+        libcache_record_t* record = libcache_get_record(libcache_ptr, table[bucket]);
+        while (NULL != record) {
+            callback(libcache_get_record_key(record), libcache_get_record_entry(libcache_ptr, record), arg);
+            items++;
+            record = libcache_get_record(libcache_ptr, record->hash_next);
         }
+    }
+    return items;
+}
 
-        node_t* unlock_node = NULL;
-        libcache_node_usr_data_t* cache_data;
-
-        // Note: if cache pool is full, check unlocked node in libcache list back
-        if (unlikely(libcache_ptr->max_entry_number <= libcache_ptr->list->total_nodes)) {
-            // Note: if no unlocked node in libcache list, return directly
-            DEBUG_INFO("the cache is full, try to swap old data out");
-            unlock_node = list_reverse_foreach(libcache_ptr->list, libcache_get_unlock_node);
-            if (unlikely(NULL == unlock_node)) {
-                DEBUG_INFO("all data are in use, swap failed!");
-                break;
-            } else { // Note: if have unlocked node in libcache list
-                DEBUG_INFO("swap data successfully!");
-                list_swap_to_head(libcache_ptr->list, unlock_node);
-                cache_data = (libcache_node_usr_data_t*) unlock_node->usr_data;
-
-                hash_node = hash_del(libcache_ptr->hash_table, cache_data->key, cache_data->hash_node_ptr, libcache_ptr->pool);
-                memset(cache_data->key, 0, libcache_ptr->key_size);
-            }
-        } else { // Note: if cache pool is not full, create new node
-            unlock_node = (node_t*) pool_get_element(libcache_ptr->pool, POOL_TYPE_NODE_T);
-            unlock_node->usr_data = pool_get_element(libcache_ptr->pool, POOL_TYPE_LIBCACHE_NODE_USR_DATA_T);
-            cache_data = (libcache_node_usr_data_t*) unlock_node->usr_data;
-            cache_data->key = pool_get_element(libcache_ptr->pool, POOL_TYPE_KEY_SIZE);
-            cache_data->pool_element_ptr = pool_get_element(libcache_ptr->pool, POOL_TYPE_DATA);
-            cache_data->lock_counter = 0;
+/*
+ *  @brief libcache_scan        visits the entries of a slice of the index, the scan is resumed by the cursor
+ *                              returned, until it returns 0.
+ *
+ *  @param libcache             cache object, cannot be NULL.
+ *  @param cursor               0 to start a scan, else the cursor returned by the previous call.
+ *  @param max_items            the call returns once about max_items entries, or ten times as many
+ *                              empty buckets, were visited. A bucket is always visited as a whole.
+ *  @param callback             called for each entry visited, cannot be NULL.
+ *  @param arg                  passed to callback.
+ *  @return                     cursor of the next call, 0 when the scan is done.
+ *  NOTE:   The cache may be changed and resized between two calls. An entry in the cache for the whole
+ *          scan is visited at least once, one added or deleted meanwhile may be visited or not.
+ *          callback must not add or delete entries.
+ */
+uint32_t libcache_scan(const void * libcache, uint32_t cursor, libcache_scale_t max_items,
+        LIBCACHE_SCAN_ENTRY* callback, void* arg)
+{
+    const libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == callback)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "callback");
+        return 0;
+    }
 
-            list_push_front(libcache_ptr->list, unlock_node);
-            pool_set_reserved_pointer(cache_data->pool_element_ptr, (void*) unlock_node);
+    libcache_scale_t items = 0;
+    libcache_scale_t buckets = 0;
+    do {
+        // Note: bucket i holds the hashes (fingerprint * golden ratio) whose top bits are i, the cursor is the
+        //       lowest hash not visited. It stays valid when the bucket bits change, a shrunk index only
+        //       visits the rest of a larger bucket again.
+        uint32_t bits = libcache_ptr->bucket_bits;
+        if (0 != libcache_ptr->old_buckets && libcache_ptr->old_bucket_bits < bits) {
+            bits = libcache_ptr->old_bucket_bits;
         }
-
-        if (NULL != src_entry) {
-            memcpy(cache_data->pool_element_ptr, src_entry, libcache_ptr->entry_size);
-        } else {
-            cache_data->lock_counter++;
+        uint32_t index = cursor >> (32 - bits);
+
+        items += libcache_scan_range(libcache_ptr, (const libcache_handle_t*) offset_ptr_get(&libcache_ptr->buckets),
+                libcache_ptr->bucket_bits, index, bits, callback, arg);
+        if (0 != libcache_ptr->old_buckets) {
+            // Note: the buckets before rehash_index are empty
+            items += libcache_scan_range(libcache_ptr, (const libcache_handle_t*) offset_ptr_get(&libcache_ptr->old_buckets),
+                    libcache_ptr->old_bucket_bits, index, bits, callback, arg);
         }
-        memcpy(cache_data->key, key, libcache_ptr->key_size);
-        // Note: add node into hash
-        cache_data->hash_node_ptr = hash_add(libcache_ptr->hash_table, key, hash_node, unlock_node, libcache_ptr->pool);
-        return_value = cache_data->pool_element_ptr;
-    } while (0);
+        buckets++;
 
-return return_value;
+        cursor = (uint32_t) (((uint64_t) index + 1) << (32 - bits));
+    } while (0 != cursor && items < max_items && buckets / LIBCACHE_SCAN_EMPTY_FACTOR < max_items);
+
+    return cursor;
 }
 
 /*
- *  @brief libcache_delete_by_key attempts to delete an entry with a given key.
+ *  @brief libcache_find_secondary_record    finds the record of the entry with a key of a secondary index.
  *
- *  @param libcache               cache object, cannot be NULL.
- *  @param key                    key, cannot be NULL.
- *  @return
- *          LIBCACHE_NOT_FOUND    entry wasn't found.
- *          LIBCACHE_LOCKED       the entry was unable to deleted because it's locked.
- *          LIBCACHE_SUCCESS      the entry was deleted successfully.
+ *  @return NULL                             didn't find out such entry with the key, or an input is invalid.
  */
-libcache_ret_t  libcache_delete_by_key(void * libcache, const void* key)
+static libcache_record_t* libcache_find_secondary_record(const libcache_t* libcache_ptr, int secondary_id, const void* key)
 {
-    libcache_t* libcache_ptr = (libcache_t*)libcache;
-    if (unlikely(NULL == libcache_ptr)) {
-        DEBUG_ERROR("input parameter %s is null", "libcache");
-        return LIBCACHE_FAILURE;
+    if (unlikely(NULL == libcache_ptr || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "key");
+        return NULL;
     }
 
-    if (unlikely(NULL == key)) {
-        DEBUG_ERROR("input parameter %s is null", "key");
-        return LIBCACHE_FAILURE;
+    if (unlikely(secondary_id < 0 || secondary_id >= libcache_ptr->secondary_count)) {
+        DEBUG_ERROR("%s", "no such secondary index");
+        return NULL;
     }
 
-    libcache_ret_t return_value = LIBCACHE_SUCCESS;
-    do {
-        node_t* hash_node = (node_t*)hash_find(libcache_ptr->hash_table, key);
-        if (NULL == hash_node) {
-            return_value = LIBCACHE_NOT_FOUND;
-            break;
+    const libcache_secondary_t* secondary = &libcache_ptr->secondaries[secondary_id];
+    uint32_t fingerprint = secondary->key_to_number(key);
+    libcache_handle_t handle = *libcache_get_secondary_bucket(secondary, fingerprint);
+    while (LIBCACHE_NIL != handle) {
+        if (*libcache_get_secondary_fingerprint(libcache_ptr, secondary, handle) == fingerprint) {
+            libcache_record_t* record = libcache_get_record(libcache_ptr, handle);
+            if (LIBCACHE_EQU == secondary->cmp_key(key,
+                    (char*) libcache_get_record_entry(libcache_ptr, record) + secondary->key_offset)) {
+                return record;
+            }
         }
-
-        // Note: if the entry is locked, just return
-        node_t* libcache_node = (node_t*)((hash_data_t*)hash_node->usr_data)->cache_node_ptr;
-        libcache_node_usr_data_t* libcache_node_usr_data = (libcache_node_usr_data_t*)libcache_node->usr_data;
-         if (libcache_node_usr_data->lock_counter > 0) {
-             return_value = LIBCACHE_LOCKED;
-             break;
-         }
-
-        // Note: delete node from hash
-        hash_del(libcache_ptr->hash_table, key, libcache_node_usr_data->hash_node_ptr, libcache_ptr->pool);
-        hash_free_node(hash_node, libcache_ptr->pool);
-
-        // Note: delete node from pool
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_DATA, libcache_node_usr_data->pool_element_ptr);
-
-        // Note: delete node from list
-        list_remove(libcache_ptr->list, libcache_node);
-
-        // Note: free node resource
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_LIBCACHE_NODE_USR_DATA_T, libcache_node_usr_data);
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_KEY_SIZE, ((libcache_node_usr_data_t*)libcache_node->usr_data)->key);
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_NODE_T, libcache_node);
-
-        return_value = LIBCACHE_SUCCESS;
-    } while(0);
-
-    return return_value;
+        handle = *libcache_get_secondary_next(libcache_ptr, secondary, handle);
+    }
+    return NULL;
 }
 
 /*
- *  @brief libcache_delete_entry   attempts to delete an entry.
+ *  @brief libcache_add_secondary   adds a secondary index, which finds an entry by a key kept inside the entry,
+ *                                  e.g. the F-TEID of a session cached by its IMSI.
  *
- *  @param libcache                cache object, cannot be NULL.
- *  @param entry                   entry (returned by libcache_lookup/libcache_add) in the cache.
- *  @return
-*           LIBCACHE_NOT_FOUND     entry wasn't found.
-*           LIBCACHE_LOCKED        entry was unable to deleted while it's locked.
- *          LIBCACHE_SUCCESS       entry was deleted successfully.
+ *  @param libcache                 cache object, cannot be NULL.
+ *  @param key_offset               offset of the key in an entry, bytes.
+ *  @param key_size                 size of the key, bytes, key_offset + key_size isn't larger than entry_size.
+ *  @param cmp_key                  function to compare two keys, only LIBCACHE_EQU is used.
+ *  @param key_to_number            function to translate key to a number, all 32 bits are used.
+ *  @return                         id of the index, -1 on failure, e.g. for a shared cache
+ *                                  or if LIBCACHE_MAX_SECONDARIES indexes exist.
+ *  NOTE:   The entries in the cache are indexed by their current content. Adds with a source entry,
+ *          libcache_put, deletes, swaps and libcache_resize keep every index up to date in the same call.
+ *          An entry added without a source, or whose key is changed in place, is indexed
+ *          by libcache_link_secondary. Several entries may have the same secondary key.
  */
-libcache_ret_t  libcache_delete_entry(void * libcache, void* entry)
+int libcache_add_secondary(void * libcache, size_t key_offset, size_t key_size,
+        LIBCACHE_CMP_KEY* cmp_key, LIBCACHE_KEY_TO_NUMBER* key_to_number)
 {
-    libcache_t* libcache_ptr = (libcache_t*)libcache;
-    if (unlikely(NULL == libcache_ptr)) {
-        DEBUG_ERROR("input parameter %s is null", "libcache");
-        return LIBCACHE_FAILURE;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == cmp_key || NULL == key_to_number)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "callback");
+        return -1;
     }
 
-    libcache_ret_t return_value = LIBCACHE_FAILURE;
+    // Note: the index memory is mapped by this process, other processes can't follow its links
+    if (unlikely(0 != libcache_ptr->shm_header)) {
+        DEBUG_ERROR("%s", "a shared cache can't have secondary indexes");
+        return -1;
+    }
 
-    do {
-        // Note: judge whether entry is existed in cache
-        node_t* libcache_node = pool_get_reserved_pointer(entry);
-        if (libcache_node == NULL) {
-            return_value = LIBCACHE_NOT_FOUND;
-            break;
-        }
+    if (unlikely(key_offset + key_size > libcache_ptr->entry_size
+            || LIBCACHE_MAX_SECONDARIES == libcache_ptr->secondary_count)) {
+        DEBUG_ERROR("%s", "the key isn't in the entry, or no index is left");
+        return -1;
+    }
 
-        // Note: judge whether entry is locked
-        libcache_node_usr_data_t* libcache_node_usr_data = (libcache_node_usr_data_t*)libcache_node->usr_data;
-        if (libcache_node_usr_data->lock_counter > 0) {
-            return_value = LIBCACHE_LOCKED;
-            break;
+    libcache_secondary_t* secondary = &libcache_ptr->secondaries[libcache_ptr->secondary_count];
+    secondary->key_offset = key_offset;
+    secondary->key_size = key_size;
+    secondary->cmp_key = cmp_key;
+    secondary->key_to_number = key_to_number;
+    secondary->bucket_bits = libcache_get_bucket_bits(libcache_ptr->max_entry_number);
+    secondary->buckets_size = libcache_get_buckets_length(secondary->bucket_bits);
+    secondary->old_buckets = 0;
+    secondary->old_buckets_size = 0;
+    secondary->old_bucket_bits = 0;
+    secondary->rehash_index = 0;
+    void* buckets = arena_alloc(secondary->buckets_size);
+    if (unlikely(buckets == NULL)) {
+        DEBUG_ERROR("Memory map of %zu bytes failed!", secondary->buckets_size);
+        return -1;
+    }
+    offset_ptr_set(&secondary->buckets, buckets);
+
+    int i;
+    for (i = 0; i < libcache_ptr->chunk_count; i++) {
+        if (unlikely(LIBCACHE_SUCCESS != libcache_map_secondary_links(libcache_ptr, secondary, i))) {
+            while (--i >= 0) {
+                arena_free(offset_ptr_get(&secondary->links[i]),
+                        libcache_get_secondary_links_length(libcache_ptr->chunks[i].capacity));
+            }
+            arena_free(buckets, secondary->buckets_size);
+            return -1;
         }
+    }
 
-        hash_data_t* hash_data = (hash_data_t*) (libcache_node_usr_data->hash_node_ptr->usr_data);
-        return_value = libcache_delete_by_key(libcache_ptr, hash_data->key);
-    } while(0);
-
-    return return_value;
+    libcache_record_t* record = libcache_get_record(libcache_ptr, libcache_ptr->lru_head);
+    while (NULL != record) {
+        libcache_link_secondary_record(libcache_ptr, secondary, record);
+        record = libcache_get_record(libcache_ptr, record->lru_next);
+    }
+    return libcache_ptr->secondary_count++;
 }
 
 /*
- *  @brief libcache_unlock_entry    attempts to unlock an entry.
+ *  @brief libcache_link_secondary  indexes an entry again by the keys in it, after it was written in place.
  *
  *  @param libcache                 cache object, cannot be NULL.
  *  @param entry                    entry (returned by libcache_lookup/libcache_add) in the cache.
  *  @return
- *          LIBCACHE_UNLOCKED       the entry is already unlocked,
- *                                  this indicates unpaired locking & unlocking issue happened.
- *          LIBCACHE_SUCCESS        the entry was unlocked successfully once.
+ *      LIBCACHE_NOT_FOUND          the entry isn't in the cache (any more).
+ *      LIBCACHE_SUCCESS            the entry is in every secondary index by its current keys.
  */
-libcache_ret_t libcache_unlock_entry(void * libcache, void* entry)
+libcache_ret_t libcache_link_secondary(void * libcache, void* entry)
 {
-    libcache_t* libcache_ptr = (libcache_t*)libcache;
-    if (unlikely(NULL == libcache_ptr)) {
-        DEBUG_ERROR("input parameter %s is null", "libcache");
-        return LIBCACHE_FAILURE;
-    }
-
-    if (unlikely(entry == NULL)) {
-        DEBUG_ERROR("input parameter %s is null", "entry");
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    if (unlikely(NULL == libcache_ptr || NULL == entry)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libcache_ptr) ? "libcache" : "entry");
         return LIBCACHE_FAILURE;
     }
 
-    libcache_ret_t return_value = LIBCACHE_FAILURE;
-
-    node_t* libcache_node = pool_get_reserved_pointer(entry);
-
-    if (NULL == libcache_node) {
-        return_value = LIBCACHE_NOT_FOUND;
-    } else {
-        // Note: unlock entry
-        libcache_node_usr_data_t* libcache_node_usr_data = (libcache_node_usr_data_t*)libcache_node->usr_data;
-        if (libcache_node_usr_data->lock_counter == 0) {
-            return_value = LIBCACHE_UNLOCKED;
-        } else {
-            libcache_node_usr_data->lock_counter--;
-            return_value = LIBCACHE_SUCCESS;
-        }
+    libcache_record_t* record = libcache_get_entry_record(libcache_ptr, entry);
+    if (NULL == record) {
+        return LIBCACHE_NOT_FOUND;
     }
-
-    return return_value;
+    libcache_unlink_secondaries(libcache_ptr, record);
+    libcache_link_secondaries(libcache_ptr, record);
+    return LIBCACHE_SUCCESS;
 }
 
 /*
- *  @brief libcache_get_max_entry_number    gets a capacity of the maximum number of entries this cache can store.
+ *  @brief libcache_lookup_secondary    looks up an entry by the key of a secondary index, like libcache_lookup.
  *
- *  @param libcache                         cache object, cannot be NULL.
- *  @return
- *         the number
+ *  @param libcache                     cache object, cannot be NULL.
+ *  @param secondary                    id returned by libcache_add_secondary.
+ *  @param key                          key, cannot be NULL.
+ *  @param dst_entry                    a copy of entry that fetch by key. it could be NULL.
+ *  @return NULL                        didn't find out such entry with the key.
+ *          pointer                     points to an entry with the key.
+ *  NOTE:  The entry in cache will be locked if dst_entry is NULL, libcache_unlock_entry unlocks it.
  */
-libcache_scale_t libcache_get_max_entry_number(const void * libcache)
+void* libcache_lookup_secondary(void * libcache, int secondary, const void* key, void* dst_entry)
 {
-    const libcache_t* libcache_ptr = (const libcache_t*)libcache;
-    if (unlikely(NULL == libcache_ptr)) {
-        DEBUG_ERROR("input parameter %s is null", "libcache");
-        return LIBCACHE_FAILURE;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    libcache_record_t* record = libcache_find_secondary_record(libcache_ptr, secondary, key);
+    if (NULL == record) {
+        return NULL;
     }
-    return libcache_ptr->max_entry_number -1;
+
+    void* return_value = libcache_get_record_entry(libcache_ptr, record);
+    if (NULL == dst_entry) {
+        record->lock_counter++;
+    } else {
+        memcpy(dst_entry, return_value, libcache_ptr->entry_size);
+        return_value = dst_entry;
+    }
+    libcache_lru_move_to_front(libcache_ptr, record);
+    libcache_touch_record(libcache_ptr, record);
+    return return_value;
 }
 
 /*
- *  @brief libcache_get_entry_number         gets the number of entries this cache stores.
+ *  @brief libcache_delete_by_secondary    deletes the entry of a key of a secondary index, like libcache_delete_by_key.
  *
- *  @param libcache                          cache object, cannot be NULL.
+ *  @param libcache                        cache object, cannot be NULL.
+ *  @param secondary                       id returned by libcache_add_secondary.
+ *  @param key                             key, cannot be NULL.
  *  @return
- *         the number
+ *          LIBCACHE_NOT_FOUND             entry wasn't found.
+ *          LIBCACHE_LOCKED                the entry was unable to deleted because it's locked.
+ *          LIBCACHE_SUCCESS               the entry was deleted from the cache and all its indexes.
  */
-libcache_scale_t libcache_get_entry_number(const void * libcache)
+libcache_ret_t libcache_delete_by_secondary(void * libcache, int secondary, const void* key)
 {
-    const libcache_t* libcache_ptr = (const libcache_t*)libcache;
-    if (unlikely(NULL == libcache_ptr)) {
-        DEBUG_ERROR("input parameter %s is null", "libcache");
-        return LIBCACHE_FAILURE;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    libcache_record_t* record = libcache_find_secondary_record(libcache_ptr, secondary, key);
+    if (NULL == record) {
+        return (NULL == libcache_ptr || NULL == key) ? LIBCACHE_FAILURE : LIBCACHE_NOT_FOUND;
     }
 
-    return hash_get_count(libcache_ptr->hash_table);
+    if (record->lock_counter > 0) {
+        return LIBCACHE_LOCKED;
+    }
+    libcache_remove_record(libcache_ptr, record);
+    return LIBCACHE_SUCCESS;
 }
 
 /*
@@ -436,21 +2691,29 @@ libcache_scale_t libcache_get_entry_number(const void * libcache)
  */
 libcache_ret_t libcache_clean(void * libcache)
 {
-    libcache_t* libcache_ptr = (libcache_t*)libcache;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
     if (unlikely(NULL == libcache_ptr)) {
         DEBUG_ERROR("input parameter %s is null", "libcache");
         return LIBCACHE_FAILURE;
     }
 
-    node_t* libcache_node = NULL;
-    while (NULL != (libcache_node = list_pop_front(libcache_ptr->list))) {
-        libcache_node_usr_data_t* libcache_node_usr_data = (libcache_node_usr_data_t*)libcache_node->usr_data;
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_DATA, libcache_node_usr_data->pool_element_ptr);
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_LIBCACHE_NODE_USR_DATA_T, libcache_node_usr_data);
-        pool_free_element(libcache_ptr->pool, POOL_TYPE_NODE_T, libcache_node);
+    libcache_record_t* record;
+    while (NULL != (record = libcache_get_record(libcache_ptr, libcache_ptr->lru_head))) {
+        libcache_lru_remove(libcache_ptr, record);
+        libcache_free_record(libcache_ptr, record);
+    }
+
+    // Note: the old index still holds the handles of the freed records, it's dropped before any resize work
+    if (0 != libcache_ptr->old_buckets_size) {
+        arena_free(offset_ptr_get(&libcache_ptr->old_buckets), libcache_ptr->old_buckets_size);
     }
+    libcache_ptr->old_buckets = 0;
+    libcache_ptr->old_buckets_size = 0;
+    libcache_ptr->rehash_index = 0;
+    memset(offset_ptr_get(&libcache_ptr->buckets), 0, libcache_get_buckets_length(libcache_ptr->bucket_bits));
 
-    hash_free(libcache_ptr->hash_table, libcache_ptr->pool);
+    // Note: the chunks being released are empty now, they are unmapped
+    libcache_resize_work(libcache_ptr, LIBCACHE_RESIZE_SLICE);
     return LIBCACHE_SUCCESS;
 }
 
@@ -464,23 +2727,55 @@ libcache_ret_t libcache_clean(void * libcache)
  */
 libcache_ret_t libcache_destroy(void * libcache)
 {
-    libcache_t* libcache_ptr = (libcache_t*)libcache;
+    libcache_t* libcache_ptr = libcache_get_object(libcache);
+    const libcache_callbacks_t* callbacks = (const libcache_callbacks_t*) libcache;
     if (unlikely(NULL == libcache_ptr)) {
         DEBUG_ERROR("input parameter %s is null", "libcache");
         return LIBCACHE_FAILURE;
     }
 
-    node_t* libcache_node = NULL;
-    while (NULL != (libcache_node = list_pop_front(libcache_ptr->list))) {
-        libcache_node_usr_data_t* libcache_node_usr_data = (libcache_node_usr_data_t*)libcache_node->usr_data;
-        if (libcache_ptr->free_entry != NULL) {
-            hash_data_t* hash_data = (hash_data_t*) (libcache_node_usr_data->hash_node_ptr->usr_data);
-            libcache_ptr->free_entry(hash_data->key, libcache_node_usr_data->pool_element_ptr);
+    void* pool = libcache_get_pool(libcache_ptr);
+    libcache_record_t* record = libcache_get_record(libcache_ptr, libcache_ptr->lru_head);
+    while (NULL != record) {
+        if (callbacks->free_entry != NULL) {
+            callbacks->free_entry(libcache_get_record_key(record), libcache_get_record_entry(libcache_ptr, record));
         }
+        record = libcache_get_record(libcache_ptr, record->lru_next);
     }
 
-    hash_destroy(libcache_ptr->hash_table, libcache_ptr->pool);
-    libcache_ptr->free_memory(libcache_ptr->pool);
+    int i;
+    for (i = 0; i < libcache_ptr->secondary_count; i++) {
+        libcache_secondary_t* secondary = &libcache_ptr->secondaries[i];
+        arena_free(offset_ptr_get(&secondary->buckets), secondary->buckets_size);
+        if (0 != secondary->old_buckets_size) {
+            arena_free(offset_ptr_get(&secondary->old_buckets), secondary->old_buckets_size);
+        }
+    }
+    for (i = 0; i < libcache_ptr->chunk_count; i++) {
+        libcache_free_secondary_links(libcache_ptr, i);
+    }
+    for (i = 1; i < libcache_ptr->chunk_count; i++) {
+        arena_free(libcache_get_chunk_pools(&libcache_ptr->chunks[i]), libcache_ptr->chunks[i].memory_size);
+    }
+    if (0 != libcache_ptr->old_buckets_size) {
+        arena_free(offset_ptr_get(&libcache_ptr->old_buckets), libcache_ptr->old_buckets_size);
+    }
+    if (0 != libcache_ptr->buckets_size) {
+        arena_free(offset_ptr_get(&libcache_ptr->buckets), libcache_ptr->buckets_size);
+    }
+
+    libcache_shm_header_t* header = (libcache_shm_header_t*) offset_ptr_get(&libcache_ptr->shm_header);
+    if (NULL != header) {
+        // Note: the segment name is removed, other attached processes keep their mapping
+        header->ready = FALSE;
+        arena_shm_unlink(header->name);
+        arena_shm_detach(header, header->segment_size);
+        free(libcache);
+    } else if (0 != libcache_ptr->arena_size) {
+        arena_free(pool, libcache_ptr->arena_size);
+    } else if (NULL != libcache_ptr->free_memory) {
+        libcache_ptr->free_memory(pool);
+    }
 
     return LIBCACHE_SUCCESS;
 }
@@ -0,0 +1,456 @@
+/*
+ * libcache_index.c
+ *
+ *  Split-ordered list (Shalev & Shavit): all the entries are in one lock-free
+ *  sorted list (Michael), ordered by the bit reversed hash. A bucket is a dummy
+ *  node in that list, so doubling the table only makes the new buckets point
+ *  into the list lazily, nothing is ever moved.
+ *
+ *  Nodes live in one array and are linked by index. Every link carries a tag
+ *  that is bumped on each change, so a freed node can be reused at once and a
+ *  reader holding an old link fails its validation instead of following it.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include "libcache_index.h"
+
+#define INDEX_NIL (0xFFFFFFFFu)
+#define INDEX_LOAD_FACTOR (2)
+#define INDEX_MIN_BUCKETS (2)
+#define INDEX_MAX_BUCKETS (0x80000000u)
+#define INDEX_DUMMY_SLACK (64) /* dummies allocated by threads losing a race, they are returned at once */
+
+/* | tag:31 | mark:1 | node:32 |, mark: the node owning this link is deleted */
+typedef uint64_t index_link_t;
+
+typedef struct index_node_t
+{
+    index_link_t next;
+    uint32_t so_key;    /* split-order key: bit reversed hash, odd for an entry, even for a dummy */
+    uint32_t free_next;
+    void* value;
+    char key[];
+} index_node_t;
+
+typedef struct libcache_index_t
+{
+    size_t key_size;
+    size_t node_size;
+    libcache_scale_t max_entry_number;
+    uint32_t max_bucket_number;
+    uint32_t bucket_number;             /* grows while the index is used */
+    libcache_scale_t entry_number;      /* reserved by add, released with the node */
+    uint64_t entry_free_list;           /* | tag:32 | node:32 | */
+    uint64_t dummy_free_list;
+    uint32_t* buckets;                  /* dummy node of each bucket, INDEX_NIL until it's used */
+    char* nodes;                        /* entries, then dummies */
+    LIBCACHE_FREE_MEMORY* free_memory;
+    LIBCACHE_CMP_KEY* cmp_key;
+    LIBCACHE_KEY_TO_NUMBER* key_to_number;
+} libcache_index_t;
+
+/* Where a key is, or would be inserted */
+typedef struct index_position_t
+{
+    index_link_t* prev; /* link pointing to cur */
+    index_link_t cur;   /* value read from prev */
+    index_link_t next;  /* value read from cur->next */
+} index_position_t;
+
+static inline index_link_t index_link_make(uint32_t node, int mark, uint32_t tag)
+{
+    return ((uint64_t) tag << 33) | ((uint64_t) (mark ? 1 : 0) << 32) | node;
+}
+
+static inline uint32_t index_link_node(index_link_t link)
+{
+    return (uint32_t) link;
+}
+
+static inline int index_link_mark(index_link_t link)
+{
+    return (int) ((link >> 32) & 1);
+}
+
+static inline uint32_t index_link_tag(index_link_t link)
+{
+    return (uint32_t) (link >> 33);
+}
+
+static inline index_node_t* index_get_node(const libcache_index_t* index, uint32_t node)
+{
+    return (index_node_t*) (index->nodes + index->node_size * node);
+}
+
+static inline uint32_t index_reverse(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    return __builtin_bswap32(x);
+}
+
+static inline uint32_t index_so_regular_key(uint32_t hash)
+{
+    return index_reverse(hash) | 1;
+}
+
+static inline uint32_t index_so_dummy_key(uint32_t bucket)
+{
+    return index_reverse(bucket);
+}
+
+/* Note: the parent of a bucket is the bucket itself without its highest bit */
+static inline uint32_t index_get_parent(uint32_t bucket)
+{
+    return bucket & ~(1u << (31 - __builtin_clz(bucket)));
+}
+
+static uint32_t index_pop(libcache_index_t* index, uint64_t* free_list)
+{
+    uint64_t head = __atomic_load_n(free_list, __ATOMIC_ACQUIRE);
+    while (1) {
+        uint32_t node = (uint32_t) head;
+        if (node == INDEX_NIL) {
+            return INDEX_NIL;
+        }
+        uint32_t next = __atomic_load_n(&index_get_node(index, node)->free_next, __ATOMIC_RELAXED);
+        uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+        if (__atomic_compare_exchange_n(free_list, &head, new_head, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return node;
+        }
+    }
+}
+
+static void index_push(libcache_index_t* index, uint64_t* free_list, uint32_t node)
+{
+    uint64_t head = __atomic_load_n(free_list, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    do {
+        __atomic_store_n(&index_get_node(index, node)->free_next, (uint32_t) head, __ATOMIC_RELAXED);
+        new_head = (((head >> 32) + 1) << 32) | node;
+    } while (!__atomic_compare_exchange_n(free_list, &head, new_head, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Note: called once per entry node, by the thread which unlinked it */
+static void index_release_entry(libcache_index_t* index, uint32_t node)
+{
+    index_push(index, &index->entry_free_list, node);
+    __atomic_sub_fetch(&index->entry_number, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  @brief index_find    walks the list from a dummy, unlinks the deleted nodes on the way.
+ *
+ *  @param head          dummy node to start from.
+ *  @param so_key        split-order key to look for.
+ *  @param key           key to look for, NULL to look for the dummy of so_key.
+ *  @param pos           output, the found node is index_link_node(pos->cur).
+ *  @return TRUE         found.
+ */
+static int index_find(libcache_index_t* index, uint32_t head, uint32_t so_key, const void* key, index_position_t* pos)
+{
+retry:
+    pos->prev = &index_get_node(index, head)->next;
+    pos->cur = __atomic_load_n(pos->prev, __ATOMIC_ACQUIRE);
+    while (1) {
+        uint32_t cur = index_link_node(pos->cur);
+        if (cur == INDEX_NIL) {
+            return FALSE;
+        }
+
+        index_node_t* node = index_get_node(index, cur);
+        pos->next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+        uint32_t cur_so_key = __atomic_load_n(&node->so_key, __ATOMIC_RELAXED);
+
+        // Note: prev unchanged means cur was still linked, so what was read belongs to it
+        if (__atomic_load_n(pos->prev, __ATOMIC_ACQUIRE) != pos->cur) {
+            goto retry;
+        }
+
+        if (!index_link_mark(pos->next)) {
+            if (cur_so_key > so_key) {
+                return FALSE;
+            }
+            if (cur_so_key == so_key && (key == NULL || index->cmp_key(key, node->key) == LIBCACHE_EQU)) {
+                if (__atomic_load_n(pos->prev, __ATOMIC_ACQUIRE) != pos->cur) {
+                    goto retry;
+                }
+                return TRUE;
+            }
+            pos->prev = &node->next;
+            pos->cur = pos->next;
+        } else {
+            // Note: cur is deleted, help to unlink it
+            index_link_t unlinked = index_link_make(index_link_node(pos->next), FALSE, index_link_tag(pos->cur) + 1);
+            if (!__atomic_compare_exchange_n(pos->prev, &pos->cur, unlinked, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                goto retry;
+            }
+            index_release_entry(index, cur);
+            pos->cur = unlinked;
+        }
+    }
+}
+
+/*
+ *  @brief index_insert    links a private node (so_key, key and value already set) into the list.
+ *
+ *  @param existing        output, the node holding the same key when it fails.
+ *  @return TRUE           inserted.
+ */
+static int index_insert(libcache_index_t* index, uint32_t head, uint32_t node, const void* key, uint32_t* existing)
+{
+    index_node_t* new_node = index_get_node(index, node);
+    uint32_t so_key = new_node->so_key;
+    index_position_t pos;
+
+    while (1) {
+        if (index_find(index, head, so_key, key, &pos)) {
+            *existing = index_link_node(pos.cur);
+            return FALSE;
+        }
+
+        // Note: the tag of a reused node keeps growing, an old link of it never matches again
+        index_link_t next = __atomic_load_n(&new_node->next, __ATOMIC_RELAXED);
+        __atomic_store_n(&new_node->next, index_link_make(index_link_node(pos.cur), FALSE, index_link_tag(next) + 1),
+                __ATOMIC_RELAXED);
+
+        index_link_t linked = index_link_make(node, FALSE, index_link_tag(pos.cur) + 1);
+        if (__atomic_compare_exchange_n(pos.prev, &pos.cur, linked, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return TRUE;
+        }
+    }
+}
+
+/* Note: the dummy of a bucket is inserted after the one of its parent the first time the bucket is used */
+static uint32_t index_get_bucket(libcache_index_t* index, uint32_t bucket)
+{
+    uint32_t dummy = __atomic_load_n(&index->buckets[bucket], __ATOMIC_ACQUIRE);
+    if (likely(dummy != INDEX_NIL)) {
+        return dummy;
+    }
+
+    uint32_t parent = index_get_bucket(index, index_get_parent(bucket));
+
+    // Note: only threads racing on the same buckets hold dummies, they give them back soon
+    while (INDEX_NIL == (dummy = index_pop(index, &index->dummy_free_list))) {
+        sched_yield();
+    }
+    index_get_node(index, dummy)->so_key = index_so_dummy_key(bucket);
+
+    uint32_t existing;
+    if (!index_insert(index, parent, dummy, NULL, &existing)) {
+        index_push(index, &index->dummy_free_list, dummy);
+        dummy = existing;
+    }
+
+    uint32_t expected = INDEX_NIL;
+    (void) __atomic_compare_exchange_n(&index->buckets[bucket], &expected, dummy, FALSE,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    return dummy;
+}
+
+static inline uint32_t index_get_head(libcache_index_t* index, uint32_t hash)
+{
+    uint32_t bucket_number = __atomic_load_n(&index->bucket_number, __ATOMIC_ACQUIRE);
+    return index_get_bucket(index, hash & (bucket_number - 1));
+}
+
+void* libcache_index_create(
+        libcache_scale_t max_entry_number,
+        size_t key_size,
+        LIBCACHE_ALLOCATE_MEMORY* allocate_memory,
+        LIBCACHE_FREE_MEMORY* free_memory,
+        LIBCACHE_CMP_KEY* cmp_key,
+        LIBCACHE_KEY_TO_NUMBER* key_to_number)
+{
+    if (unlikely(max_entry_number == 0 || max_entry_number >= INDEX_NIL || key_size == 0
+            || allocate_memory == NULL || cmp_key == NULL || key_to_number == NULL)) {
+        DEBUG_ERROR("argument %s is invalid.", "max_entry_number/key_size/callbacks");
+        return NULL;
+    }
+
+    uint32_t max_bucket_number = INDEX_MIN_BUCKETS;
+    while (max_bucket_number < max_entry_number / INDEX_LOAD_FACTOR && max_bucket_number < INDEX_MAX_BUCKETS) {
+        max_bucket_number <<= 1;
+    }
+    size_t node_size = (sizeof(index_node_t) + key_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    size_t dummy_number = (size_t) max_bucket_number + INDEX_DUMMY_SLACK;
+    if (unlikely((size_t) max_entry_number + dummy_number >= INDEX_NIL)) {
+        DEBUG_ERROR("argument %s is invalid.", "max_entry_number");
+        return NULL;
+    }
+
+    size_t buckets_offset = sizeof(libcache_index_t);
+    size_t nodes_offset = (buckets_offset + sizeof(uint32_t) * max_bucket_number + sizeof(uint64_t) - 1)
+            & ~(sizeof(uint64_t) - 1);
+    size_t size = nodes_offset + node_size * (max_entry_number + dummy_number);
+
+    libcache_index_t* index = (libcache_index_t*) allocate_memory(size);
+    if (unlikely(index == NULL)) {
+        DEBUG_ERROR("%s failed!", "allocate_memory");
+        return NULL;
+    }
+
+    index->key_size = key_size;
+    index->node_size = node_size;
+    index->max_entry_number = max_entry_number;
+    index->max_bucket_number = max_bucket_number;
+    index->bucket_number = INDEX_MIN_BUCKETS;
+    index->entry_number = 0;
+    index->buckets = (uint32_t*) ((char*) index + buckets_offset);
+    index->nodes = (char*) index + nodes_offset;
+    index->free_memory = free_memory;
+    index->cmp_key = cmp_key;
+    index->key_to_number = key_to_number;
+
+    uint32_t i;
+    for (i = 0; i < max_bucket_number; i++) {
+        index->buckets[i] = INDEX_NIL;
+    }
+
+    index->entry_free_list = INDEX_NIL;
+    index->dummy_free_list = INDEX_NIL;
+    uint32_t node_number = (uint32_t) (max_entry_number + dummy_number);
+    for (i = node_number; i-- > 0;) {
+        index_node_t* node = index_get_node(index, i);
+        node->next = index_link_make(INDEX_NIL, FALSE, 0);
+        index_push(index, (i < max_entry_number) ? &index->entry_free_list : &index->dummy_free_list, i);
+    }
+
+    // Note: the dummy of bucket 0 is the head of the list
+    uint32_t head = index_pop(index, &index->dummy_free_list);
+    index_get_node(index, head)->so_key = index_so_dummy_key(0);
+    index->buckets[0] = head;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return index;
+}
+
+libcache_ret_t libcache_index_add(void* index, const void* key, void* value)
+{
+    libcache_index_t* index_ptr = (libcache_index_t*) index;
+    if (unlikely(NULL == index_ptr || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == index_ptr) ? "index" : "key");
+        return LIBCACHE_FAILURE;
+    }
+
+    // Note: the count is reserved first, so an entry node is always free for it
+    libcache_scale_t entry_number = __atomic_add_fetch(&index_ptr->entry_number, 1, __ATOMIC_ACQ_REL);
+    if (unlikely(entry_number > index_ptr->max_entry_number)) {
+        __atomic_sub_fetch(&index_ptr->entry_number, 1, __ATOMIC_RELEASE);
+        return LIBCACHE_FULL;
+    }
+    uint32_t node = index_pop(index_ptr, &index_ptr->entry_free_list);
+    if (unlikely(node == INDEX_NIL)) {
+        __atomic_sub_fetch(&index_ptr->entry_number, 1, __ATOMIC_RELEASE);
+        return LIBCACHE_FULL;
+    }
+
+    uint32_t hash = index_ptr->key_to_number(key);
+    index_node_t* new_node = index_get_node(index_ptr, node);
+    new_node->so_key = index_so_regular_key(hash);
+    new_node->value = value;
+    memcpy(new_node->key, key, index_ptr->key_size);
+
+    uint32_t existing;
+    if (!index_insert(index_ptr, index_get_head(index_ptr, hash), node, key, &existing)) {
+        index_release_entry(index_ptr, node);
+        return LIBCACHE_FAILURE;
+    }
+
+    // Note: doubling only publishes a bigger size, the new buckets are split off when they are used
+    uint32_t bucket_number = __atomic_load_n(&index_ptr->bucket_number, __ATOMIC_RELAXED);
+    if (entry_number > bucket_number * INDEX_LOAD_FACTOR && bucket_number < index_ptr->max_bucket_number) {
+        (void) __atomic_compare_exchange_n(&index_ptr->bucket_number, &bucket_number, bucket_number * 2, FALSE,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    return LIBCACHE_SUCCESS;
+}
+
+libcache_ret_t libcache_index_lookup(void* index, const void* key, void** value)
+{
+    libcache_index_t* index_ptr = (libcache_index_t*) index;
+    if (unlikely(NULL == index_ptr || NULL == key || NULL == value)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == index_ptr) ? "index" : "key/value");
+        return LIBCACHE_FAILURE;
+    }
+
+    uint32_t hash = index_ptr->key_to_number(key);
+    uint32_t head = index_get_head(index_ptr, hash);
+    index_position_t pos;
+    while (index_find(index_ptr, head, index_so_regular_key(hash), key, &pos)) {
+        void* found = __atomic_load_n(&index_get_node(index_ptr, index_link_node(pos.cur))->value, __ATOMIC_RELAXED);
+
+        // Note: the node may have been deleted and reused since it was found
+        if (__atomic_load_n(pos.prev, __ATOMIC_ACQUIRE) == pos.cur) {
+            *value = found;
+            return LIBCACHE_SUCCESS;
+        }
+    }
+    return LIBCACHE_NOT_FOUND;
+}
+
+libcache_ret_t libcache_index_delete(void* index, const void* key)
+{
+    libcache_index_t* index_ptr = (libcache_index_t*) index;
+    if (unlikely(NULL == index_ptr || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == index_ptr) ? "index" : "key");
+        return LIBCACHE_FAILURE;
+    }
+
+    uint32_t hash = index_ptr->key_to_number(key);
+    uint32_t so_key = index_so_regular_key(hash);
+    uint32_t head = index_get_head(index_ptr, hash);
+    index_position_t pos;
+
+    while (1) {
+        if (!index_find(index_ptr, head, so_key, key, &pos)) {
+            return LIBCACHE_NOT_FOUND;
+        }
+
+        // Note: marking the link of the node is the deletion, unlinking it may be left to others
+        uint32_t node = index_link_node(pos.cur);
+        index_link_t marked = index_link_make(index_link_node(pos.next), TRUE, index_link_tag(pos.next) + 1);
+        if (!__atomic_compare_exchange_n(&index_get_node(index_ptr, node)->next, &pos.next, marked, FALSE,
+                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        index_link_t unlinked = index_link_make(index_link_node(pos.next), FALSE, index_link_tag(pos.cur) + 1);
+        if (__atomic_compare_exchange_n(pos.prev, &pos.cur, unlinked, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            index_release_entry(index_ptr, node);
+        } else {
+            (void) index_find(index_ptr, head, so_key, key, &pos);
+        }
+        return LIBCACHE_SUCCESS;
+    }
+}
+
+libcache_scale_t libcache_index_get_entry_number(const void* index)
+{
+    const libcache_index_t* index_ptr = (const libcache_index_t*) index;
+    return (NULL == index_ptr) ? 0 : __atomic_load_n(&index_ptr->entry_number, __ATOMIC_ACQUIRE);
+}
+
+libcache_scale_t libcache_index_get_bucket_number(const void* index)
+{
+    const libcache_index_t* index_ptr = (const libcache_index_t*) index;
+    return (NULL == index_ptr) ? 0 : __atomic_load_n(&index_ptr->bucket_number, __ATOMIC_ACQUIRE);
+}
+
+libcache_ret_t libcache_index_destroy(void* index)
+{
+    libcache_index_t* index_ptr = (libcache_index_t*) index;
+    if (unlikely(NULL == index_ptr)) {
+        DEBUG_ERROR("input parameter %s is null", "index");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (index_ptr->free_memory != NULL) {
+        index_ptr->free_memory(index_ptr);
+    }
+    return LIBCACHE_SUCCESS;
+}
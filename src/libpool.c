@@ -1,68 +1,124 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include "list.h"
 #include "libpool.h"
 
 #define MAGIC_CHECK_VALUE (89757)
 #define POOL_HEAD_LENGTH  (sizeof(element_pool_t))
-
-static inline size_t pool_caculate_nodes_length(int entry_acount)
+#define POOL_NIL          (0xFFFFFFFFu)
+
+#define POOL_MAGAZINE_ROUNDS (32)                        /* elements a magazine holds */
+#define POOL_MAGAZINE_BATCH  (POOL_MAGAZINE_ROUNDS / 2)  /* elements moved from / to the depot at once */
+#define POOL_MAGAZINE_SLOTS  (8)                         /* magazines of a thread, one pool each */
+
+#ifdef LIBPOOL_MAGIC_CHECK
+#define POOL_CHECK_LENGTH (sizeof(long long))
+#else
+#define POOL_CHECK_LENGTH (0)
+#endif
+
+/* A freed element holds the index of the next freed one in its first bytes.
+ * Note: poison overwrites the 32 bits at POOL_FREE_POISON_OFFSET of the entry, libcache_record_t keeps
+ *       its handle there, so a freed record never holds its own handle, see libcache_is_cached.
+ */
+typedef struct free_element_t {
+    uint32_t next;
+    uint32_t poison;
+} free_element_t;
+
+typedef char pool_poison_offset_check[(offsetof(free_element_t, poison) == POOL_FREE_POISON_OFFSET) ? 1 : -1];
+
+/* The rounds are a stack, the most recently freed element is on top (still in the CPU cache) */
+typedef struct pool_magazine_t {
+    element_pool_t* pool;
+    int rounds;
+    void* round[POOL_MAGAZINE_ROUNDS];
+} pool_magazine_t;
+
+static __thread pool_magazine_t pool_thread_magazines[POOL_MAGAZINE_SLOTS];
+
+static inline size_t pool_caculate_head_length(int reserved)
 {
-    return sizeof(node_t) * entry_acount;
+    return (reserved ? sizeof(offset_ptr_t) : 0) + POOL_CHECK_LENGTH;
 }
 
-static inline size_t pool_caculate_element_length(size_t entry_size)
+static inline size_t pool_caculate_alignment(size_t alignment)
 {
-    while ((entry_size) % 8 != 0) {
-        entry_size += 1;
+    size_t pool_alignment = 8;
+    while (pool_alignment < alignment) {
+        pool_alignment <<= 1;
     }
-    return sizeof(element_usr_data_t) + entry_size;
+    return pool_alignment;
 }
 
-static inline size_t pool_caculate_elements_length(size_t entry_size, int entry_acount)
+static inline size_t pool_align(size_t length, size_t alignment)
 {
-    return pool_caculate_element_length(entry_size) * entry_acount;
+    return (length + alignment - 1) & ~(alignment - 1);
+}
+
+size_t pool_caculate_element_length(const pool_attr_t* pool_attr)
+{
+    size_t entry_size = pool_attr->entry_size;
+    if (entry_size < sizeof(free_element_t)) {
+        entry_size = sizeof(free_element_t);
+    }
+    return pool_align(pool_caculate_head_length(pool_attr->reserved) + entry_size,
+            pool_caculate_alignment(pool_attr->alignment));
 }
 
-static size_t pool_caculate_length(size_t entry_size, int entry_acount)
+// Note: the memory given to pools_init is 8 bytes aligned at least, a wider alignment
+// costs up to (alignment - 8) bytes in front of the elements of each pool
+size_t pool_caculate_length(const pool_attr_t* pool_attr)
 {
-    size_t pool_head_length = POOL_HEAD_LENGTH;
-    size_t nodes_length = pool_caculate_nodes_length(entry_acount);
-    size_t elements_length = pool_caculate_elements_length(entry_size, entry_acount);
+    size_t pool_head_length = POOL_HEAD_LENGTH + pool_caculate_alignment(pool_attr->alignment) - 8;
+    size_t elements_length = pool_caculate_element_length(pool_attr) * pool_attr->entry_acount;
 
-    return pool_head_length + nodes_length + elements_length;
+    return pool_head_length + elements_length;
 }
 
 size_t pool_caculate_total_length(int pool_acount, pool_attr_t pool_attr[])
 {
-    size_t pools_head_size = sizeof(element_pool_t*) * pool_acount;
+    size_t pools_head_size = sizeof(offset_ptr_t) * pool_acount;
     int i;
     size_t pools_length = 0;
     for (i = 0; i < pool_acount; i++) {
-        size_t pool_length = pool_caculate_length(pool_attr[i].entry_size, pool_attr[i].entry_acount);
+        size_t pool_length = pool_caculate_length(&pool_attr[i]);
         pools_length = pools_length + pool_length;
     }
 
     return pools_head_size + pools_length;
 }
-static node_t* pool_get_node_addr(element_pool_t* pool, int j)
+
+static void* pool_get_element_addr(element_pool_t* pool, long long j)
+{
+    char* elements_start_mem = (char*) pool + pool->elements_offset;
+
+    return elements_start_mem + pool->element_size * j + pool->head_size;
+}
+
+static inline uint32_t pool_get_element_index(element_pool_t* pool, void* element)
+{
+    return (uint32_t) (((char*) element - pool->head_size - ((char*) pool + pool->elements_offset)) / pool->element_size);
+}
+
+static inline free_element_t* pool_get_free_element(element_pool_t* pool, uint32_t index)
 {
-    node_t* nodes_start_mem = (node_t*)((char*) pool + POOL_HEAD_LENGTH);
-    return nodes_start_mem + j;
+    return (free_element_t*) pool_get_element_addr(pool, index);
 }
 
-static element_usr_data_t* pool_get_element_addr(element_pool_t* pool, int j)
+static inline uint64_t pool_free_list_make(uint32_t index, uint32_t tag)
 {
-    element_usr_data_t* elements_start_mem = (element_usr_data_t*) ((char*) pool + POOL_HEAD_LENGTH
-            + pool_caculate_nodes_length(pool->element_acount));
+    return ((uint64_t) tag << 32) | index;
+}
 
-    return (element_usr_data_t*) ((char*) elements_start_mem + pool->element_size * j);
+static inline uint32_t pool_free_list_tag(uint64_t free_list)
+{
+    return (uint32_t) (free_list >> 32);
 }
 
-// | element_pool_t* pools[ 0, 1, ... ] |
-// | element_pool_t pools 0 | + | node_t 0.0 | node 0.1 | ... | + | element_usr_data_t 0.0 | entry_0.0 | ... |
-// | element_pool_t pools 1 | + | node_t 1.0 | node 1.1 | ... | + | element_usr_data_t 1.0 | entry_1.0 | ... |
+// | offset_ptr_t pools[ 0, 1, ... ] |
+// | element_pool_t pools 0 | + | padding | head 0.0 | entry_0.0 | padding | head 0.1 | entry 0.1 | ... |
+// | element_pool_t pools 1 | + | padding | head 1.0 | entry_1.0 | ... |
 // | ... |
 void* pools_init(void* large_memory, size_t large_mem_size, int pool_acount, pool_attr_t pool_attr[])
 {
@@ -71,59 +127,131 @@ void* pools_init(void* large_memory, size_t large_mem_size, int pool_acount, poo
         return NULL;
     }
 
-    element_pool_t** pool_pointers = (element_pool_t**) ((char*) large_memory);
-    element_pool_t* pool = (element_pool_t*) ((char*) large_memory + sizeof(element_pool_t*) * pool_acount);
+    offset_ptr_t* pool_pointers = (offset_ptr_t*) large_memory;
+    element_pool_t* pool = (element_pool_t*) ((char*) large_memory + sizeof(offset_ptr_t) * pool_acount);
     int i;
     for (i = 0; i < pool_acount; i++) {
-        pool_pointers[i] = pool;
+        offset_ptr_set(&pool_pointers[i], pool);
 
         memset(pool, '\0', sizeof(element_pool_t));
 
-        list_init(&pool->free_list);
-
-        pool->element_size = pool_caculate_element_length(pool_attr[i].entry_size);
+        pool->free_list = pool_free_list_make(POOL_NIL, 0);
+        pool->element_size = pool_caculate_element_length(&pool_attr[i]);
         pool->element_acount = pool_attr[i].entry_acount;
+        pool->element_used = 0;
+        pool->head_size = pool_caculate_head_length(pool_attr[i].reserved);
 
-        int j;
-        for (j = 0; j < pool->element_acount; j++) {
-            node_t* node = pool_get_node_addr(pool, j);
-            element_usr_data_t* elements_addr = pool_get_element_addr(pool, j);
+        // Note: entries start aligned, element_size keeps the following ones aligned
+        size_t alignment = pool_caculate_alignment(pool_attr[i].alignment);
+        uintptr_t first_entry = pool_align((uintptr_t) pool + POOL_HEAD_LENGTH + pool->head_size, alignment);
+        pool->elements_offset = (long long) (first_entry - pool->head_size - (uintptr_t) pool);
 
-            elements_addr->check_value = MAGIC_CHECK_VALUE;
-            elements_addr->reserved_pointer = NULL;
-            elements_addr->to_node = node;
+        size_t pool_length = pool_caculate_length(&pool_attr[i]);
+        pool = (element_pool_t*) ((char*) pool + pool_length);
+    }
 
-            node->usr_data = (void*) (elements_addr + 1);
+    return large_memory;
+}
 
-            list_push_back(&pool->free_list, node);
-        }
+static inline element_pool_t* pool_get_pool(void* pools, int pool_type)
+{
+    return (element_pool_t*) offset_ptr_get((offset_ptr_t*) pools + pool_type);
+}
 
-        size_t pool_length = pool_caculate_length(pool_attr[i].entry_size, pool_attr[i].entry_acount);
-        pool = (element_pool_t*) ((char*) pool + pool_length);
-    }
+/* Note: only reserved_pointer of a reserved pool and check_value may be accessed through the head */
+static inline element_head_t* pool_get_head(void* element)
+{
+    return (element_head_t*) element - 1;
+}
 
-    return (element_pool_t**) large_memory;
+/* Note: the first use of an element writes its head, so its pages are faulted in only then */
+static inline void* pool_init_element(element_pool_t* pool, void* element)
+{
+    if (pool->head_size > POOL_CHECK_LENGTH) {
+        pool_get_head(element)->reserved_pointer = 0;
+    }
+#ifdef LIBPOOL_MAGIC_CHECK
+    pool_get_head(element)->check_value = MAGIC_CHECK_VALUE;
+#endif
+    return element;
 }
 
+static void* pool_take_untouched_element(element_pool_t* pool)
+{
+    if (pool->element_used >= pool->element_acount) {
+        return NULL;
+    }
+
+    return pool_init_element(pool, pool_get_element_addr(pool, pool->element_used++));
+}
 
 inline void* pool_get_element(void* pools, int pool_type)
 {
-    element_pool_t *pool = ((element_pool_t**) pools)[pool_type];
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
+
+    uint32_t index = (uint32_t) pool->free_list;
+    if (index == POOL_NIL) {
+        return pool_take_untouched_element(pool);
+    }
+
+    free_element_t* element = pool_get_free_element(pool, index);
+    pool->free_list = pool_free_list_make(element->next, pool_free_list_tag(pool->free_list) + 1);
+    return element;
+}
+
+void* pool_get_used_element(void* pools, int pool_type, long long index)
+{
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
+
+    return (index < 0 || index >= pool->element_used) ? NULL : pool_get_element_addr(pool, index);
+}
+
+long long pool_get_touched_count(void* pools, int pool_type)
+{
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
+
+    return pool->element_used;
+}
+
+void* pool_get_elements(void* pools, int pool_type, size_t* element_size)
+{
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
+
+    *element_size = (size_t) pool->element_size;
+    return pool_get_element_addr(pool, 0);
+}
+
+void pool_get_stats(void* pools, int pool_type, pool_stats_t* stats)
+{
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
 
-    node_t *node = list_pop_back(&pool->free_list);
+    long long free_count = 0;
+    uint32_t index = (uint32_t) pool->free_list;
+    while (index != POOL_NIL) {
+        free_count++;
+        index = pool_get_free_element(pool, index)->next;
+    }
 
-    return (node == NULL) ? NULL : node->usr_data;
+    stats->element_size = (size_t) pool->element_size;
+    stats->capacity = pool->element_acount;
+    stats->used = pool->element_used - free_count;
+    stats->touched = pool->element_used;
+    stats->bytes = (size_t) (pool->elements_offset + pool->element_size * pool->element_acount);
 }
 
-static inline void* pool_get_element_head(void* element)
+static inline element_head_t* pool_get_element_head(void* element)
 {
-    if ((char*) element - (char*) NULL <= sizeof(element_usr_data_t)) {
+#ifdef LIBPOOL_MAGIC_CHECK
+    if ((char*) element - (char*) NULL <= sizeof(element_head_t)) {
         DEBUG_ERROR("Element is invalid, element = %p.", element);
         return NULL;
     }
 
-    element_usr_data_t *element_user_data = ((element_usr_data_t*) element - 1);
-    return (element_user_data->check_value != MAGIC_CHECK_VALUE) ? NULL : element_user_data;
+    element_head_t *element_head = pool_get_head(element);
+    return (element_head->check_value != MAGIC_CHECK_VALUE) ? NULL : element_head;
+#else
+    return (element == NULL) ? NULL : pool_get_head(element);
+#endif
 }
 
 inline void pool_free_element(void *pools, int pool_type, void* element)
@@ -132,23 +260,284 @@ inline void pool_free_element(void *pools, int pool_type, void* element)
         return;
     }
 
-    element_usr_data_t *element_user_data = ((element_usr_data_t*) element - 1);
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
+    if (pool->head_size > POOL_CHECK_LENGTH) {
+        pool_get_head(element)->reserved_pointer = 0;
+    }
+
+    free_element_t* free_element = (free_element_t*) element;
+    free_element->next = (uint32_t) pool->free_list;
+    free_element->poison = POOL_FREE_POISON;
+    pool->free_list = pool_free_list_make(pool_get_element_index(pool, element), pool_free_list_tag(pool->free_list) + 1);
+}
+
+void pool_free_elements(void* pools, int pool_type, void* elements[], int count)
+{
+    if (unlikely(count <= 0)) {
+        return;
+    }
+
+    element_pool_t *pool = pool_get_pool(pools, pool_type);
+    int i;
+    // Note: the elements are linked in order, then the chain is put on the free list by one store
+    for (i = 0; i < count; i++) {
+        if (pool->head_size > POOL_CHECK_LENGTH) {
+            pool_get_head(elements[i])->reserved_pointer = 0;
+        }
+        free_element_t* free_element = (free_element_t*) elements[i];
+        free_element->next = (i + 1 < count) ? pool_get_element_index(pool, elements[i + 1]) : (uint32_t) pool->free_list;
+        free_element->poison = POOL_FREE_POISON;
+    }
+    pool->free_list = pool_free_list_make(pool_get_element_index(pool, elements[0]), pool_free_list_tag(pool->free_list) + 1);
+}
+
+static uint32_t pool_depot_pop(element_pool_t* pool)
+{
+    uint64_t head = __atomic_load_n(&pool->free_list, __ATOMIC_ACQUIRE);
+    while (1) {
+        uint32_t index = (uint32_t) head;
+        if (index == POOL_NIL) {
+            return POOL_NIL;
+        }
+        // Note: the element may be taken by another thread meanwhile, then the tag has changed
+        uint32_t next = __atomic_load_n(&pool_get_free_element(pool, index)->next, __ATOMIC_RELAXED);
+        uint64_t new_head = pool_free_list_make(next, pool_free_list_tag(head) + 1);
+        if (__atomic_compare_exchange_n(&pool->free_list, &head, new_head, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return index;
+        }
+    }
+}
 
-    element_user_data->reserved_pointer = NULL;
+/* Note: the elements from first to last are linked already, they are pushed by one compare and swap */
+static void pool_depot_push_chain(element_pool_t* pool, uint32_t first, free_element_t* last)
+{
+    uint64_t head = __atomic_load_n(&pool->free_list, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    do {
+        __atomic_store_n(&last->next, (uint32_t) head, __ATOMIC_RELAXED);
+        new_head = pool_free_list_make(first, pool_free_list_tag(head) + 1);
+    } while (!__atomic_compare_exchange_n(&pool->free_list, &head, new_head, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void* pool_depot_take_untouched_element(element_pool_t* pool)
+{
+    long long used = __atomic_load_n(&pool->element_used, __ATOMIC_RELAXED);
+    do {
+        if (used >= pool->element_acount) {
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&pool->element_used, &used, used + 1, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
-    element_pool_t *pool = ((element_pool_t**) pools)[pool_type];
-    list_push_front(&pool->free_list, element_user_data->to_node);
+    return pool_init_element(pool, pool_get_element_addr(pool, used));
+}
+
+/* Note: the bottom rounds are the coldest ones, they go back to the depot as one chain */
+static void pool_magazine_return(pool_magazine_t* magazine, int count)
+{
+    element_pool_t* pool = magazine->pool;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (pool->head_size > POOL_CHECK_LENGTH) {
+            pool_get_head(magazine->round[i])->reserved_pointer = 0;
+        }
+        ((free_element_t*) magazine->round[i])->poison = POOL_FREE_POISON;
+        if (i + 1 < count) {
+            ((free_element_t*) magazine->round[i])->next = pool_get_element_index(pool, magazine->round[i + 1]);
+        }
+    }
+
+    if (count > 0) {
+        pool_depot_push_chain(pool, pool_get_element_index(pool, magazine->round[0]),
+                (free_element_t*) magazine->round[count - 1]);
+    }
+
+    magazine->rounds -= count;
+    memmove(magazine->round, magazine->round + count, sizeof(void*) * magazine->rounds);
+}
+
+static void pool_magazine_refill(pool_magazine_t* magazine)
+{
+    element_pool_t* pool = magazine->pool;
+    while (magazine->rounds < POOL_MAGAZINE_BATCH) {
+        void* element;
+        uint32_t index = pool_depot_pop(pool);
+        if (index != POOL_NIL) {
+            element = pool_get_free_element(pool, index);
+        } else if (NULL == (element = pool_depot_take_untouched_element(pool))) {
+            break;
+        }
+        magazine->round[magazine->rounds++] = element;
+    }
+}
+
+/* Note: a thread using more pools than slots flushes the magazine of the pool it displaces */
+static pool_magazine_t* pool_get_magazine(void* pools, int pool_type)
+{
+    element_pool_t* pool = pool_get_pool(pools, pool_type);
+    pool_magazine_t* magazine = &pool_thread_magazines[((uintptr_t) pool >> 6) % POOL_MAGAZINE_SLOTS];
+    if (unlikely(magazine->pool != pool)) {
+        if (magazine->pool != NULL) {
+            pool_magazine_return(magazine, magazine->rounds);
+        }
+        magazine->pool = pool;
+    }
+    return magazine;
+}
+
+void* pool_magazine_get_element(void* pools, int pool_type)
+{
+    pool_magazine_t* magazine = pool_get_magazine(pools, pool_type);
+    if (unlikely(0 == magazine->rounds)) {
+        pool_magazine_refill(magazine);
+        if (0 == magazine->rounds) {
+            return NULL;
+        }
+    }
+    return magazine->round[--magazine->rounds];
+}
+
+void pool_magazine_free_element(void* pools, int pool_type, void* element)
+{
+    if (unlikely(element == NULL)) {
+        return;
+    }
+
+    pool_magazine_t* magazine = pool_get_magazine(pools, pool_type);
+    if (unlikely(POOL_MAGAZINE_ROUNDS == magazine->rounds)) {
+        pool_magazine_return(magazine, POOL_MAGAZINE_BATCH);
+    }
+    magazine->round[magazine->rounds++] = element;
+}
+
+void pool_magazine_flush(void* pools, int pool_type)
+{
+    element_pool_t* pool = pool_get_pool(pools, pool_type);
+    pool_magazine_t* magazine = &pool_thread_magazines[((uintptr_t) pool >> 6) % POOL_MAGAZINE_SLOTS];
+    if (magazine->pool == pool) {
+        pool_magazine_return(magazine, magazine->rounds);
+        magazine->pool = NULL;
+    }
+}
+
+typedef struct pool_classes_t {
+    offset_ptr_t pools;
+    libcache_scale_t in_use[POOL_CLASS_COUNT];
+    libcache_scale_t peak[POOL_CLASS_COUNT];
+    libcache_scale_t failures[POOL_CLASS_COUNT];
+} pool_classes_t;
+
+#define POOL_CLASSES_HEAD_LENGTH (pool_align(sizeof(pool_classes_t), 8))
+
+static void pool_classes_init_attr(pool_attr_t pool_attr[POOL_CLASS_COUNT], const libcache_scale_t class_acount[POOL_CLASS_COUNT])
+{
+    int i;
+    for (i = 0; i < POOL_CLASS_COUNT; i++) {
+        pool_attr[i].entry_size = (size_t) POOL_CLASS_MIN_SIZE << i;
+        pool_attr[i].entry_acount = class_acount[i];
+        pool_attr[i].reserved = FALSE;
+        pool_attr[i].alignment = POOL_CLASS_MIN_SIZE;
+    }
+}
+
+static inline int pool_get_size_class(size_t size)
+{
+    return (size <= POOL_CLASS_MIN_SIZE) ? 0 : 32 - __builtin_clz((uint32_t) (size - 1)) - 4;
+}
+
+size_t pool_classes_caculate_length(const libcache_scale_t class_acount[POOL_CLASS_COUNT])
+{
+    pool_attr_t pool_attr[POOL_CLASS_COUNT];
+    pool_classes_init_attr(pool_attr, class_acount);
+    return POOL_CLASSES_HEAD_LENGTH + pool_caculate_total_length(POOL_CLASS_COUNT, pool_attr);
+}
+
+void* pool_classes_init(void* memory, size_t memory_size, const libcache_scale_t class_acount[POOL_CLASS_COUNT])
+{
+    if (unlikely(memory == NULL)) {
+        DEBUG_ERROR("input parameter %s is null", "memory");
+        return NULL;
+    }
+
+    pool_attr_t pool_attr[POOL_CLASS_COUNT];
+    pool_classes_init_attr(pool_attr, class_acount);
+    if (memory_size < pool_classes_caculate_length(class_acount)) {
+        return NULL;
+    }
+
+    pool_classes_t* classes = (pool_classes_t*) memory;
+    memset(classes, 0, sizeof(pool_classes_t));
+    offset_ptr_set(&classes->pools, pools_init((char*) memory + POOL_CLASSES_HEAD_LENGTH,
+            memory_size - POOL_CLASSES_HEAD_LENGTH, POOL_CLASS_COUNT, pool_attr));
+    return classes;
+}
+
+/* Note: a full class is spilled into the next larger one, the memory is wasted but the caller gets it */
+void* pool_alloc(void* classes, size_t size)
+{
+    pool_classes_t* pool_classes = (pool_classes_t*) classes;
+    if (unlikely(size > POOL_CLASS_MAX_SIZE)) {
+        return NULL;
+    }
+
+    void* pools = offset_ptr_get(&pool_classes->pools);
+    int size_class = pool_get_size_class(size);
+    int i;
+    for (i = size_class; i < POOL_CLASS_COUNT; i++) {
+        void* element = pool_get_element(pools, i);
+        if (likely(element != NULL)) {
+            if (++pool_classes->in_use[i] > pool_classes->peak[i]) {
+                pool_classes->peak[i] = pool_classes->in_use[i];
+            }
+            return element;
+        }
+    }
+
+    pool_classes->failures[size_class]++;
+    return NULL;
+}
+
+/* Note: the pools are laid out by increasing class, the last one starting below the element owns it */
+void pool_free(void* classes, void* element)
+{
+    if (unlikely(element == NULL)) {
+        return;
+    }
+
+    pool_classes_t* pool_classes = (pool_classes_t*) classes;
+    void* pools = offset_ptr_get(&pool_classes->pools);
+    int i = POOL_CLASS_COUNT - 1;
+    while (i > 0 && (char*) element < (char*) pool_get_pool(pools, i)) {
+        i--;
+    }
+
+    pool_free_element(pools, i, element);
+    pool_classes->in_use[i]--;
+}
+
+void pool_get_class_stats(void* classes, pool_class_stats_t stats[POOL_CLASS_COUNT])
+{
+    pool_classes_t* pool_classes = (pool_classes_t*) classes;
+    void* pools = offset_ptr_get(&pool_classes->pools);
+    int i;
+    for (i = 0; i < POOL_CLASS_COUNT; i++) {
+        element_pool_t* pool = pool_get_pool(pools, i);
+        stats[i].entry_size = (size_t) POOL_CLASS_MIN_SIZE << i;
+        stats[i].capacity = (libcache_scale_t) pool->element_acount;
+        stats[i].in_use = pool_classes->in_use[i];
+        stats[i].peak = pool_classes->peak[i];
+        stats[i].failures = pool_classes->failures[i];
+    }
 }
 
 return_t pool_set_reserved_pointer(void* element, void* to_set)
 {
     return_t ret;
-    element_usr_data_t *element_user_data = (element_usr_data_t *) pool_get_element_head(element);
-    if (unlikely(element_user_data == NULL)) {
-        DEBUG_ERROR("%s is NULL.", "element_user_data");
+    element_head_t *element_head = pool_get_element_head(element);
+    if (unlikely(element_head == NULL)) {
+        DEBUG_ERROR("%s is NULL.", "element_head");
         ret = ERR;
     } else {
-        element_user_data->reserved_pointer = to_set;
+        offset_ptr_set(&element_head->reserved_pointer, to_set);
         ret = OK;
     }
 
@@ -157,7 +546,6 @@ return_t pool_set_reserved_pointer(void* element, void* to_set)
 
 void* pool_get_reserved_pointer(void* element)
 {
-    element_usr_data_t *element_user_data = pool_get_element_head(element);
-    return (element_user_data == NULL) ? NULL : element_user_data->reserved_pointer;
+    element_head_t *element_head = pool_get_element_head(element);
+    return (element_head == NULL) ? NULL : offset_ptr_get(&element_head->reserved_pointer);
 }
-
@@ -0,0 +1,835 @@
+/*
+ * libshard.c
+ *
+ *  A cache split into shards, each shard is a libcache object with its own lock
+ *  and its own memory region placed on a NUMA node.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "libcache.h"
+#include "libarena.h"
+#include "libshard.h"
+#include "ring.h"
+
+#define LIBSHARD_CACHE_LINE (64)
+#define LIBSHARD_DEFAULT_RING_SIZE (1024)
+#define LIBSHARD_MAX_BATCH (64)
+#define LIBSHARD_ACCESS_STRIPES (8)
+#define LIBSHARD_ACCESS_SLOTS (16)
+#define LIBSHARD_HOT_COUNTERS (256)
+#define LIBSHARD_HOT_SLOTS (16)
+#define LIBSHARD_HOT_HIT_BATCH (16)
+#define LIBSHARD_DEFAULT_HOT_WINDOW (65536)
+#define LIBSHARD_PAGE_SIZE (4096)
+
+/* Lossy buffer of hits waiting to be applied to the LRU list (deferred promotion).
+ * Readers claim a slot by moving tail, the holder of the write lock drains up to tail.
+ * A reader finding the buffer full drops its hit.
+ */
+typedef struct libshard_access_buffer_t
+{
+    unsigned int head;
+    unsigned int tail;
+    void* slots[LIBSHARD_ACCESS_SLOTS];
+} __attribute__((aligned(LIBSHARD_CACHE_LINE))) libshard_access_buffer_t;
+
+/* Read-only copy of a hot key, guarded by a sequence lock: odd while it is written.
+ * A set of LIBSHARD_HOT_SLOTS replicas is kept on every NUMA node, a key goes to slot number % LIBSHARD_HOT_SLOTS.
+ */
+typedef struct libshard_replica_t
+{
+    uint32_t sequence;
+    uint32_t in_use;
+    int shard_index;
+    libcache_scale_t number; /* key_to_number of the key */
+    char data[];             /* key, then entry */
+} libshard_replica_t;
+
+typedef struct libshard_shard_t
+{
+    pthread_rwlock_t lock; /* read: lookups with deferred promotion, write: the others */
+    void* cache;
+    void* memory;
+    size_t memory_size;
+    arena_report_t memory_report; /* pages of the memory and how it was populated */
+    int numa_node;
+    int numa_bound;
+    ring_t* ring; /* owner mode: requests from the other threads */
+    size_t ring_memory_size;
+    libcache_scale_t entry_number; /* owner mode: published by the owner after every batch */
+    libshard_access_buffer_t access[LIBSHARD_ACCESS_STRIPES];
+    uint32_t window_lookups; /* hot keys: lookups in this window */
+    uint32_t hot_counters[LIBSHARD_HOT_COUNTERS]; /* hot keys: lookups per key number in this window */
+} __attribute__((aligned(LIBSHARD_CACHE_LINE))) libshard_shard_t;
+
+typedef struct libshard_t
+{
+    libshard_attr_t attr;
+    int numa_node_count;
+    size_t size;
+    char* replicas;          /* per node: | hits[LIBSHARD_HOT_SLOTS] | replica slots | */
+    size_t replica_slot_size;
+    size_t replica_set_size;
+    libshard_shard_t shards[];
+} libshard_t;
+
+static __thread int libshard_thread_node = -1;
+static __thread int libshard_thread_stripe = -1;
+static unsigned int libshard_stripe_counter = 0;
+static __thread unsigned int libshard_thread_hits = 0;
+
+static inline libshard_shard_t* libshard_get_shard(libshard_t* libshard, int shard_index)
+{
+    return &libshard->shards[shard_index];
+}
+
+/* Note: the entry lives in the memory region of its shard */
+static libshard_shard_t* libshard_get_shard_by_entry(libshard_t* libshard, const void* entry)
+{
+    int i;
+    for (i = 0; i < libshard->attr.shard_count; i++) {
+        libshard_shard_t* shard = libshard_get_shard(libshard, i);
+        if ((const char*) entry >= (const char*) shard->memory
+                && (const char*) entry < (const char*) shard->memory + shard->memory_size) {
+            return shard;
+        }
+    }
+    return NULL;
+}
+
+/* Note: in owner mode only the owner touches a shard, so the lock based API is refused */
+static inline int libshard_refuse_owner_mode(const libshard_t* libshard)
+{
+    if (unlikely(libshard->attr.owner_mode)) {
+        DEBUG_ERROR("%s is in owner mode.", "shards");
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static inline libshard_access_buffer_t* libshard_get_access_buffer(libshard_shard_t* shard)
+{
+    if (unlikely(libshard_thread_stripe < 0)) {
+        libshard_thread_stripe = (int) (__atomic_fetch_add(&libshard_stripe_counter, 1, __ATOMIC_RELAXED)
+                % LIBSHARD_ACCESS_STRIPES);
+    }
+    return &shard->access[libshard_thread_stripe];
+}
+
+/* Note: the caller holds the write lock of the shard */
+static void libshard_drain_access(libshard_shard_t* shard)
+{
+    int i;
+    for (i = 0; i < LIBSHARD_ACCESS_STRIPES; i++) {
+        libshard_access_buffer_t* buffer = &shard->access[i];
+        unsigned int tail = __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE);
+        unsigned int head;
+        for (head = buffer->head; head != tail; head++) {
+            // Note: a slot claimed but not written yet is skipped, that hit is lost.
+            //       An entry deleted meanwhile is not in the cache any more and is ignored.
+            void* entry = __atomic_exchange_n(&buffer->slots[head % LIBSHARD_ACCESS_SLOTS], NULL, __ATOMIC_ACQUIRE);
+            if (entry != NULL) {
+                (void) libcache_promote_entry(shard->cache, entry);
+            }
+        }
+        __atomic_store_n(&buffer->head, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static inline void libshard_write_lock(libshard_shard_t* shard)
+{
+    pthread_rwlock_wrlock(&shard->lock);
+    libshard_drain_access(shard);
+}
+
+/* Note: records a hit of a reader, returns TRUE when the buffer should be drained */
+static int libshard_record_access(libshard_shard_t* shard, void* entry)
+{
+    libshard_access_buffer_t* buffer = libshard_get_access_buffer(shard);
+    unsigned int tail = __atomic_load_n(&buffer->tail, __ATOMIC_RELAXED);
+    unsigned int head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+
+    if (tail - head >= LIBSHARD_ACCESS_SLOTS) {
+        return TRUE;
+    }
+    if (!__atomic_compare_exchange_n(&buffer->tail, &tail, tail + 1, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return FALSE;
+    }
+    __atomic_store_n(&buffer->slots[tail % LIBSHARD_ACCESS_SLOTS], entry, __ATOMIC_RELEASE);
+    return (tail + 1 - head >= LIBSHARD_ACCESS_SLOTS);
+}
+
+static int libshard_get_thread_node(const libshard_t* libshard)
+{
+    int node = (libshard_thread_node >= 0) ? libshard_thread_node : arena_numa_current_node();
+    return node % libshard->numa_node_count;
+}
+
+static inline uint32_t* libshard_get_replica_hits(const libshard_t* libshard, int node)
+{
+    return (uint32_t*) (libshard->replicas + libshard->replica_set_size * node);
+}
+
+static inline libshard_replica_t* libshard_get_replica(const libshard_t* libshard, int node, int slot)
+{
+    return (libshard_replica_t*) (libshard->replicas + libshard->replica_set_size * node
+            + LIBSHARD_CACHE_LINE + libshard->replica_slot_size * slot);
+}
+
+/* Note: serves a copying lookup from the replicas on the caller's node, no lock is taken */
+static int libshard_replica_lookup(const libshard_t* libshard, const void* key, libcache_scale_t number, void* dst_entry)
+{
+    int node = libshard_get_thread_node(libshard);
+    int slot = (int) (number % LIBSHARD_HOT_SLOTS);
+    libshard_replica_t* replica = libshard_get_replica(libshard, node, slot);
+
+    uint32_t sequence = __atomic_load_n(&replica->sequence, __ATOMIC_ACQUIRE);
+    if ((sequence & 1) || !__atomic_load_n(&replica->in_use, __ATOMIC_RELAXED)
+            || __atomic_load_n(&replica->number, __ATOMIC_RELAXED) != number
+            || libshard->attr.cmp_key(key, replica->data) != LIBCACHE_EQU) {
+        return FALSE;
+    }
+    memcpy(dst_entry, replica->data + libshard->attr.key_size, libshard->attr.entry_size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&replica->sequence, __ATOMIC_RELAXED) != sequence) {
+        return FALSE;
+    }
+
+    // Note: hits are added by batches, so the readers rarely write the shared line
+    if ((++libshard_thread_hits % LIBSHARD_HOT_HIT_BATCH) == 0) {
+        __atomic_add_fetch(&libshard_get_replica_hits(libshard, node)[slot], LIBSHARD_HOT_HIT_BATCH, __ATOMIC_RELAXED);
+    }
+    return TRUE;
+}
+
+/* Note: the caller holds the lock of the shard, copies go to the free slots only */
+static void libshard_replicate(libshard_t* libshard, int shard_index, libcache_scale_t number,
+        const void* key, const void* entry)
+{
+    int slot = (int) (number % LIBSHARD_HOT_SLOTS);
+    int node;
+    for (node = 0; node < libshard->numa_node_count; node++) {
+        libshard_replica_t* replica = libshard_get_replica(libshard, node, slot);
+        uint32_t sequence = __atomic_load_n(&replica->sequence, __ATOMIC_ACQUIRE);
+        if ((sequence & 1) || __atomic_load_n(&replica->in_use, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if (!__atomic_compare_exchange_n(&replica->sequence, &sequence, sequence + 1, FALSE,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        replica->shard_index = shard_index;
+        __atomic_store_n(&replica->number, number, __ATOMIC_RELAXED);
+        memcpy(replica->data, key, libshard->attr.key_size);
+        memcpy(replica->data + libshard->attr.key_size, entry, libshard->attr.entry_size);
+        __atomic_store_n(&libshard_get_replica_hits(libshard, node)[slot], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&replica->in_use, TRUE, __ATOMIC_RELAXED);
+        __atomic_store_n(&replica->sequence, sequence + 2, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ *  @brief libshard_drop_replica    empties a replica slot if it holds a key of the shard.
+ *
+ *  @param number                   key number to drop, NULL for any key of the shard.
+ *  NOTE:  The caller holds the write lock of the shard, so only a copy of another shard may be in progress.
+ */
+static void libshard_drop_replica(libshard_replica_t* replica, int shard_index, const libcache_scale_t* number)
+{
+    while (1) {
+        uint32_t sequence = __atomic_load_n(&replica->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            continue;
+        }
+        if (!__atomic_load_n(&replica->in_use, __ATOMIC_RELAXED) || replica->shard_index != shard_index
+                || (NULL != number && __atomic_load_n(&replica->number, __ATOMIC_RELAXED) != *number)) {
+            return;
+        }
+        if (__atomic_compare_exchange_n(&replica->sequence, &sequence, sequence + 1, FALSE,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&replica->in_use, FALSE, __ATOMIC_RELAXED);
+            __atomic_store_n(&replica->sequence, sequence + 2, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+/* Note: a write invalidates the replicas of its key, or all of the shard when the key isn't known */
+static void libshard_invalidate(libshard_t* libshard, int shard_index, const void* key)
+{
+    if (likely(NULL == libshard->replicas)) {
+        return;
+    }
+
+    int node;
+    int slot;
+    if (NULL != key) {
+        libcache_scale_t number = libshard->attr.key_to_number(key);
+        for (node = 0; node < libshard->numa_node_count; node++) {
+            libshard_drop_replica(libshard_get_replica(libshard, node, (int) (number % LIBSHARD_HOT_SLOTS)),
+                    shard_index, &number);
+        }
+        return;
+    }
+    for (node = 0; node < libshard->numa_node_count; node++) {
+        for (slot = 0; slot < LIBSHARD_HOT_SLOTS; slot++) {
+            libshard_drop_replica(libshard_get_replica(libshard, node, slot), shard_index, NULL);
+        }
+    }
+}
+
+/* Note: counts a lookup under the shard lock, returns TRUE when the window of the shard is over */
+static int libshard_count_access(libshard_t* libshard, int shard_index, libcache_scale_t number,
+        const void* key, const void* entry)
+{
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    uint32_t count = __atomic_add_fetch(&shard->hot_counters[number % LIBSHARD_HOT_COUNTERS], 1, __ATOMIC_RELAXED);
+    if (count % libshard->attr.hot_threshold == 0) {
+        libshard_replicate(libshard, shard_index, number, key, entry);
+    }
+
+    uint32_t window = (libshard->attr.hot_window > 0) ? libshard->attr.hot_window : LIBSHARD_DEFAULT_HOT_WINDOW;
+    return __atomic_add_fetch(&shard->window_lookups, 1, __ATOMIC_RELAXED) == window;
+}
+
+/* Note: at the end of a window the counters restart, the replicas hit less than the threshold are torn down */
+static void libshard_roll_window(libshard_t* libshard, int shard_index)
+{
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    libshard_write_lock(shard);
+
+    __atomic_store_n(&shard->window_lookups, 0, __ATOMIC_RELAXED);
+    memset(shard->hot_counters, 0, sizeof(shard->hot_counters));
+
+    int node;
+    int slot;
+    for (node = 0; node < libshard->numa_node_count; node++) {
+        uint32_t* hits = libshard_get_replica_hits(libshard, node);
+        for (slot = 0; slot < LIBSHARD_HOT_SLOTS; slot++) {
+            libshard_replica_t* replica = libshard_get_replica(libshard, node, slot);
+            if (!__atomic_load_n(&replica->in_use, __ATOMIC_RELAXED) || replica->shard_index != shard_index) {
+                continue;
+            }
+            if (__atomic_exchange_n(&hits[slot], 0, __ATOMIC_RELAXED) < libshard->attr.hot_threshold) {
+                libshard_drop_replica(replica, shard_index, NULL);
+            }
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+static void libshard_release(libshard_t* libshard, int created_count)
+{
+    int i;
+    for (i = 0; i < created_count; i++) {
+        libshard_shard_t* shard = libshard_get_shard(libshard, i);
+        libcache_destroy(shard->cache);
+        arena_free(shard->memory, shard->memory_size);
+        arena_free(shard->ring, shard->ring_memory_size);
+        pthread_rwlock_destroy(&shard->lock);
+    }
+    arena_free(libshard->replicas, libshard->replica_set_size * libshard->numa_node_count);
+    arena_free(libshard, libshard->size);
+}
+
+/*
+ *  @brief libshard_create    creates a sharded cache, shard i is placed on NUMA node i % node count.
+ *
+ *  @param attr               shard count, per-shard capacity, entry/key sizes, callbacks and placement.
+ *  @return                   pointer of a sharded cache object, NULL on failure.
+ */
+void* libshard_create(const libshard_attr_t* attr)
+{
+    if (unlikely(attr == NULL || attr->shard_count <= 0 || attr->key_to_number == NULL || attr->cmp_key == NULL)) {
+        DEBUG_ERROR("argument %s is invalid.", "attr");
+        return NULL;
+    }
+
+    size_t size = sizeof(libshard_t) + sizeof(libshard_shard_t) * attr->shard_count;
+    libshard_t* libshard = (libshard_t*) arena_alloc(size);
+    if (unlikely(libshard == NULL)) {
+        return NULL;
+    }
+    libshard->attr = *attr;
+    libshard->size = size;
+    libshard->numa_node_count = (attr->numa_node_count > 0) ? attr->numa_node_count : arena_numa_node_count();
+
+    size_t memory_size = libcache_get_memory_size(attr->max_entry_number, attr->entry_size, attr->key_size);
+    int i;
+    for (i = 0; i < attr->shard_count; i++) {
+        libshard_shard_t* shard = libshard_get_shard(libshard, i);
+        shard->numa_node = i % libshard->numa_node_count;
+        shard->memory_size = memory_size;
+        shard->memory = arena_alloc_pages(&shard->memory_size, attr->pages, &shard->memory_report);
+        if (unlikely(shard->memory == NULL)) {
+            libshard_release(libshard, i);
+            return NULL;
+        }
+
+        // Note: the policy must be set before the pools touch the pages.
+        //       A simulated node the machine doesn't have stays unbound.
+        shard->numa_bound = (arena_numa_bind(shard->memory, shard->memory_size, shard->numa_node) == OK);
+        if (attr->populate) {
+            arena_populate(shard->memory, shard->memory_size, attr->populate, &shard->memory_report);
+        }
+
+        shard->cache = libcache_create_in_memory(shard->memory, shard->memory_size, attr->max_entry_number,
+                attr->entry_size, attr->key_size, NULL, attr->free_entry, attr->cmp_key, attr->key_to_number);
+        if (unlikely(shard->cache == NULL)) {
+            arena_free(shard->memory, shard->memory_size);
+            libshard_release(libshard, i);
+            return NULL;
+        }
+        pthread_rwlock_init(&shard->lock, NULL);
+        memset(shard->access, 0, sizeof(shard->access));
+
+        shard->ring = NULL;
+        shard->ring_memory_size = 0;
+        shard->entry_number = 0;
+        if (attr->owner_mode) {
+            unsigned int ring_size = (attr->ring_size > 0) ? attr->ring_size : LIBSHARD_DEFAULT_RING_SIZE;
+            shard->ring_memory_size = ring_get_memory_size(ring_size);
+            void* ring_memory = arena_alloc(shard->ring_memory_size);
+            if (ring_memory != NULL && shard->numa_bound) {
+                arena_numa_bind(ring_memory, shard->ring_memory_size, shard->numa_node);
+            }
+            shard->ring = (ring_memory == NULL) ? NULL : ring_init(ring_memory, ring_size);
+            if (unlikely(shard->ring == NULL)) {
+                arena_free(ring_memory, shard->ring_memory_size);
+                shard->ring_memory_size = 0;
+                libshard_release(libshard, i + 1);
+                return NULL;
+            }
+        }
+    }
+
+    if (attr->hot_threshold > 0 && !attr->owner_mode) {
+        // Note: every node reads the replicas of its own set, placed on it
+        libshard->replica_slot_size = (sizeof(libshard_replica_t) + attr->key_size + attr->entry_size
+                + LIBSHARD_CACHE_LINE - 1) & ~(size_t) (LIBSHARD_CACHE_LINE - 1);
+        libshard->replica_set_size = (LIBSHARD_CACHE_LINE + libshard->replica_slot_size * LIBSHARD_HOT_SLOTS
+                + LIBSHARD_PAGE_SIZE - 1) & ~(size_t) (LIBSHARD_PAGE_SIZE - 1);
+        libshard->replicas = (char*) arena_alloc(libshard->replica_set_size * libshard->numa_node_count);
+        if (unlikely(libshard->replicas == NULL)) {
+            libshard_release(libshard, attr->shard_count);
+            return NULL;
+        }
+        for (i = 0; i < libshard->numa_node_count; i++) {
+            arena_numa_bind(libshard->replicas + libshard->replica_set_size * i, libshard->replica_set_size, i);
+        }
+    }
+
+    return libshard;
+}
+
+/*
+ *  @brief libshard_destroy   destroys all the shards.
+ *
+ *  @param shards             sharded cache object, cannot be NULL.
+ *  @return
+ *      LIBCACHE_SUCCESS      all the shards were destroyed.
+ */
+libcache_ret_t libshard_destroy(void* shards)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard)) {
+        DEBUG_ERROR("input parameter %s is null", "shards");
+        return LIBCACHE_FAILURE;
+    }
+
+    libshard_release(libshard, libshard->attr.shard_count);
+    return LIBCACHE_SUCCESS;
+}
+
+void libshard_bind_thread(int numa_node)
+{
+    libshard_thread_node = numa_node;
+}
+
+int libshard_route(const void* shards, const void* key)
+{
+    const libshard_t* libshard = (const libshard_t*) shards;
+    libcache_scale_t number = libshard->attr.key_to_number(key);
+    int shard_count = libshard->attr.shard_count;
+
+    if (libshard->attr.route == LIBSHARD_ROUTE_LOCAL_NODE) {
+        // Note: shards of node n are n, n + node count, n + 2 * node count ...
+        int node_count = libshard->numa_node_count;
+        int node = libshard_get_thread_node(libshard);
+        int local_count = (shard_count - node + node_count - 1) / node_count;
+        if (likely(local_count > 0)) {
+            return node + (int) (number % local_count) * node_count;
+        }
+    }
+    return (int) (number % shard_count);
+}
+
+void* libshard_lookup(void* shards, const void* key, void* dst_entry)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "key");
+        return NULL;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return NULL;
+    }
+
+    int shard_index = libshard_route(libshard, key);
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    int hot = (NULL != libshard->replicas && NULL != dst_entry);
+    libcache_scale_t number = 0;
+    if (hot) {
+        number = libshard->attr.key_to_number(key);
+        if (libshard_replica_lookup(libshard, key, number, dst_entry)) {
+            return dst_entry;
+        }
+    }
+
+    void* return_value;
+    int window_over = FALSE;
+    if (NULL == dst_entry || !libshard->attr.deferred_promotion) {
+        libshard_write_lock(shard);
+        return_value = libcache_lookup(shard->cache, key, dst_entry);
+        if (NULL == dst_entry && NULL != return_value) {
+            // Note: the entry may be written through the returned pointer
+            libshard_invalidate(libshard, shard_index, key);
+        } else if (hot && NULL != return_value) {
+            window_over = libshard_count_access(libshard, shard_index, number, key, dst_entry);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    } else {
+        // Note: a copy only reads the cache, the hit goes to the access buffer
+        pthread_rwlock_rdlock(&shard->lock);
+        void* entry = libcache_peek(shard->cache, key, dst_entry);
+        return_value = (NULL == entry) ? NULL : dst_entry;
+        int full = (NULL != entry) && libshard_record_access(shard, entry);
+        if (hot && NULL != entry) {
+            window_over = libshard_count_access(libshard, shard_index, number, key, dst_entry);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+
+        if (full && 0 == pthread_rwlock_trywrlock(&shard->lock)) {
+            libshard_drain_access(shard);
+            pthread_rwlock_unlock(&shard->lock);
+        }
+    }
+
+    if (window_over) {
+        libshard_roll_window(libshard, shard_index);
+    }
+    return return_value;
+}
+
+void* libshard_add(void* shards, const void* key, const void* src_entry)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "key");
+        return NULL;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return NULL;
+    }
+
+    int shard_index = libshard_route(libshard, key);
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    libshard_write_lock(shard);
+    // Note: a replica may survive its key being evicted, it must not hide the new entry
+    libshard_invalidate(libshard, shard_index, key);
+    void* return_value = libcache_add(shard->cache, key, src_entry);
+    pthread_rwlock_unlock(&shard->lock);
+    return return_value;
+}
+
+void* libshard_get_or_add(void* shards, const void* key, const void* init_entry, int* inserted)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "key");
+        return NULL;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return NULL;
+    }
+
+    int shard_index = libshard_route(libshard, key);
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    libshard_write_lock(shard);
+    // Note: the entry may be added or written through the returned pointer
+    libshard_invalidate(libshard, shard_index, key);
+    void* return_value = libcache_get_or_add(shard->cache, key, init_entry, inserted);
+    pthread_rwlock_unlock(&shard->lock);
+    return return_value;
+}
+
+libcache_ret_t libshard_put(void* shards, const void* key, const void* src_entry, int flags)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "key");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return LIBCACHE_FAILURE;
+    }
+
+    int shard_index = libshard_route(libshard, key);
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    libshard_write_lock(shard);
+    libshard_invalidate(libshard, shard_index, key);
+    libcache_ret_t ret = libcache_put(shard->cache, key, src_entry, flags);
+    pthread_rwlock_unlock(&shard->lock);
+    return ret;
+}
+
+libcache_ret_t libshard_delete_by_key(void* shards, const void* key)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "key");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return LIBCACHE_FAILURE;
+    }
+
+    int shard_index = libshard_route(libshard, key);
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    libshard_write_lock(shard);
+    libshard_invalidate(libshard, shard_index, key);
+    libcache_ret_t return_value = libcache_delete_by_key(shard->cache, key);
+    pthread_rwlock_unlock(&shard->lock);
+    return return_value;
+}
+
+libcache_ret_t libshard_delete_entry(void* shards, void* entry)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard)) {
+        DEBUG_ERROR("input parameter %s is null", "shards");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return LIBCACHE_FAILURE;
+    }
+
+    libshard_shard_t* shard = libshard_get_shard_by_entry(libshard, entry);
+    if (unlikely(NULL == shard)) {
+        return LIBCACHE_NOT_FOUND;
+    }
+    libshard_write_lock(shard);
+    libshard_invalidate(libshard, (int) (shard - libshard->shards), NULL);
+    libcache_ret_t return_value = libcache_delete_entry(shard->cache, entry);
+    pthread_rwlock_unlock(&shard->lock);
+    return return_value;
+}
+
+libcache_ret_t libshard_unlock_entry(void* shards, void* entry)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == entry)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "entry");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return LIBCACHE_FAILURE;
+    }
+
+    libshard_shard_t* shard = libshard_get_shard_by_entry(libshard, entry);
+    if (unlikely(NULL == shard)) {
+        return LIBCACHE_NOT_FOUND;
+    }
+    libshard_write_lock(shard);
+    // Note: a copy made while the entry was being written may be in a replica
+    libshard_invalidate(libshard, (int) (shard - libshard->shards), NULL);
+    libcache_ret_t return_value = libcache_unlock_entry(shard->cache, entry);
+    pthread_rwlock_unlock(&shard->lock);
+    return return_value;
+}
+
+libcache_scale_t libshard_get_entry_number(void* shards)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard)) {
+        DEBUG_ERROR("input parameter %s is null", "shards");
+        return 0;
+    }
+
+    libcache_scale_t entry_number = 0;
+    int i;
+    for (i = 0; i < libshard->attr.shard_count; i++) {
+        libshard_shard_t* shard = libshard_get_shard(libshard, i);
+        // Note: the owner never takes the lock, read what it published
+        if (libshard->attr.owner_mode) {
+            entry_number += __atomic_load_n(&shard->entry_number, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        libshard_write_lock(shard);
+        entry_number += libcache_get_entry_number(shard->cache);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return entry_number;
+}
+
+int libshard_get_shard_count(const void* shards)
+{
+    const libshard_t* libshard = (const libshard_t*) shards;
+    return (NULL == libshard) ? 0 : libshard->attr.shard_count;
+}
+
+int libshard_is_owner_mode(const void* shards)
+{
+    const libshard_t* libshard = (const libshard_t*) shards;
+    return (NULL == libshard) ? FALSE : libshard->attr.owner_mode;
+}
+
+libcache_ret_t libshard_get_shard_info(void* shards, int shard_index, libshard_shard_info_t* info)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == info)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "info");
+        return LIBCACHE_FAILURE;
+    }
+    if (unlikely(shard_index < 0 || shard_index >= libshard->attr.shard_count)) {
+        return LIBCACHE_NOT_FOUND;
+    }
+
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    info->numa_node = shard->numa_node;
+    info->numa_bound = shard->numa_bound;
+    info->memory = shard->memory_report;
+    info->max_entry_number = libcache_get_max_entry_number(shard->cache);
+    info->replica_number = 0;
+    // Note: the owner never takes the lock, there are no replicas in owner mode
+    if (libshard->attr.owner_mode) {
+        info->entry_number = __atomic_load_n(&shard->entry_number, __ATOMIC_ACQUIRE);
+        return LIBCACHE_SUCCESS;
+    }
+
+    libshard_write_lock(shard);
+    info->entry_number = libcache_get_entry_number(shard->cache);
+    if (NULL != libshard->replicas) {
+        int node;
+        int slot;
+        for (node = 0; node < libshard->numa_node_count; node++) {
+            for (slot = 0; slot < LIBSHARD_HOT_SLOTS; slot++) {
+                libshard_replica_t* replica = libshard_get_replica(libshard, node, slot);
+                if (__atomic_load_n(&replica->in_use, __ATOMIC_ACQUIRE) && replica->shard_index == shard_index) {
+                    info->replica_number++;
+                }
+            }
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return LIBCACHE_SUCCESS;
+}
+
+libcache_ret_t libshard_clean(void* shards)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard)) {
+        DEBUG_ERROR("input parameter %s is null", "shards");
+        return LIBCACHE_FAILURE;
+    }
+
+    if (unlikely(libshard_refuse_owner_mode(libshard))) {
+        return LIBCACHE_FAILURE;
+    }
+
+    libcache_ret_t return_value = LIBCACHE_SUCCESS;
+    int i;
+    for (i = 0; i < libshard->attr.shard_count; i++) {
+        libshard_shard_t* shard = libshard_get_shard(libshard, i);
+        libshard_write_lock(shard);
+        libshard_invalidate(libshard, i, NULL);
+        if (libcache_clean(shard->cache) != LIBCACHE_SUCCESS) {
+            return_value = LIBCACHE_LOCKED;
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return return_value;
+}
+
+libcache_ret_t libshard_submit(void* shards, libshard_request_t* request)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || NULL == request || NULL == request->key)) {
+        DEBUG_ERROR("input parameter %s is null", (NULL == libshard) ? "shards" : "request");
+        return LIBCACHE_FAILURE;
+    }
+    if (unlikely(!libshard->attr.owner_mode)) {
+        DEBUG_ERROR("%s is not in owner mode.", "shards");
+        return LIBCACHE_FAILURE;
+    }
+
+    libshard_shard_t* shard = libshard_get_shard(libshard, libshard_route(libshard, request->key));
+    request->done = FALSE;
+    return ring_enqueue(shard->ring, request) ? LIBCACHE_SUCCESS : LIBCACHE_FULL;
+}
+
+int libshard_request_done(const libshard_request_t* request)
+{
+    return __atomic_load_n(&request->done, __ATOMIC_ACQUIRE);
+}
+
+static libcache_ret_t libshard_owner_execute(void* cache, const libshard_request_t* request)
+{
+    if (unlikely(NULL == request->entry && LIBSHARD_OP_DELETE != request->op)) {
+        return LIBCACHE_FAILURE;
+    }
+
+    switch (request->op) {
+    case LIBSHARD_OP_LOOKUP:
+        return (NULL == libcache_lookup(cache, request->key, request->entry)) ? LIBCACHE_NOT_FOUND : LIBCACHE_SUCCESS;
+    case LIBSHARD_OP_ADD:
+        return (NULL == libcache_add(cache, request->key, request->entry)) ? LIBCACHE_FAILURE : LIBCACHE_SUCCESS;
+    case LIBSHARD_OP_DELETE:
+        return libcache_delete_by_key(cache, request->key);
+    default:
+        return LIBCACHE_FAILURE;
+    }
+}
+
+int libshard_owner_poll(void* shards, int shard_index, int max_batch)
+{
+    libshard_t* libshard = (libshard_t*) shards;
+    if (unlikely(NULL == libshard || !libshard->attr.owner_mode
+            || shard_index < 0 || shard_index >= libshard->attr.shard_count)) {
+        DEBUG_ERROR("argument %s is invalid.", "shard_index");
+        return 0;
+    }
+
+    libshard_shard_t* shard = libshard_get_shard(libshard, shard_index);
+    libshard_request_t* batch[LIBSHARD_MAX_BATCH];
+    if (max_batch > LIBSHARD_MAX_BATCH) {
+        max_batch = LIBSHARD_MAX_BATCH;
+    }
+
+    int count = ring_dequeue_burst(shard->ring, (void**) batch, max_batch);
+    int i;
+    for (i = 0; i < count; i++) {
+        batch[i]->result = libshard_owner_execute(shard->cache, batch[i]);
+    }
+    if (count > 0) {
+        __atomic_store_n(&shard->entry_number, libcache_get_entry_number(shard->cache), __ATOMIC_RELEASE);
+    }
+
+    // Note: results are published together once the batch is done
+    for (i = 0; i < count; i++) {
+        __atomic_store_n(&batch[i]->done, TRUE, __ATOMIC_RELEASE);
+    }
+    return count;
+}
@@ -16,13 +16,14 @@
  */
 static inline node_t * list_pop_front_internal(list_t *list)
 {
-    node_t *node_to_be_removed = list->head_node;
+    node_t *node_to_be_removed = list_front(list);
     if (1 == list->total_nodes) {
-        list->head_node = NULL;
-        list->tail_node = NULL;
+        list->head_node = 0;
+        list->tail_node = 0;
     } else {
-        list->head_node->next_node->previous_node = NULL;
-        list->head_node = list->head_node->next_node;
+        node_t *next = node_next(node_to_be_removed);
+        next->previous_node = 0;
+        offset_ptr_set(&list->head_node, next);
     }
     list->total_nodes--;
 
@@ -79,9 +80,9 @@ node_t * list_foreach(list_t *list, int (*traverse_node_cb)(node_t *node))
         return NULL;
     }
 
-    node_t *node_to_be_traversed = list->head_node;
+    node_t *node_to_be_traversed = list_front(list);
     while (node_to_be_traversed) {
-        node_t *next_node_to_be_traversed = node_to_be_traversed->next_node;
+        node_t *next_node_to_be_traversed = node_next(node_to_be_traversed);
         if (likely(traverse_node_cb && (0 == traverse_node_cb(node_to_be_traversed)))) {
             break;
         }
@@ -111,9 +112,9 @@ node_t * list_reverse_foreach(list_t *list, int (*traverse_node_cb)(node_t *node
         return NULL;
     }
 
-    node_t *node_to_be_traversed = list->tail_node;
+    node_t *node_to_be_traversed = list_back(list);
     while (node_to_be_traversed) {
-        node_t *next_node_to_be_traversed = node_to_be_traversed->previous_node;
+        node_t *next_node_to_be_traversed = node_previous(node_to_be_traversed);
         if (likely(traverse_node_cb && (0 == traverse_node_cb(node_to_be_traversed)))) {
             break;
         }
@@ -143,9 +144,9 @@ node_t * list_foreach_with_usr_data(list_t *list, int (*traverse_node_cb)(node_t
         return NULL;
     }
 
-    node_t *node_to_be_traversed = list->head_node;
+    node_t *node_to_be_traversed = list_front(list);
     while (node_to_be_traversed) {
-        node_t *next_node_to_be_traversed = node_to_be_traversed->next_node;
+        node_t *next_node_to_be_traversed = node_next(node_to_be_traversed);
         if (likely(traverse_node_cb && (0 == traverse_node_cb(node_to_be_traversed, usr_data)))) {
             break;
         }
@@ -0,0 +1,89 @@
+/*
+ * ring.c
+ *
+ *  Bounded lock-free ring of pointers: many producers, one consumer.
+ *  Every slot carries a sequence number telling whose turn it is,
+ *  so producers only compete on enqueue_pos.
+ */
+
+#include <stdio.h>
+#include "ring.h"
+
+size_t ring_get_memory_size(unsigned int slot_count)
+{
+    return sizeof(ring_t) + sizeof(ring_slot_t) * slot_count;
+}
+
+ring_t* ring_init(void* memory, unsigned int slot_count)
+{
+    if (unlikely(memory == NULL || slot_count == 0 || (slot_count & (slot_count - 1)) != 0)) {
+        DEBUG_ERROR("argument %s is invalid.", "slot_count");
+        return NULL;
+    }
+
+    ring_t* ring = (ring_t*) memory;
+    ring->mask = slot_count - 1;
+    ring->enqueue_pos = 0;
+    ring->dequeue_pos = 0;
+
+    size_t i;
+    for (i = 0; i < slot_count; i++) {
+        ring->slots[i].sequence = i;
+        ring->slots[i].data = NULL;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return ring;
+}
+
+int ring_enqueue(ring_t* ring, void* data)
+{
+    size_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    ring_slot_t* slot;
+    while (1) {
+        slot = &ring->slots[pos & ring->mask];
+        size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, TRUE,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return FALSE;
+        } else {
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->data = data;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+void* ring_dequeue(ring_t* ring)
+{
+    size_t pos = ring->dequeue_pos;
+    ring_slot_t* slot = &ring->slots[pos & ring->mask];
+    size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if (sequence != pos + 1) {
+        return NULL;
+    }
+
+    void* data = slot->data;
+    ring->dequeue_pos = pos + 1;
+    __atomic_store_n(&slot->sequence, pos + ring->mask + 1, __ATOMIC_RELEASE);
+    return data;
+}
+
+int ring_dequeue_burst(ring_t* ring, void* data[], int max_count)
+{
+    int count = 0;
+    while (count < max_count) {
+        void* item = ring_dequeue(ring);
+        if (item == NULL) {
+            break;
+        }
+        data[count++] = item;
+    }
+    return count;
+}
@@ -87,8 +87,8 @@ struct HashFixture {
         int i = 0;
         for (i = 0; i < 655350; i++) {
             list_entry = (node_t*) malloc(sizeof(node_t));
-            list_entry->usr_data = (test_data_t*) malloc(sizeof(test_data_t));
-            test_data_t* td = (test_data_t*) list_entry->usr_data;
+            node_set_usr_data(list_entry, malloc(sizeof(test_data_t)));
+            test_data_t* td = (test_data_t*) node_get_usr_data(list_entry);
             td->key = (int*) malloc(sizeof(int));
             memcpy(td->key, &i, sizeof(int));
 
@@ -116,17 +116,17 @@ TEST_FIXTURE(HashFixture, TestAddHash)
     int i = 0;
     uint32_t sum = 0;
     for (i = 0; i < g_hash->max_buckets; i++) {
-        bucket_t bucket = g_hash->bucket_list[i];
-        if (bucket.list != NULL) {
-            sum += bucket.list_count;
+        bucket_t* bucket = hash_get_bucket(g_hash, i);
+        if (bucket_get_list(bucket) != NULL) {
+            sum += bucket->list_count;
         }
     }
     CHECK(count == 655350);
 
     hash_free(g_hash, pools);
     CHECK(g_hash->entry_count == 0);
-    CHECK(g_hash->bucket_list[0].list == NULL);
-    CHECK(g_hash->bucket_list[0].list_count == 0);
+    CHECK(bucket_get_list(hash_get_bucket(g_hash, 0)) == NULL);
+    CHECK(hash_get_bucket(g_hash, 0)->list_count == 0);
 }
 
 TEST_FIXTURE(HashFixture, TestFindHash)
@@ -138,10 +138,11 @@ TEST_FIXTURE(HashFixture, TestFindHash)
     node_t* node = (node_t*) hash_find(g_hash, &value);
     CHECK(node != NULL);
 
-    int* p1 = (int*) (((test_data_t*) node->usr_data)->key);
-    node_t* pp = (node_t*) (((test_data_t*) node->usr_data)->entry);
-    hash_data_t* hd = (hash_data_t*) pp->usr_data;
-    int* p2 = (int*) hd->key;
+    hash_data_t* hd = (hash_data_t*) node_get_usr_data(node);
+    int* p1 = (int*) hash_data_get_key(hd);
+    node_t* pp = (node_t*) hash_data_get_cache_node(hd);
+    test_data_t* td = (test_data_t*) node_get_usr_data(pp);
+    int* p2 = (int*) td->key;
 
     CHECK(*p1 == 2000);
     CHECK(*p2 == 2000);
@@ -164,7 +165,7 @@ TEST_FIXTURE(HashFixture, TestDelHash)
 
     //get the first elements
     node_t* node2 = list_pop_front(list);
-    test_data_t* td = (test_data_t*) node2->usr_data;
+    test_data_t* td = (test_data_t*) node_get_usr_data(node2);
 
     void* del_node = hash_del(g_hash, &value, td->entry, pools);
     CHECK(del_node == node);
@@ -0,0 +1,122 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "UnitTest++.h"
+#include "libarena.h"
+
+TEST(libarena_ut_shm_create_attach)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/libarena_ut_%d", (int) getpid());
+
+    size_t size = 4096;
+    char* addr = (char*) arena_shm_create(name, &size);
+    CHECK(addr != NULL);
+    CHECK_EQUAL(4096, (int) size);
+
+    // Note: the name is exclusive
+    size_t size2 = 4096;
+    CHECK(arena_shm_create(name, &size2) == NULL);
+
+    strcpy(addr, "shared");
+
+    size_t attach_size = 0;
+    char* addr2 = (char*) arena_shm_attach(name, &attach_size);
+    CHECK(addr2 != NULL);
+    CHECK(addr2 != addr);
+    CHECK_EQUAL(4096, (int) attach_size);
+    CHECK_EQUAL("shared", addr2);
+
+    arena_shm_detach(addr2, attach_size);
+    arena_shm_detach(addr, size);
+
+    CHECK_EQUAL(OK, arena_shm_unlink(name));
+    CHECK_EQUAL(ERR, arena_shm_unlink(name));
+    CHECK(arena_shm_attach(name, &attach_size) == NULL);
+}
+
+TEST(libarena_ut_shm_invalid)
+{
+    size_t size = 4096;
+    CHECK(arena_shm_create(NULL, &size) == NULL);
+    CHECK(arena_shm_create("no_slash", &size) == NULL);
+    CHECK(arena_shm_create("/libarena_ut_null", NULL) == NULL);
+    CHECK(arena_shm_attach(NULL, &size) == NULL);
+}
+
+TEST(libarena_ut_numa)
+{
+    int node_count = arena_numa_node_count();
+    CHECK(node_count >= 1);
+    CHECK(arena_numa_current_node() >= 0);
+    CHECK(arena_numa_current_node() < node_count);
+
+    size_t size = 1024 * 1024;
+    char* addr = (char*) arena_alloc(size);
+    CHECK(addr != NULL);
+
+    CHECK_EQUAL(ERR, arena_numa_bind(addr, size, node_count));
+    CHECK_EQUAL(ERR, arena_numa_bind(addr, size, -1));
+    arena_numa_bind(addr, size, 0);
+    memset(addr, 1, size);
+
+    arena_free(addr, size);
+    CHECK(arena_alloc(0) == NULL);
+}
+
+TEST(libarena_ut_pages)
+{
+    arena_report_t report;
+    size_t size = 1;
+    CHECK(arena_alloc_pages(NULL, ARENA_PAGES_DEFAULT, &report) == NULL);
+
+    char* addr = (char*) arena_alloc_pages(&size, ARENA_PAGES_DEFAULT, &report);
+    CHECK(addr != NULL);
+    CHECK(size == 4096);
+    CHECK(report.pages == ARENA_PAGES_DEFAULT && report.reason == NULL);
+    arena_free(addr, size);
+
+    // Note: the machine may have no hugetlb pages reserved, then smaller pages are used and the reason is told
+    arena_pages_e wanted;
+    for (wanted = ARENA_PAGES_THP; wanted <= ARENA_PAGES_HUGE_1G; wanted = (arena_pages_e) (wanted + 1)) {
+        size = 3 * 1024 * 1024;
+        addr = (char*) arena_alloc_pages(&size, wanted, &report);
+        CHECK(addr != NULL);
+        CHECK(report.pages <= wanted);
+        CHECK((report.pages == wanted) == (report.reason == NULL));
+        CHECK(size % ARENA_HUGE_PAGE_SIZE == 0 || report.pages == ARENA_PAGES_DEFAULT);
+        CHECK(size >= 3 * 1024 * 1024);
+        CHECK((uintptr_t) addr % ARENA_HUGE_PAGE_SIZE == 0 || report.pages == ARENA_PAGES_DEFAULT);
+
+        addr[0] = 1;
+        memset(addr + size - 4096, 1, 4096);
+        arena_free(addr, size);
+    }
+}
+
+TEST(libarena_ut_populate)
+{
+    arena_report_t report;
+    memset(&report, 0, sizeof(report));
+    size_t size = 256 * 1024;
+    char* addr = (char*) arena_alloc_pages(&size, ARENA_PAGES_DEFAULT, &report);
+    CHECK(addr != NULL);
+    addr[4096] = 7;
+
+    CHECK(arena_populate(NULL, size, ARENA_PREFAULT, &report) == ERR);
+    CHECK(arena_populate(addr, size, ARENA_PREFAULT, &report) == OK);
+    CHECK(report.prefaulted && !report.locked && report.reason == NULL);
+    CHECK(addr[4096] == 7);
+
+    // Note: mlock may be refused by RLIMIT_MEMLOCK, the pages are prefaulted anyway
+    return_t ret = arena_populate(addr, size, ARENA_PREFAULT | ARENA_MLOCK, &report);
+    CHECK((ret == OK) == (report.locked == TRUE));
+    CHECK((ret == OK) == (report.reason == NULL));
+    CHECK(report.prefaulted);
+    CHECK(addr[4096] == 7);
+
+    arena_free(addr, size);
+}
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "UnitTest++.h"
+#include "libcache_coro.hpp"
+
+extern "C" {
+
+static uint32_t test_key_to_int(const void* key)
+{
+    uint32_t* value = (uint32_t*) key;
+    return *value;
+}
+
+static libcache_cmp_ret_t test_key_com(const void* key1, const void* key2)
+{
+    uint32_t* a = (uint32_t*) key1;
+    uint32_t* b = (uint32_t*) key2;
+
+    return (*a == *b) ? LIBCACHE_EQU : LIBCACHE_NOT_EQU;
+}
+
+}
+
+#define TEST_CORO_SHARDS     (4)
+#define TEST_CORO_ENTRIES    (1000)
+#define TEST_CORO_TASKS      (100)
+
+struct test_coro_entry_t {
+    uint32_t value;
+    char data[12];
+};
+
+static void* test_coro_create(int owner_mode, uint32_t ring_size)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = TEST_CORO_SHARDS;
+    attr.max_entry_number = TEST_CORO_ENTRIES;
+    attr.entry_size = sizeof(test_coro_entry_t);
+    attr.key_size = sizeof(uint32_t);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.numa_node_count = 1;
+    attr.owner_mode = owner_mode;
+    attr.ring_size = ring_size;
+    return libshard_create(&attr);
+}
+
+typedef libcache::async_cache<uint32_t, test_coro_entry_t> test_coro_cache_t;
+
+static libcache::task<int> test_coro_fill(test_coro_cache_t& cache, uint32_t first, uint32_t count)
+{
+    int added = 0;
+    uint32_t i;
+    for (i = first; i < first + count; i++) {
+        test_coro_entry_t entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.value = i * 3;
+        if (LIBCACHE_SUCCESS == co_await cache.add(i, entry)) {
+            added++;
+        }
+    }
+    co_return added;
+}
+
+static libcache::task<void> test_coro_client(test_coro_cache_t& cache, uint32_t first, int* errors)
+{
+    uint32_t count = TEST_CORO_ENTRIES / TEST_CORO_TASKS;
+
+    if ((int) count != co_await test_coro_fill(cache, first, count)) {
+        (*errors)++;
+    }
+    if (LIBCACHE_FAILURE != co_await cache.add(first, test_coro_entry_t())) {
+        (*errors)++;
+    }
+
+    uint32_t i;
+    for (i = first; i < first + count; i++) {
+        std::optional<test_coro_entry_t> entry = co_await cache.lookup(i);
+        if (!entry || entry->value != i * 3) {
+            (*errors)++;
+        }
+    }
+
+    if (LIBCACHE_SUCCESS != co_await cache.remove(first)) {
+        (*errors)++;
+    }
+    if (LIBCACHE_NOT_FOUND != co_await cache.remove(first)) {
+        (*errors)++;
+    }
+    if (co_await cache.lookup(first)) {
+        (*errors)++;
+    }
+}
+
+static void test_coro_run(void* shards, bool owner_mode)
+{
+    libcache::executor exec(shards, owner_mode);
+    test_coro_cache_t cache(shards, exec);
+    int errors = 0;
+    int i;
+
+    for (i = 0; i < TEST_CORO_TASKS; i++) {
+        exec.spawn(test_coro_client(cache, i * (TEST_CORO_ENTRIES / TEST_CORO_TASKS), &errors));
+    }
+    exec.run();
+
+    CHECK_EQUAL(0, (int) exec.pending());
+    CHECK_EQUAL(0, errors);
+    CHECK_EQUAL(TEST_CORO_ENTRIES - TEST_CORO_TASKS, (int) libshard_get_entry_number(shards));
+}
+
+TEST(TestCoroOwnerMode)
+{
+    /* small rings, so that submitting has to wait for the owners */
+    void* shards = test_coro_create(TRUE, 16);
+    CHECK(shards != NULL);
+
+    test_coro_run(shards, true);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_destroy(shards));
+}
+
+TEST(TestCoroDestroyPending)
+{
+    void* shards = test_coro_create(TRUE, 16);
+    CHECK(shards != NULL);
+
+    int errors = 0;
+    {
+        libcache::executor exec(shards, true);
+        test_coro_cache_t cache(shards, exec);
+        int i;
+        for (i = 0; i < TEST_CORO_TASKS; i++) {
+            exec.spawn(test_coro_client(cache, i * (TEST_CORO_ENTRIES / TEST_CORO_TASKS), &errors));
+        }
+        CHECK(exec.pending() > 0);
+    }
+
+    // Note: the executor drained the rings, nothing is left to write into the destroyed frames
+    int shard;
+    for (shard = 0; shard < TEST_CORO_SHARDS; shard++) {
+        CHECK(libshard_owner_poll(shards, shard, libcache::executor::max_batch) == 0);
+    }
+    CHECK(errors == 0);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_destroy(shards));
+}
+
+TEST(TestCoroLocked)
+{
+    void* shards = test_coro_create(FALSE, 0);
+    CHECK(shards != NULL);
+
+    test_coro_run(shards, false);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_destroy(shards));
+}
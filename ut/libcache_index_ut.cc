@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "UnitTest++.h"
+
+extern "C" {
+
+#include "libcache_index.h"
+#include "libcache_def.h"
+
+static uint32_t test_key_to_int(const void* key)
+{
+    uint32_t* value = (uint32_t*) key;
+    return *value;
+}
+
+static libcache_cmp_ret_t test_key_com(const void* key1, const void* key2)
+{
+    uint32_t* a = (uint32_t*) key1;
+    uint32_t* b = (uint32_t*) key2;
+
+    return (*a == *b) ? LIBCACHE_EQU : LIBCACHE_NOT_EQU;
+}
+
+/* every key lands on a few hash values, so the equal split-order keys are scanned */
+static uint32_t test_key_to_few(const void* key)
+{
+    return *(uint32_t*) key % 7;
+}
+
+}
+
+#define TEST_INDEX_ENTRIES   (20000)
+#define TEST_INDEX_THREADS   (4)
+#define TEST_INDEX_ROUNDS    (20000)
+
+TEST(TestIndexOperations)
+{
+    CHECK(libcache_index_create(0, sizeof(uint32_t), malloc, free, test_key_com, test_key_to_int) == NULL);
+
+    void* index = libcache_index_create(TEST_INDEX_ENTRIES, sizeof(uint32_t), malloc, free,
+            test_key_com, test_key_to_int);
+    CHECK(index != NULL);
+    CHECK_EQUAL(2, (int) libcache_index_get_bucket_number(index));
+
+    uint32_t i;
+    for (i = 0; i < TEST_INDEX_ENTRIES; i++) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_add(index, &i, (void*) (uintptr_t) (i + 1)));
+    }
+    i = TEST_INDEX_ENTRIES;
+    CHECK_EQUAL(LIBCACHE_FULL, libcache_index_add(index, &i, NULL));
+    CHECK_EQUAL(TEST_INDEX_ENTRIES, (int) libcache_index_get_entry_number(index));
+
+    // the table grew with the entries
+    CHECK(libcache_index_get_bucket_number(index) >= TEST_INDEX_ENTRIES / 4);
+
+    void* value = NULL;
+    for (i = 0; i < TEST_INDEX_ENTRIES; i++) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_lookup(index, &i, &value));
+        CHECK_EQUAL(i + 1, (uint32_t) (uintptr_t) value);
+    }
+
+    for (i = 0; i < TEST_INDEX_ENTRIES; i += 2) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_delete(index, &i));
+        CHECK_EQUAL(LIBCACHE_NOT_FOUND, libcache_index_delete(index, &i));
+        CHECK_EQUAL(LIBCACHE_NOT_FOUND, libcache_index_lookup(index, &i, &value));
+    }
+    CHECK_EQUAL(TEST_INDEX_ENTRIES / 2, (int) libcache_index_get_entry_number(index));
+    i = 5;
+    CHECK_EQUAL(LIBCACHE_FAILURE, libcache_index_add(index, &i, NULL));
+
+    // deleted nodes are reused
+    for (i = TEST_INDEX_ENTRIES; i < TEST_INDEX_ENTRIES * 3 / 2; i++) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_add(index, &i, NULL));
+    }
+    for (i = 1; i < TEST_INDEX_ENTRIES; i += 2) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_lookup(index, &i, &value));
+    }
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_destroy(index));
+}
+
+TEST(TestIndexSameHash)
+{
+    void* index = libcache_index_create(100, sizeof(uint32_t), malloc, free, test_key_com, test_key_to_few);
+    CHECK(index != NULL);
+
+    uint32_t i;
+    void* value = NULL;
+    for (i = 0; i < 100; i++) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_add(index, &i, (void*) (uintptr_t) i));
+    }
+    for (i = 0; i < 100; i += 3) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_delete(index, &i));
+    }
+    for (i = 0; i < 100; i++) {
+        CHECK_EQUAL((i % 3) ? LIBCACHE_SUCCESS : LIBCACHE_NOT_FOUND, libcache_index_lookup(index, &i, &value));
+        if (i % 3) {
+            CHECK_EQUAL(i, (uint32_t) (uintptr_t) value);
+        }
+    }
+
+    libcache_index_destroy(index);
+}
+
+static void* test_index_grower(void* arg)
+{
+    void* index = ((void**) arg)[0];
+    uint32_t base = (uint32_t) (uintptr_t) ((void**) arg)[1];
+    long failures = 0;
+    uint32_t i;
+    for (i = base; i < base + TEST_INDEX_ENTRIES / TEST_INDEX_THREADS; i++) {
+        void* value = NULL;
+        if (libcache_index_add(index, &i, (void*) (uintptr_t) i) != LIBCACHE_SUCCESS) {
+            failures++;
+        }
+        if (libcache_index_lookup(index, &i, &value) != LIBCACHE_SUCCESS || (uintptr_t) value != i) {
+            failures++;
+        }
+    }
+    return (void*) failures;
+}
+
+/* inserts and deletes the same few keys, so the nodes are reused all the time */
+static void* test_index_churner(void* arg)
+{
+    void* index = ((void**) arg)[0];
+    uint32_t base = (uint32_t) (uintptr_t) ((void**) arg)[1];
+    long failures = 0;
+    int round;
+    for (round = 0; round < TEST_INDEX_ROUNDS; round++) {
+        uint32_t key = base + (uint32_t) (round % 8);
+        void* value = NULL;
+        if (libcache_index_add(index, &key, (void*) (uintptr_t) key) != LIBCACHE_SUCCESS) {
+            failures++;
+        }
+        if (libcache_index_lookup(index, &key, &value) != LIBCACHE_SUCCESS || (uintptr_t) value != key) {
+            failures++;
+        }
+        if (libcache_index_delete(index, &key) != LIBCACHE_SUCCESS) {
+            failures++;
+        }
+    }
+    return (void*) failures;
+}
+
+static void test_index_run(void* index, void* (*worker)(void*), uint32_t first, uint32_t stride)
+{
+    pthread_t threads[TEST_INDEX_THREADS];
+    void* args[TEST_INDEX_THREADS][2];
+    int i;
+    for (i = 0; i < TEST_INDEX_THREADS; i++) {
+        args[i][0] = index;
+        args[i][1] = (void*) (uintptr_t) (first + i * stride);
+        pthread_create(&threads[i], NULL, worker, args[i]);
+    }
+    for (i = 0; i < TEST_INDEX_THREADS; i++) {
+        void* failures = NULL;
+        pthread_join(threads[i], &failures);
+        CHECK(failures == NULL);
+    }
+}
+
+TEST(TestIndexThreads)
+{
+    void* index = libcache_index_create(TEST_INDEX_ENTRIES + 100, sizeof(uint32_t), malloc, free,
+            test_key_com, test_key_to_int);
+    CHECK(index != NULL);
+
+    // the table doubles while the threads insert
+    test_index_run(index, test_index_grower, 0, TEST_INDEX_ENTRIES / TEST_INDEX_THREADS);
+    CHECK_EQUAL(TEST_INDEX_ENTRIES, (int) libcache_index_get_entry_number(index));
+    CHECK(libcache_index_get_bucket_number(index) >= TEST_INDEX_ENTRIES / 4);
+
+    test_index_run(index, test_index_churner, TEST_INDEX_ENTRIES, 1000);
+    CHECK_EQUAL(TEST_INDEX_ENTRIES, (int) libcache_index_get_entry_number(index));
+
+    uint32_t i;
+    void* value = NULL;
+    for (i = 0; i < TEST_INDEX_ENTRIES; i++) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_index_lookup(index, &i, &value));
+    }
+
+    libcache_index_destroy(index);
+}
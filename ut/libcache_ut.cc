@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "UnitTest++.h"
 
@@ -15,6 +18,12 @@ static uint32_t test_key_to_int(const void* key)
     return *value;
 }
 
+/* Note: the same hash at another address, like the callback of another process */
+static uint32_t test_key_to_int_other(const void* key)
+{
+    return test_key_to_int(key);
+}
+
 static libcache_cmp_ret_t test_key_com(const void* key1, const void* key2)
 {
     uint32_t* a = (uint32_t*) key1;
@@ -105,6 +114,31 @@ TEST_FIXTURE(LibCacheFixture, TestAdd)
 
 }
 
+static char g_refused_memory[64];
+static int g_refused_memory_freed = 0;
+
+/* Note: libcache_init refuses the capacity before it touches the memory */
+static void* test_refused_allocate(size_t size)
+{
+    (void) size;
+    return g_refused_memory;
+}
+
+static void test_refused_free(void* addr)
+{
+    if (addr == g_refused_memory) {
+        g_refused_memory_freed++;
+    }
+}
+
+TEST(TestCreateFailureFreesMemory)
+{
+    void* cache = libcache_create(1U << 27, sizeof(int), sizeof(int), test_refused_allocate, test_refused_free,
+            NULL, test_key_com, test_key_to_int);
+    CHECK(cache == NULL);
+    CHECK(g_refused_memory_freed == 1);
+}
+
 TEST_FIXTURE(LibCacheFixture, TestLookup)
 {
     int i = 0;
@@ -273,3 +307,873 @@ TEST_FIXTURE(LibCacheFixture, TestSwap)
         CHECK(value5 == NULL);
     }
 }
+
+TEST_FIXTURE(LibCacheFixture, TestPeekPromote)
+{
+    int i = 0;
+    for (i = 0; i <= g_max_entry_number; i++) {
+        int entry = 100 * i;
+        CHECK(libcache_add(g_cache, &i, &entry) != NULL);
+    }
+
+    // peek copies the entry but leaves it at the tail of the list
+    int key = 0;
+    int entry = 0;
+    int* value = (int*) libcache_peek(g_cache, &key, &entry);
+    CHECK(value != NULL && value != &entry);
+    CHECK_EQUAL(0, entry);
+
+    key = 1;
+    value = (int*) libcache_peek(g_cache, &key, NULL);
+    CHECK(value != NULL);
+    CHECK_EQUAL(100, *value);
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_promote_entry(g_cache, value));
+
+    key = 200;
+    CHECK(libcache_add(g_cache, &key, &entry) != NULL);
+    key = 201;
+    CHECK(libcache_add(g_cache, &key, &entry) != NULL);
+
+    // 0 and 2 were swapped out, the promoted 1 was kept
+    key = 0;
+    CHECK(libcache_peek(g_cache, &key, NULL) == NULL);
+    key = 2;
+    CHECK(libcache_peek(g_cache, &key, NULL) == NULL);
+    key = 1;
+    CHECK(libcache_peek(g_cache, &key, NULL) == value);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_delete_entry(g_cache, value));
+    CHECK_EQUAL(LIBCACHE_NOT_FOUND, libcache_promote_entry(g_cache, value));
+}
+
+TEST_FIXTURE(LibCacheFixture, TestGetOrAdd)
+{
+    int i = 0;
+    for (i = 0; i <= g_max_entry_number; i++) {
+        int entry = 100 * i;
+        CHECK(libcache_add(g_cache, &i, &entry) != NULL);
+    }
+
+    // an existing entry is returned locked and moved to the head of the list
+    int key = 0;
+    int entry = -1;
+    int inserted = TRUE;
+    int* value = (int*) libcache_get_or_add(g_cache, &key, &entry, &inserted);
+    CHECK(value != NULL && inserted == FALSE);
+    CHECK_EQUAL(0, *value);
+    CHECK_EQUAL(LIBCACHE_LOCKED, libcache_delete_by_key(g_cache, &key));
+
+    // a missing key is added with init_entry, the oldest entry 1 is swapped out
+    key = 300;
+    entry = 3;
+    int* added = (int*) libcache_get_or_add(g_cache, &key, &entry, &inserted);
+    CHECK(added != NULL && inserted == TRUE);
+    CHECK_EQUAL(3, *added);
+    CHECK(libcache_peek(g_cache, &key, NULL) == added);
+    key = 1;
+    CHECK(libcache_peek(g_cache, &key, NULL) == NULL);
+    key = 0;
+    CHECK(libcache_peek(g_cache, &key, NULL) == value);
+    CHECK_EQUAL(g_max_entry_number + 1, (int) libcache_get_entry_number(g_cache));
+
+    // the second call finds the entry added by the first one
+    key = 300;
+    CHECK(libcache_get_or_add(g_cache, &key, NULL, NULL) == added);
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_unlock_entry(g_cache, added));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_unlock_entry(g_cache, added));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_unlock_entry(g_cache, value));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_delete_by_key(g_cache, &key));
+    CHECK(libcache_get_or_add(NULL, &key, NULL, NULL) == NULL);
+}
+
+TEST_FIXTURE(LibCacheFixture, TestPut)
+{
+    int i = 0;
+    for (i = 0; i <= g_max_entry_number; i++) {
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_put(g_cache, &i, &i, 0));
+    }
+    int key = 0;
+    int* value = (int*) libcache_peek(g_cache, &key, NULL);
+
+    // overwriting copies into the same slot
+    int entry = 1000;
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_put(g_cache, &key, &entry, LIBCACHE_PUT_REPLACE));
+    CHECK(libcache_peek(g_cache, &key, NULL) == value);
+    CHECK_EQUAL(1000, *value);
+    CHECK_EQUAL(g_max_entry_number + 1, (int) libcache_get_entry_number(g_cache));
+
+    // without promotion 1 stays the oldest entry and is swapped out first
+    key = 1;
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_put(g_cache, &key, &entry, LIBCACHE_PUT_NO_PROMOTE));
+    key = 500;
+    CHECK_EQUAL(LIBCACHE_NOT_FOUND, libcache_put(g_cache, &key, &entry, LIBCACHE_PUT_REPLACE));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_put(g_cache, &key, &entry, 0));
+    key = 1;
+    CHECK(libcache_peek(g_cache, &key, NULL) == NULL);
+    key = 0;
+    CHECK(libcache_peek(g_cache, &key, NULL) == value);
+
+    // a locked entry is still overwritten
+    CHECK(libcache_lookup(g_cache, &key, NULL) == value);
+    entry = 7;
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_put(g_cache, &key, &entry, 0));
+    CHECK_EQUAL(7, *value);
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_unlock_entry(g_cache, value));
+    CHECK_EQUAL(LIBCACHE_FAILURE, libcache_put(g_cache, &key, NULL, 0));
+}
+
+TEST_FIXTURE(LibCacheFixture, TestBatch)
+{
+    int keys[g_max_entry_number + 1];
+    int entries[g_max_entry_number + 1];
+    libcache_ret_t results[g_max_entry_number + 1];
+    int i;
+    for (i = 0; i <= g_max_entry_number; i++) {
+        keys[i] = i;
+        entries[i] = 10 * i;
+    }
+    keys[50] = 3;
+    CHECK(g_max_entry_number == (int) libcache_add_batch(g_cache, keys, entries, g_max_entry_number + 1, results));
+    CHECK(LIBCACHE_SUCCESS == results[3]);
+    CHECK(LIBCACHE_FAILURE == results[50]);
+    int key = 100;
+    int entry = 0;
+    CHECK(libcache_lookup(g_cache, &key, &entry) != NULL);
+    CHECK(1000 == entry);
+
+    // a missing key, a locked entry and a key repeated in the batch
+    key = 4;
+    int* locked = (int*) libcache_lookup(g_cache, &key, NULL);
+    keys[0] = 50;
+    keys[1] = 3;
+    CHECK(g_max_entry_number - 3 == (int) libcache_delete_batch(g_cache, keys, g_max_entry_number + 1, results));
+    CHECK(LIBCACHE_NOT_FOUND == results[0]);
+    CHECK(LIBCACHE_SUCCESS == results[1]);
+    CHECK(LIBCACHE_NOT_FOUND == results[3]);
+    CHECK(LIBCACHE_LOCKED == results[4]);
+    CHECK(3 == libcache_get_entry_number(g_cache));
+
+    // the freed records are used again
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(g_cache, locked));
+    CHECK(g_max_entry_number - 3 == libcache_add_batch(g_cache, keys + 1, entries + 1, g_max_entry_number, NULL));
+    CHECK(g_max_entry_number == libcache_get_entry_number(g_cache));
+}
+
+static uint32_t test_key_to_colliding_int(const void* key)
+{
+    return *(const uint32_t*) key % 4;
+}
+
+TEST(TestRecordChains)
+{
+    const libcache_scale_t max_entry_number = 64;
+    void* cache = libcache_create(max_entry_number, sizeof(int), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_colliding_int);
+
+    // Note: one record per entry, the memory is the records, one bucket per entry,
+    //       2KB of tag lists and counts and the slots of the secondary indexes
+    CHECK(libcache_get_memory_size(max_entry_number, sizeof(int), sizeof(int)) < (max_entry_number + 1) * 128 + 3072);
+
+    int i;
+    for (i = 0; i <= (int) max_entry_number; i++) {
+        int entry = 10 * i;
+        CHECK(libcache_add(cache, &i, &entry) != NULL);
+    }
+
+    // Note: entries of one bucket differ only by key, they are removed from the middle of the chains
+    for (i = 0; i <= (int) max_entry_number; i += 3) {
+        CHECK(LIBCACHE_SUCCESS == libcache_delete_by_key(cache, &i));
+    }
+    for (i = 0; i <= (int) max_entry_number; i++) {
+        int entry = -1;
+        void* value = libcache_lookup(cache, &i, &entry);
+        if (i % 3 == 0) {
+            CHECK(value == NULL);
+        } else {
+            CHECK(value != NULL && entry == 10 * i);
+        }
+    }
+
+    // Note: swapping out the least recent entries unlinks them as well
+    for (i = 1000; i < 1000 + (int) max_entry_number; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    for (i = 1000; i < 1000 + (int) max_entry_number; i++) {
+        int entry = -1;
+        CHECK(libcache_lookup(cache, &i, &entry) != NULL && entry == i);
+    }
+    CHECK(libcache_get_entry_number(cache) == max_entry_number + 1);
+
+    libcache_destroy(cache);
+}
+
+TEST(TestCompactLinks)
+{
+    // Note: an entry of 8 bytes with a key of 8 bytes costs a 24 bytes record, its buckets and 18 bytes of metadata
+    size_t memory_size = libcache_get_memory_size(1000, 8, 8);
+    CHECK((libcache_get_memory_size(2000, 8, 8) - memory_size) / 1000 <= 24 + 8 + 8 + 8 + 18);
+}
+
+static void* g_untouched_memory = NULL;
+static size_t g_untouched_size = 0;
+
+static void* test_untouched_allocate(size_t size)
+{
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    g_untouched_memory = (MAP_FAILED == memory) ? NULL : memory;
+    g_untouched_size = size;
+    return g_untouched_memory;
+}
+
+static void test_untouched_free(void* addr)
+{
+    munmap(addr, g_untouched_size);
+}
+
+static size_t test_resident_pages(void* memory, size_t size)
+{
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t page_count = (size + page_size - 1) / page_size;
+    unsigned char* vector = (unsigned char*) malloc(page_count);
+    size_t resident = 0;
+    if (0 == mincore(memory, size, vector)) {
+        size_t i;
+        for (i = 0; i < page_count; i++) {
+            resident += vector[i] & 1;
+        }
+    }
+    free(vector);
+    return resident;
+}
+
+TEST(TestCreateTouchesLittle)
+{
+    // Note: create writes the pool heads and the cache object, no page per capacity is faulted in
+    void* cache = libcache_create(1000000, 64, sizeof(int), test_untouched_allocate, test_untouched_free, NULL,
+            test_key_com, test_key_to_int);
+    CHECK(cache != NULL);
+    CHECK(test_resident_pages(g_untouched_memory, g_untouched_size) < 16);
+
+    char entry[64] = {0};
+    int i;
+    for (i = 0; i < 100; i++) {
+        CHECK(libcache_add(cache, &i, entry) != NULL);
+    }
+    i = 99;
+    CHECK(libcache_peek(cache, &i, NULL) != NULL);
+    libcache_destroy(cache);
+}
+
+TEST(TestExpireAndTags)
+{
+    void* cache = libcache_create(300, sizeof(int), sizeof(int), malloc, free, NULL, test_key_com, test_key_to_int);
+
+    libcache_set_clock(cache, 100);
+    int i;
+    for (i = 0; i < 300; i++) {
+        void* entry = libcache_add(cache, &i, &i);
+        CHECK(entry != NULL);
+        CHECK(LIBCACHE_SUCCESS == libcache_set_tag(cache, entry, (uint8_t) (i % 3)));
+        if (i % 10 == 0) {
+            CHECK(LIBCACHE_SUCCESS == libcache_set_expiry(cache, entry, 150 + i));
+        }
+    }
+
+    libcache_scale_t counts[256];
+    CHECK(LIBCACHE_SUCCESS == libcache_count_tags(cache, counts));
+    CHECK(counts[0] == 100 && counts[1] == 100 && counts[2] == 100 && counts[3] == 0);
+
+    // Note: entries 0, 10 .. 100 expire at 250, a locked one stays
+    i = 0;
+    void* locked_entry = libcache_lookup(cache, &i, NULL);
+    CHECK(libcache_expire(cache, 250, 0) == 10);
+    CHECK(libcache_get_entry_number(cache) == 290);
+    CHECK(libcache_peek(cache, &i, NULL) != NULL);
+    i = 100;
+    CHECK(libcache_peek(cache, &i, NULL) == NULL);
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(cache, locked_entry));
+
+    // Note: entries looked up at 1000 are kept, the others idled for 1000 ticks or expired
+    libcache_set_clock(cache, 1000);
+    for (i = 201; i < 210; i++) {
+        int entry;
+        CHECK(libcache_lookup(cache, &i, &entry) != NULL);
+    }
+    CHECK(libcache_expire(cache, 1100, 500) == 281);
+    CHECK(libcache_get_entry_number(cache) == 9);
+    CHECK(LIBCACHE_SUCCESS == libcache_count_tags(cache, counts));
+    CHECK(counts[0] == 3 && counts[1] == 3 && counts[2] == 3);
+
+    libcache_destroy(cache);
+}
+
+static void* test_dirty_allocate(size_t size)
+{
+    void* memory = malloc(size);
+    if (NULL != memory) {
+        memset(memory, 0x01, size);
+    }
+    return memory;
+}
+
+TEST(TestExpireOnDirtyMemory)
+{
+    // Note: the metadata of the slots never used is left as the allocator gave it
+    void* cache = libcache_create(1000, sizeof(int), sizeof(int), test_dirty_allocate, free, NULL,
+            test_key_com, test_key_to_int);
+    CHECK(cache != NULL);
+    libcache_set_clock(cache, 0x02000000);
+    int i;
+    for (i = 0; i < 70; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    CHECK(libcache_expire(cache, 0x02000000, 0) == 0);
+    CHECK(libcache_get_entry_number(cache) == 70);
+    libcache_destroy(cache);
+}
+
+TEST(TestExpireAcrossWrap)
+{
+    void* cache = libcache_create(10, sizeof(int), sizeof(int), malloc, free, NULL, test_key_com, test_key_to_int);
+
+    libcache_set_clock(cache, UINT32_MAX - 5);
+    int i;
+    for (i = 0; i < 3; i++) {
+        void* entry = libcache_add(cache, &i, &i);
+        CHECK(entry != NULL);
+        // Note: entry 0 expires before the wrap, entries 1 and 2 after it
+        CHECK(LIBCACHE_SUCCESS == libcache_set_expiry(cache, entry, (uint32_t) (UINT32_MAX - 2 + i * 5)));
+    }
+
+    CHECK(libcache_expire(cache, UINT32_MAX - 5, 0) == 0);
+    CHECK(libcache_expire(cache, UINT32_MAX, 0) == 1);
+    CHECK(libcache_get_entry_number(cache) == 2);
+    CHECK(libcache_expire(cache, 1, 0) == 0);
+    CHECK(libcache_expire(cache, 2, 0) == 1);
+    CHECK(libcache_expire(cache, 7, 0) == 1);
+    CHECK(libcache_get_entry_number(cache) == 0);
+
+    libcache_destroy(cache);
+}
+
+static void test_tag_sum(const void* key, void* entry, void* arg)
+{
+    int* sum = (int*) arg;
+    sum[0] += *(const int*) key;
+    sum[1] += (*(const int*) key % 4 != *(int*) entry % 4);
+}
+
+TEST(TestTagIndex)
+{
+    void* cache = libcache_create(64, sizeof(int), sizeof(int), malloc, free, NULL, test_key_com, test_key_to_int);
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 300));
+    int i;
+    for (i = 0; i < 300; i++) {
+        void* entry = libcache_add(cache, &i, &i);
+        CHECK(LIBCACHE_SUCCESS == libcache_set_tag(cache, entry, (uint8_t) (i % 4)));
+    }
+    CHECK(libcache_count_by_tag(cache, 0) == 75 && libcache_count_by_tag(cache, 1) == 75);
+
+    // a locked entry isn't deleted, a retagged one moves to its new list
+    i = 2;
+    void* locked_entry = libcache_lookup(cache, &i, NULL);
+    CHECK(libcache_delete_by_tag(cache, 2) == 74);
+    CHECK(libcache_count_by_tag(cache, 2) == 1 && libcache_get_entry_number(cache) == 226);
+    CHECK(LIBCACHE_SUCCESS == libcache_set_tag(cache, locked_entry, 9));
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(cache, locked_entry));
+    CHECK(libcache_count_by_tag(cache, 2) == 0 && libcache_count_by_tag(cache, 9) == 1);
+    CHECK(libcache_delete_by_tag(cache, 2) == 0);
+
+    // the records moved out of the released chunk stay in their tag lists
+    for (i = 0; i < 240; i++) {
+        libcache_delete_by_key(cache, &i);
+    }
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 64));
+    while (LIBCACHE_SUCCESS != libcache_resize_step(cache)) {
+    }
+    int sum[2] = {0, 0};
+    CHECK(libcache_foreach_tag(cache, 1, test_tag_sum, sum) == 15);
+    CHECK(sum[0] == (241 + 297) * 15 / 2 && sum[1] == 0);
+    CHECK(libcache_delete_by_tag(cache, 3) == 15);
+    CHECK(libcache_foreach_tag(cache, 3, test_tag_sum, sum) == 0);
+    CHECK(libcache_foreach_tag(cache, 0, test_tag_sum, sum) == 0);
+
+    libcache_scale_t counts[256];
+    CHECK(LIBCACHE_SUCCESS == libcache_count_tags(cache, counts));
+    CHECK(counts[0] == 15 && counts[1] == 15 && counts[3] == 0 && counts[9] == 0);
+    CHECK(libcache_get_entry_number(cache) == 30);
+
+    CHECK(LIBCACHE_SUCCESS == libcache_clean(cache));
+    CHECK(libcache_count_by_tag(cache, 0) == 0 && libcache_count_by_tag(cache, 1) == 0);
+    libcache_destroy(cache);
+}
+
+typedef struct test_session_t {
+    int value;
+    int teid;
+} test_session_t;
+
+TEST(TestSecondaryIndex)
+{
+    void* cache = libcache_create(64, sizeof(test_session_t), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+    int i;
+    for (i = 0; i < 30; i++) {
+        test_session_t session = { i, 1000 + i };
+        CHECK(libcache_add(cache, &i, &session) != NULL);
+    }
+    CHECK(libcache_add_secondary(cache, 6, sizeof(int), test_key_com, test_key_to_int) == -1);
+    int secondary = libcache_add_secondary(cache, offsetof(test_session_t, teid), sizeof(int), test_key_com, test_key_to_int);
+    CHECK(secondary == 0);
+
+    // the entries in the cache are indexed, a put moves an entry to its new key
+    int teid = 1005;
+    test_session_t session;
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) == &session && session.value == 5);
+    i = 5;
+    session.teid = 2005;
+    CHECK(LIBCACHE_SUCCESS == libcache_put(cache, &i, &session, 0));
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) == NULL);
+    teid = 2005;
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) != NULL && session.value == 5);
+
+    // an entry written in place is indexed by libcache_link_secondary
+    i = 40;
+    test_session_t* entry = (test_session_t*) libcache_add(cache, &i, NULL);
+    entry->value = 40;
+    entry->teid = 1040;
+    teid = 1040;
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) == NULL);
+    CHECK(LIBCACHE_SUCCESS == libcache_link_secondary(cache, entry));
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, NULL) == entry);
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(cache, entry));
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(cache, entry));
+
+    // deleting by either key removes the entry from both
+    teid = 1007;
+    CHECK(LIBCACHE_SUCCESS == libcache_delete_by_secondary(cache, secondary, &teid));
+    i = 7;
+    CHECK(libcache_peek(cache, &i, NULL) == NULL);
+    i = 8;
+    CHECK(LIBCACHE_SUCCESS == libcache_delete_by_key(cache, &i));
+    teid = 1008;
+    CHECK(LIBCACHE_NOT_FOUND == libcache_delete_by_secondary(cache, secondary, &teid));
+    CHECK(libcache_lookup_secondary(cache, 1, &teid, NULL) == NULL);
+
+    // swapped out entries leave the index, the index follows a resize both ways
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 500));
+    for (i = 100; i < 600; i++) {
+        test_session_t added = { i, 1000 + i };
+        CHECK(libcache_add(cache, &i, &added) != NULL);
+    }
+    teid = 1000;
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) == NULL);
+    for (i = 100; i < 600; i++) {
+        teid = 1000 + i;
+        CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) != NULL && session.value == i);
+    }
+    libcache_memory_stats_t stats;
+    CHECK(LIBCACHE_SUCCESS == libcache_get_memory_stats(cache, &stats));
+    CHECK(stats.secondary_bytes >= 501 * 8);
+
+    for (i = 100; i < 560; i++) {
+        CHECK(LIBCACHE_SUCCESS == libcache_delete_by_key(cache, &i));
+    }
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 64));
+    while (LIBCACHE_SUCCESS != libcache_resize_step(cache)) {
+    }
+    for (i = 560; i < 600; i++) {
+        teid = 1000 + i;
+        CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) != NULL && session.value == i);
+    }
+
+    CHECK(LIBCACHE_SUCCESS == libcache_clean(cache));
+    teid = 1599;
+    CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) == NULL);
+    libcache_destroy(cache);
+}
+
+TEST(TestSecondaryResizeInSlices)
+{
+    void* cache = libcache_create(1000, sizeof(test_session_t), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+    int secondary = libcache_add_secondary(cache, offsetof(test_session_t, teid), sizeof(int), test_key_com, test_key_to_int);
+    CHECK(secondary == 0);
+    int i;
+    for (i = 0; i <= 1000; i++) {
+        test_session_t session = { i, 5000 + i };
+        CHECK(libcache_add(cache, &i, &session) != NULL);
+    }
+
+    // Note: the secondary index is moved to its larger table in slices, it's searched in both tables meanwhile
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 100000));
+    int steps = 0;
+    do {
+        for (i = steps * 7; i <= 1000; i += 97) {
+            int teid = 5000 + i;
+            test_session_t session;
+            CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) != NULL && session.value == i);
+        }
+        steps++;
+    } while (LIBCACHE_SUCCESS != libcache_resize_step(cache));
+    CHECK(steps > 10);
+
+    for (i = 0; i <= 1000; i++) {
+        int teid = 5000 + i;
+        test_session_t session;
+        CHECK(libcache_lookup_secondary(cache, secondary, &teid, &session) != NULL && session.value == i);
+    }
+    libcache_memory_stats_t stats;
+    CHECK(LIBCACHE_SUCCESS == libcache_get_memory_stats(cache, &stats));
+    CHECK(stats.secondary_bytes >= stats.bucket_bytes);
+    libcache_destroy(cache);
+}
+
+TEST(TestMemoryStats)
+{
+    libcache_memory_stats_t estimate;
+    size_t memory_size = libcache_estimate_memory(100, 64, sizeof(int), NULL, &estimate);
+    CHECK(memory_size == libcache_get_memory_size(100, 64, sizeof(int)));
+    // Note: the bucket table of a cache in caller memory is mapped apart from the block
+    CHECK(estimate.bucket_bytes > 0);
+    CHECK(estimate.total_bytes == memory_size + estimate.bucket_bytes);
+    CHECK(estimate.pools[POOL_TYPE_DATA].capacity == 101);
+    CHECK(estimate.pools[POOL_TYPE_DATA].used == 0);
+    CHECK(estimate.pools[POOL_TYPE_DATA].overhead_ratio > 0 && estimate.pools[POOL_TYPE_DATA].overhead_ratio < 0.5);
+    CHECK(estimate.pools[POOL_TYPE_NODE_T].capacity == 0 && estimate.pools[POOL_TYPE_NODE_T].bytes == sizeof(element_pool_t));
+
+    libcache_memory_options_t options = { TRUE, ARENA_PAGES_DEFAULT, FALSE };
+    CHECK(libcache_estimate_memory(100, 64, sizeof(int), &options, NULL) % 4096 == 0);
+    CHECK(libcache_estimate_memory(100, 64, sizeof(int), &options, NULL) >= memory_size);
+
+    void* cache = libcache_create(100, 64, sizeof(int), malloc, free, NULL, test_key_com, test_key_to_int);
+    char entry[64] = {0};
+    int i;
+    for (i = 0; i < 40; i++) {
+        CHECK(libcache_add(cache, &i, entry) != NULL);
+    }
+    i = 7;
+    CHECK(LIBCACHE_SUCCESS == libcache_delete_by_key(cache, &i));
+
+    libcache_memory_stats_t stats;
+    CHECK(LIBCACHE_SUCCESS == libcache_get_memory_stats(cache, &stats));
+    CHECK(stats.pools[POOL_TYPE_DATA].used == 39);
+    CHECK(stats.pools[POOL_TYPE_DATA].free == 62);
+    CHECK(stats.pools[POOL_TYPE_DATA].element_size == estimate.pools[POOL_TYPE_DATA].element_size);
+    CHECK(stats.total_bytes == estimate.total_bytes);
+    CHECK(stats.bytes_per_entry * 101 == (double) estimate.total_bytes);
+
+    // Note: records and index tables mapped by a resize are counted apart
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 1000));
+    CHECK(LIBCACHE_SUCCESS == libcache_get_memory_stats(cache, &stats));
+    CHECK(stats.chunk_bytes > 900 * 64 && stats.bucket_bytes > 0);
+    CHECK(stats.total_bytes == memory_size + stats.chunk_bytes + stats.bucket_bytes);
+
+    libcache_destroy(cache);
+}
+
+TEST(TestResize)
+{
+    void* cache = libcache_create(64, sizeof(int), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+
+    int i;
+    for (i = 0; i <= 64; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+
+    // Note: growing maps a new chunk, the index is rehashed while entries are added
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 1000));
+    CHECK(libcache_get_max_entry_number(cache) == 1000);
+    for (i = 65; i <= 1000; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    CHECK(libcache_get_entry_number(cache) == 1001);
+    for (i = 0; i <= 1000; i++) {
+        int entry = -1;
+        CHECK(libcache_lookup(cache, &i, &entry) != NULL && entry == i);
+    }
+
+    // Note: a locked entry of the new chunk keeps it mapped until it's unlocked
+    i = 999;
+    void* locked_entry = libcache_lookup(cache, &i, NULL);
+    CHECK(locked_entry != NULL);
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 32));
+    int step;
+    for (step = 0; step < 1000 && LIBCACHE_SUCCESS != libcache_resize_step(cache); step++);
+    CHECK(LIBCACHE_LOCKED == libcache_resize_step(cache));
+    CHECK(LIBCACHE_LOCKED == libcache_resize(cache, 100));
+    CHECK(libcache_get_entry_number(cache) <= 33);
+
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(cache, locked_entry));
+    for (step = 0; step < 1000 && LIBCACHE_SUCCESS != libcache_resize_step(cache); step++);
+    CHECK(LIBCACHE_SUCCESS == libcache_resize_step(cache));
+
+    int found = 0;
+    for (i = 0; i <= 1000; i++) {
+        int entry = -1;
+        if (libcache_peek(cache, &i, &entry) != NULL) {
+            CHECK(entry == i);
+            found++;
+        }
+    }
+    CHECK(found == (int) libcache_get_entry_number(cache));
+    i = 999;
+    CHECK(libcache_peek(cache, &i, NULL) != NULL);
+
+    for (i = 2000; i < 2100; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    CHECK(libcache_get_entry_number(cache) == 33);
+
+    libcache_destroy(cache);
+}
+
+TEST(TestAddAfterShrink)
+{
+    void* cache = libcache_create(64, sizeof(int), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+    int i;
+    for (i = 0; i <= 64; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 1000));
+    for (i = 65; i <= 1000; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    // Note: the entries of chunk 0 are the newest, the ones swapped out first are in the released chunk
+    for (i = 0; i <= 64; i++) {
+        int entry;
+        CHECK(libcache_lookup(cache, &i, &entry) != NULL);
+    }
+
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 64));
+    i = 5000;
+    CHECK(libcache_add(cache, &i, &i) != NULL);
+    i = 5001;
+    CHECK(LIBCACHE_SUCCESS == libcache_put(cache, &i, &i, 0));
+    i = 5002;
+    int inserted = FALSE;
+    void* entry = libcache_get_or_add(cache, &i, &i, &inserted);
+    CHECK(entry != NULL && inserted == TRUE);
+    CHECK(LIBCACHE_SUCCESS == libcache_unlock_entry(cache, entry));
+
+    while (LIBCACHE_SUCCESS != libcache_resize_step(cache)) {
+    }
+    CHECK(libcache_get_entry_number(cache) == 65);
+    libcache_destroy(cache);
+}
+
+TEST(TestCleanDuringResize)
+{
+    void* cache = libcache_create(1000, sizeof(int), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+    int i;
+    for (i = 0; i < 1000; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    for (i = 0; i < 1000; i += 3) {
+        CHECK(LIBCACHE_SUCCESS == libcache_delete_by_key(cache, &i));
+    }
+
+    // Note: the old index isn't rehashed yet, clean must not move the freed records back into the new one
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 100000));
+    CHECK(LIBCACHE_SUCCESS == libcache_clean(cache));
+    CHECK(libcache_get_entry_number(cache) == 0);
+    CHECK(LIBCACHE_SUCCESS == libcache_resize_step(cache));
+
+    libcache_memory_stats_t stats;
+    CHECK(LIBCACHE_SUCCESS == libcache_get_memory_stats(cache, &stats));
+    CHECK(stats.pools[POOL_TYPE_DATA].used == 0 && stats.pools[POOL_TYPE_DATA].free == 1001);
+
+    for (i = 0; i < 2000; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    CHECK(libcache_get_entry_number(cache) == 2000);
+    libcache_destroy(cache);
+}
+
+static void test_scan_count(const void* key, void* entry, void* arg)
+{
+    ((int*) arg)[*(const int*) key]++;
+}
+
+TEST(TestScan)
+{
+    void* cache = libcache_create(64, sizeof(int), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+    static int seen[1000];
+    int i;
+    for (i = 0; i <= 64; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+
+    // the index grows and is rehashed while the scan goes on
+    uint32_t cursor = libcache_scan(cache, 0, 8, test_scan_count, seen);
+    CHECK(cursor != 0);
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 1000));
+    int calls = 1;
+    do {
+        cursor = libcache_scan(cache, cursor, 8, test_scan_count, seen);
+        if (calls == 3) {
+            for (i = 100; i < 900; i++) {
+                CHECK(libcache_add(cache, &i, &i) != NULL);
+            }
+            for (i = 60; i <= 64; i++) {
+                CHECK(LIBCACHE_SUCCESS == libcache_delete_by_key(cache, &i));
+            }
+        }
+        calls++;
+    } while (cursor != 0);
+    CHECK(calls > 10);
+    for (i = 0; i < 60; i++) {
+        CHECK(seen[i] >= 1);
+    }
+
+    // the index shrinks while the scan goes on
+    for (i = 50; i < 900; i++) {
+        libcache_delete_by_key(cache, &i);
+    }
+    memset(seen, 0, sizeof(seen));
+    cursor = libcache_scan(cache, 0, 8, test_scan_count, seen);
+    cursor = libcache_scan(cache, cursor, 8, test_scan_count, seen);
+    CHECK(LIBCACHE_SUCCESS == libcache_resize(cache, 64));
+    while (cursor != 0) {
+        cursor = libcache_scan(cache, cursor, 8, test_scan_count, seen);
+        libcache_resize_step(cache);
+    }
+    int total = 0;
+    for (i = 0; i < 50; i++) {
+        CHECK(seen[i] >= 1);
+        total += seen[i];
+    }
+    CHECK(total < 100);
+    CHECK(libcache_scan(cache, 0, 8, NULL, NULL) == 0);
+
+    libcache_destroy(cache);
+}
+
+TEST(TestCreateOnPages)
+{
+    arena_report_t report;
+    void* cache = libcache_create_on_pages(g_max_entry_number, sizeof(int), sizeof(int),
+            ARENA_PAGES_HUGE_2M, ARENA_PREFAULT, &report, NULL, test_key_com, test_key_to_int);
+    CHECK(cache != NULL);
+    CHECK(report.pages <= ARENA_PAGES_HUGE_2M);
+    CHECK(report.prefaulted);
+
+    int i;
+    for (i = 0; i < (int) g_max_entry_number; i++) {
+        CHECK(libcache_add(cache, &i, &i) != NULL);
+    }
+    int entry = -1;
+    i = 7;
+    CHECK(libcache_lookup(cache, &i, &entry) != NULL && entry == 7);
+
+    CHECK(libcache_destroy(cache) == LIBCACHE_SUCCESS);
+}
+
+TEST(TestSharedAttach)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/libcache_ut_%d", (int) getpid());
+
+    void* cache = libcache_create_shared(name, g_max_entry_number, sizeof(int), sizeof(int),
+            NULL, test_key_com, test_key_to_int);
+    CHECK(cache != NULL);
+    CHECK(libcache_create_shared(name, g_max_entry_number, sizeof(int), sizeof(int),
+            NULL, test_key_com, test_key_to_int) == NULL);
+
+    int i;
+    for (i = 0; i < 10; i++) {
+        int entry = i * 100;
+        CHECK(libcache_add(cache, &i, &entry) != NULL);
+    }
+
+    // Note: a second mapping lands at another address, the offsets still resolve
+    void* cache2 = libcache_attach_shared(name, NULL, test_key_com, test_key_to_int);
+    CHECK(cache2 != NULL);
+    CHECK(cache2 != cache);
+    CHECK_EQUAL(10, (int) libcache_get_entry_number(cache2));
+    CHECK_EQUAL(g_max_entry_number, libcache_get_max_entry_number(cache2));
+    for (i = 0; i < 10; i++) {
+        int entry = -1;
+        CHECK(libcache_lookup(cache2, &i, &entry) != NULL);
+        CHECK_EQUAL(i * 100, entry);
+    }
+
+    // Note: another process adds an entry and leaves
+    pid_t pid = fork();
+    if (pid == 0) {
+        void* child_cache = libcache_attach_shared(name, NULL, test_key_com, test_key_to_int);
+        int key = 1000;
+        int entry = 2000;
+        int ret = (child_cache != NULL && libcache_add(child_cache, &key, &entry) != NULL) ? 0 : 1;
+        libcache_detach_shared(child_cache);
+        _exit(ret);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    int key = 1000;
+    int entry = 0;
+    CHECK(libcache_lookup(cache, &key, &entry) != NULL);
+    CHECK_EQUAL(2000, entry);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_detach_shared(cache2));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_destroy(cache));
+    CHECK(libcache_attach_shared(name, NULL, test_key_com, test_key_to_int) == NULL);
+}
+
+TEST(TestSharedReattach)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/libcache_ut_re_%d", (int) getpid());
+
+    void* cache = libcache_create_shared(name, g_max_entry_number, sizeof(int), sizeof(int),
+            NULL, test_key_com, test_key_to_int);
+    CHECK(cache != NULL);
+    int key = 7;
+    int entry = 700;
+    CHECK(libcache_add(cache, &key, &entry) != NULL);
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_detach_shared(cache));
+
+    // Note: nobody is attached, so a restarted worker may rebind callbacks
+    cache = libcache_attach_shared(name, NULL, test_key_com, test_key_to_int);
+    CHECK(cache != NULL);
+    entry = 0;
+    CHECK(libcache_lookup(cache, &key, &entry) != NULL);
+    CHECK_EQUAL(700, entry);
+
+    // Note: a process that dies attached leaves nothing behind in the segment
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(NULL != libcache_attach_shared(name, NULL, test_key_com, test_key_to_int) ? 0 : 1);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // Note: each handle keeps the callbacks of its own, another binding doesn't disturb this one
+    void* cache2 = libcache_attach_shared(name, NULL, test_key_com, test_key_to_int_other);
+    CHECK(cache2 != NULL);
+    key = 8;
+    entry = 800;
+    CHECK(libcache_add(cache2, &key, &entry) != NULL);
+    entry = 0;
+    CHECK(libcache_lookup(cache2, &key, &entry) != NULL);
+    CHECK(entry == 800);
+    key = 7;
+    entry = 0;
+    CHECK(libcache_lookup(cache, &key, &entry) != NULL);
+    CHECK(entry == 700);
+    CHECK(LIBCACHE_SUCCESS == libcache_detach_shared(cache2));
+
+    void* private_cache = libcache_create(10, sizeof(int), sizeof(int), malloc, free, NULL,
+            test_key_com, test_key_to_int);
+    CHECK_EQUAL(LIBCACHE_FAILURE, libcache_detach_shared(private_cache));
+    libcache_destroy(private_cache);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libcache_destroy(cache));
+}
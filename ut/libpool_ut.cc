@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "UnitTest++.h"
 #include "list.h"
@@ -89,3 +90,376 @@ TEST(libpool_ut_get_element)
     free(pools);
 }
 
+
+TEST(libpool_ut_lazy_elements)
+{
+    size_t element_size = 4;
+    const int entry_count = 25;
+
+    pool_attr_t pool_attr[] = {{element_size, entry_count}};
+    const int pool_count = sizeof(pool_attr) / sizeof(pool_attr_t);
+    size_t large_mem_size = pool_caculate_total_length(pool_count, pool_attr);
+    void* large_mem = malloc(large_mem_size);
+    CHECK(large_mem != NULL);
+
+    void *pools = pools_init(large_mem, large_mem_size, pool_count, pool_attr);
+    CHECK(pools != NULL);
+    element_pool_t* pool = (element_pool_t*) offset_ptr_get((offset_ptr_t*) pools + TEST_POOL_TYPE_DATA);
+    CHECK(pool->element_used == 0);
+
+    void * entry_stack[entry_count];
+    int i;
+    for (i = 0; i < entry_count; i++) {
+        entry_stack[i] = pool_get_element(pools, TEST_POOL_TYPE_DATA);
+        CHECK(entry_stack[i] != NULL);
+        CHECK(pool->element_used == i + 1);
+    }
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == NULL);
+
+    pool_free_element(pools, TEST_POOL_TYPE_DATA, entry_stack[3]);
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == entry_stack[3]);
+    CHECK(pool->element_used == entry_count);
+
+    free(pools);
+}
+
+TEST(libpool_ut_intrusive_free_list)
+{
+    const int entry_count = 16;
+
+    pool_attr_t pool_attr[] = {{sizeof(long long), entry_count, TRUE}, {sizeof(long long), entry_count, FALSE}};
+    size_t large_mem_size = pool_caculate_total_length(TEST_POOL_TYPE_MAX, pool_attr);
+#ifndef LIBPOOL_MAGIC_CHECK
+    // Note: only the reserved pool pays a pointer per element, nothing else is kept besides the entries
+    CHECK(large_mem_size == sizeof(offset_ptr_t) * TEST_POOL_TYPE_MAX + sizeof(element_pool_t) * TEST_POOL_TYPE_MAX
+            + entry_count * (sizeof(offset_ptr_t) + sizeof(long long)) + entry_count * sizeof(long long));
+#endif
+    void* large_mem = malloc(large_mem_size);
+    void *pools = pools_init(large_mem, large_mem_size, TEST_POOL_TYPE_MAX, pool_attr);
+    CHECK(pools != NULL);
+
+    long long* first = (long long*) pool_get_element(pools, TEST_POOL_TYPE_DATA);
+    long long* second = (long long*) pool_get_element(pools, TEST_POOL_TYPE_DATA);
+    CHECK(first != NULL && second != NULL && first != second);
+    CHECK(pool_get_reserved_pointer(first) == NULL);
+    CHECK(pool_set_reserved_pointer(first, second) == OK);
+    CHECK(pool_get_reserved_pointer(first) == second);
+
+    pool_free_element(pools, TEST_POOL_TYPE_DATA, second);
+    pool_free_element(pools, TEST_POOL_TYPE_DATA, first);
+    CHECK(pool_get_reserved_pointer(first) == NULL);
+
+    // Note: the last element given back is taken first
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == first);
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == second);
+
+    void * entry_stack[entry_count];
+    int i;
+    for (i = 0; i < entry_count; i++) {
+        entry_stack[i] = pool_get_element(pools, TEST_POOL_TYPE_2ND);
+        CHECK(entry_stack[i] != NULL);
+        *(long long*) entry_stack[i] = i;
+    }
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_2ND) == NULL);
+    for (i = 0; i < entry_count; i++) {
+        pool_free_element(pools, TEST_POOL_TYPE_2ND, entry_stack[i]);
+    }
+    for (i = entry_count - 1; i >= 0; i--) {
+        CHECK(pool_get_element(pools, TEST_POOL_TYPE_2ND) == entry_stack[i]);
+    }
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_2ND) == NULL);
+
+    free(pools);
+}
+
+TEST(libpool_ut_stats)
+{
+    pool_attr_t pool_attr[] = {{20, 10}, {8, 0}};
+    size_t large_mem_size = pool_caculate_total_length(TEST_POOL_TYPE_MAX, pool_attr);
+    CHECK(large_mem_size == sizeof(offset_ptr_t) * TEST_POOL_TYPE_MAX
+            + pool_caculate_length(&pool_attr[0]) + pool_caculate_length(&pool_attr[1]));
+    void* large_mem = malloc(large_mem_size);
+    void *pools = pools_init(large_mem, large_mem_size, TEST_POOL_TYPE_MAX, pool_attr);
+
+    void* elements[4];
+    int i;
+    for (i = 0; i < 4; i++) {
+        elements[i] = pool_get_element(pools, TEST_POOL_TYPE_DATA);
+    }
+    pool_free_element(pools, TEST_POOL_TYPE_DATA, elements[1]);
+
+    pool_stats_t stats;
+    pool_get_stats(pools, TEST_POOL_TYPE_DATA, &stats);
+    CHECK(stats.element_size == pool_caculate_element_length(&pool_attr[0]));
+    CHECK(stats.capacity == 10 && stats.used == 3 && stats.touched == 4);
+    CHECK(stats.bytes <= pool_caculate_length(&pool_attr[0]));
+    CHECK(stats.bytes >= stats.element_size * 10);
+
+    pool_get_stats(pools, TEST_POOL_TYPE_2ND, &stats);
+    CHECK(stats.capacity == 0 && stats.used == 0);
+
+    free(large_mem);
+}
+
+TEST(libpool_ut_free_elements)
+{
+    pool_attr_t pool_attr[] = {{20, 10}, {8, 0}};
+    size_t large_mem_size = pool_caculate_total_length(TEST_POOL_TYPE_MAX, pool_attr);
+    void* large_mem = malloc(large_mem_size);
+    void *pools = pools_init(large_mem, large_mem_size, TEST_POOL_TYPE_MAX, pool_attr);
+
+    void* elements[10];
+    int i;
+    for (i = 0; i < 10; i++) {
+        elements[i] = pool_get_element(pools, TEST_POOL_TYPE_DATA);
+    }
+    pool_free_element(pools, TEST_POOL_TYPE_DATA, elements[9]);
+    pool_free_elements(pools, TEST_POOL_TYPE_DATA, elements + 2, 5);
+
+    pool_stats_t stats;
+    pool_get_stats(pools, TEST_POOL_TYPE_DATA, &stats);
+    CHECK(stats.used == 4);
+
+    // Note: the chain is taken in order, then the element freed before it
+    for (i = 2; i < 7; i++) {
+        CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == elements[i]);
+    }
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == elements[9]);
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == NULL);
+
+    free(large_mem);
+}
+
+TEST(libpool_ut_aligned_elements)
+{
+    const int entry_count = 8;
+
+    pool_attr_t pool_attr[] = {{40, entry_count, TRUE, 64}, {20, entry_count, FALSE, 16}};
+    size_t large_mem_size = pool_caculate_total_length(TEST_POOL_TYPE_MAX, pool_attr);
+
+    // Note: pools are laid out at an address which is 8 bytes aligned only
+    char* large_mem = (char*) malloc(large_mem_size + 64);
+    char* memory = large_mem + 64 - ((uintptr_t) large_mem % 64) + 8;
+    void *pools = pools_init(memory, large_mem_size, TEST_POOL_TYPE_MAX, pool_attr);
+    CHECK(pools != NULL);
+
+    int i;
+    for (i = 0; i < entry_count; i++) {
+        char* entry = (char*) pool_get_element(pools, TEST_POOL_TYPE_DATA);
+        CHECK(entry != NULL);
+        CHECK((uintptr_t) entry % 64 == 0);
+        CHECK(entry + 40 <= memory + large_mem_size);
+        CHECK(pool_get_reserved_pointer(entry) == NULL);
+
+        entry = (char*) pool_get_element(pools, TEST_POOL_TYPE_2ND);
+        CHECK(entry != NULL);
+        CHECK((uintptr_t) entry % 16 == 0);
+        CHECK(entry + 20 <= memory + large_mem_size);
+    }
+
+    free(large_mem);
+}
+
+#define TEST_MAGAZINE_THREADS  (4)
+#define TEST_MAGAZINE_ELEMENTS (256)
+#define TEST_MAGAZINE_HELD     (40)
+
+struct test_magazine_args_t {
+    void* pools;
+    long long id;
+    int failures;
+};
+
+static void* test_magazine_worker(void* arg)
+{
+    test_magazine_args_t* args = (test_magazine_args_t*) arg;
+    long long* held[TEST_MAGAZINE_HELD];
+    int round;
+    for (round = 0; round < 2000; round++) {
+        int count = round % TEST_MAGAZINE_HELD + 1;
+        int i;
+        for (i = 0; i < count; i++) {
+            held[i] = (long long*) pool_magazine_get_element(args->pools, TEST_POOL_TYPE_DATA);
+            if (held[i] == NULL) {
+                args->failures++;
+                count = i;
+                break;
+            }
+            *held[i] = args->id;
+        }
+        // Note: an element handed to two threads at once is overwritten by the other one
+        for (i = 0; i < count; i++) {
+            if (*held[i] != args->id) {
+                args->failures++;
+            }
+            pool_magazine_free_element(args->pools, TEST_POOL_TYPE_DATA, held[i]);
+        }
+    }
+    pool_magazine_flush(args->pools, TEST_POOL_TYPE_DATA);
+    return NULL;
+}
+
+TEST(libpool_ut_magazines)
+{
+    pool_attr_t pool_attr[] = {{sizeof(long long), TEST_MAGAZINE_ELEMENTS}};
+    size_t large_mem_size = pool_caculate_total_length(1, pool_attr);
+    void* large_mem = malloc(large_mem_size);
+    void *pools = pools_init(large_mem, large_mem_size, 1, pool_attr);
+    CHECK(pools != NULL);
+
+    // Note: a freed element stays in the magazine of this thread, it's taken again first
+    void* element = pool_magazine_get_element(pools, TEST_POOL_TYPE_DATA);
+    CHECK(element != NULL);
+    pool_magazine_free_element(pools, TEST_POOL_TYPE_DATA, element);
+    CHECK(pool_magazine_get_element(pools, TEST_POOL_TYPE_DATA) == element);
+    pool_magazine_free_element(pools, TEST_POOL_TYPE_DATA, element);
+    pool_magazine_flush(pools, TEST_POOL_TYPE_DATA);
+
+    pthread_t threads[TEST_MAGAZINE_THREADS];
+    test_magazine_args_t args[TEST_MAGAZINE_THREADS];
+    int i;
+    for (i = 0; i < TEST_MAGAZINE_THREADS; i++) {
+        args[i].pools = pools;
+        args[i].id = i + 1;
+        args[i].failures = 0;
+        pthread_create(&threads[i], NULL, test_magazine_worker, &args[i]);
+    }
+    for (i = 0; i < TEST_MAGAZINE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(args[i].failures == 0);
+    }
+
+    // Note: all magazines were flushed, every element is in the depot once
+    for (i = 0; i < TEST_MAGAZINE_ELEMENTS; i++) {
+        CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) != NULL);
+    }
+    CHECK(pool_get_element(pools, TEST_POOL_TYPE_DATA) == NULL);
+
+    free(large_mem);
+}
+
+struct test_depot_args_t {
+    void* pools;
+    long long** elements;
+    int count;
+};
+
+static void* test_depot_free_worker(void* arg)
+{
+    test_depot_args_t* args = (test_depot_args_t*) arg;
+    int i;
+    for (i = 0; i < args->count; i++) {
+        pool_magazine_free_element(args->pools, TEST_POOL_TYPE_DATA, args->elements[i]);
+    }
+    pool_magazine_flush(args->pools, TEST_POOL_TYPE_DATA);
+    return NULL;
+}
+
+TEST(libpool_ut_depot_cross_thread_free)
+{
+    pool_attr_t pool_attr[] = {{sizeof(long long), TEST_MAGAZINE_ELEMENTS}};
+    size_t large_mem_size = pool_caculate_total_length(1, pool_attr);
+    void* large_mem = malloc(large_mem_size);
+    void *pools = pools_init(large_mem, large_mem_size, 1, pool_attr);
+
+    long long* elements[TEST_MAGAZINE_ELEMENTS];
+    int i;
+    for (i = 0; i < TEST_MAGAZINE_ELEMENTS; i++) {
+        elements[i] = (long long*) pool_magazine_get_element(pools, TEST_POOL_TYPE_DATA);
+        CHECK(elements[i] != NULL);
+    }
+    CHECK(pool_magazine_get_element(pools, TEST_POOL_TYPE_DATA) == NULL);
+
+    // Note: other threads give the elements back, they are pushed to the depot without a lock
+    pthread_t threads[TEST_MAGAZINE_THREADS];
+    test_depot_args_t args[TEST_MAGAZINE_THREADS];
+    const int share = TEST_MAGAZINE_ELEMENTS / TEST_MAGAZINE_THREADS;
+    for (i = 0; i < TEST_MAGAZINE_THREADS; i++) {
+        args[i].pools = pools;
+        args[i].elements = elements + share * i;
+        args[i].count = share;
+        pthread_create(&threads[i], NULL, test_depot_free_worker, &args[i]);
+    }
+    for (i = 0; i < TEST_MAGAZINE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i < TEST_MAGAZINE_ELEMENTS; i++) {
+        long long* element = (long long*) pool_magazine_get_element(pools, TEST_POOL_TYPE_DATA);
+        CHECK(element != NULL);
+        *element = i;
+    }
+    CHECK(pool_magazine_get_element(pools, TEST_POOL_TYPE_DATA) == NULL);
+
+    // Note: each element was handed out once, so it holds the value written for it
+    char seen[TEST_MAGAZINE_ELEMENTS] = {0};
+    int distinct = 0;
+    for (i = 0; i < TEST_MAGAZINE_ELEMENTS; i++) {
+        long long value = *elements[i];
+        if (value >= 0 && value < TEST_MAGAZINE_ELEMENTS && !seen[value]) {
+            seen[value] = 1;
+            distinct++;
+        }
+    }
+    CHECK(distinct == TEST_MAGAZINE_ELEMENTS);
+    pool_magazine_flush(pools, TEST_POOL_TYPE_DATA);
+
+    free(large_mem);
+}
+
+TEST(libpool_ut_size_classes)
+{
+    const libcache_scale_t class_acount[POOL_CLASS_COUNT] = {4, 4, 2, 2, 2, 2, 2, 2, 1};
+    size_t memory_size = pool_classes_caculate_length(class_acount);
+    void* memory = malloc(memory_size);
+    CHECK(pool_classes_init(memory, memory_size - 1, class_acount) == NULL);
+    void* classes = pool_classes_init(memory, memory_size, class_acount);
+    CHECK(classes != NULL);
+
+    char* small = (char*) pool_alloc(classes, 1);
+    char* apn = (char*) pool_alloc(classes, 63);
+    char* blob = (char*) pool_alloc(classes, 4096);
+    CHECK(small != NULL && apn != NULL && blob != NULL);
+    CHECK((uintptr_t) apn % 16 == 0 && (uintptr_t) blob % 16 == 0);
+    memset(apn, 'a', 63);
+    memset(blob, 'b', 4096);
+    CHECK(pool_alloc(classes, 4097) == NULL);
+
+    pool_class_stats_t stats[POOL_CLASS_COUNT];
+    pool_get_class_stats(classes, stats);
+    CHECK(stats[0].entry_size == 16 && stats[0].in_use == 1);
+    CHECK(stats[2].entry_size == 64 && stats[2].in_use == 1);
+    CHECK(stats[8].entry_size == 4096 && stats[8].in_use == 1 && stats[8].capacity == 1);
+
+    // Note: the 4096 class is full and there is no larger one to spill into
+    CHECK(pool_alloc(classes, 3000) == NULL);
+    pool_get_class_stats(classes, stats);
+    CHECK(stats[8].failures == 1);
+
+    pool_free(classes, blob);
+    pool_free(classes, apn);
+    pool_free(classes, small);
+    pool_get_class_stats(classes, stats);
+    CHECK(stats[0].in_use == 0 && stats[0].peak == 1);
+    CHECK(stats[2].in_use == 0 && stats[8].in_use == 0);
+
+    // Note: freed memory goes back to its own class
+    CHECK(pool_alloc(classes, 4000) == blob);
+    CHECK(pool_alloc(classes, 50) == apn);
+    CHECK(pool_alloc(classes, 16) == small);
+
+    // Note: the 16 class is full after three more, the fourth spills into the 32 class
+    void* spilled[4];
+    int i;
+    for (i = 0; i < 4; i++) {
+        spilled[i] = pool_alloc(classes, 10);
+        CHECK(spilled[i] != NULL);
+    }
+    pool_get_class_stats(classes, stats);
+    CHECK(stats[0].in_use == 4 && stats[1].in_use == 1);
+    pool_free(classes, spilled[3]);
+    pool_get_class_stats(classes, stats);
+    CHECK(stats[1].in_use == 0);
+
+    free(memory);
+}
@@ -0,0 +1,589 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "UnitTest++.h"
+
+extern "C" {
+
+#include "libshard.h"
+#include "libcache_def.h"
+
+static uint32_t test_key_to_int(const void* key)
+{
+    uint32_t* value = (uint32_t*) key;
+    return *value;
+}
+
+static libcache_cmp_ret_t test_key_com(const void* key1, const void* key2)
+{
+    uint32_t* a = (uint32_t*) key1;
+    uint32_t* b = (uint32_t*) key2;
+
+    return (*a == *b) ? LIBCACHE_EQU : LIBCACHE_NOT_EQU;
+}
+
+}
+
+#define TEST_SHARD_COUNT     (4)
+#define TEST_SHARD_ENTRIES   (1000)
+#define TEST_THREAD_COUNT    (4)
+
+struct LibShardFixture {
+    void* shards;
+    LibShardFixture()
+    {
+        libshard_attr_t attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.shard_count = TEST_SHARD_COUNT;
+        attr.max_entry_number = TEST_SHARD_ENTRIES;
+        attr.entry_size = sizeof(int);
+        attr.key_size = sizeof(int);
+        attr.cmp_key = test_key_com;
+        attr.key_to_number = test_key_to_int;
+        attr.numa_node_count = 2;
+        shards = libshard_create(&attr);
+    }
+    ~LibShardFixture()
+    {
+        libshard_destroy(shards);
+    }
+};
+
+TEST_FIXTURE(LibShardFixture, TestShardPlacement)
+{
+    CHECK(shards != NULL);
+    CHECK_EQUAL(TEST_SHARD_COUNT, libshard_get_shard_count(shards));
+    CHECK_EQUAL(FALSE, libshard_is_owner_mode(shards));
+
+    int i;
+    for (i = 0; i < TEST_SHARD_COUNT; i++) {
+        libshard_shard_info_t info;
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_get_shard_info(shards, i, &info));
+        CHECK_EQUAL(i % 2, info.numa_node);
+        CHECK_EQUAL(TEST_SHARD_ENTRIES, (int) info.max_entry_number);
+    }
+
+    libshard_shard_info_t info;
+    CHECK_EQUAL(LIBCACHE_NOT_FOUND, libshard_get_shard_info(shards, TEST_SHARD_COUNT, &info));
+}
+
+TEST_FIXTURE(LibShardFixture, TestShardOperations)
+{
+    int i;
+    for (i = 0; i < 100; i++) {
+        int entry = i * 10;
+        CHECK(libshard_add(shards, &i, &entry) != NULL);
+        CHECK_EQUAL(i % TEST_SHARD_COUNT, libshard_route(shards, &i));
+    }
+    CHECK_EQUAL(100, (int) libshard_get_entry_number(shards));
+
+    libshard_shard_info_t info;
+    libshard_get_shard_info(shards, 1, &info);
+    CHECK_EQUAL(25, (int) info.entry_number);
+
+    int key = 42;
+    int entry = 0;
+    CHECK(libshard_lookup(shards, &key, &entry) != NULL);
+    CHECK_EQUAL(420, entry);
+
+    int* locked = (int*) libshard_lookup(shards, &key, NULL);
+    CHECK(locked != NULL);
+    CHECK_EQUAL(LIBCACHE_LOCKED, libshard_delete_by_key(shards, &key));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_unlock_entry(shards, locked));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_delete_entry(shards, locked));
+    CHECK_EQUAL(LIBCACHE_NOT_FOUND, libshard_delete_by_key(shards, &key));
+    CHECK_EQUAL(LIBCACHE_NOT_FOUND, libshard_unlock_entry(shards, &entry));
+
+    int inserted = FALSE;
+    locked = (int*) libshard_get_or_add(shards, &key, &entry, &inserted);
+    CHECK(locked != NULL && inserted == TRUE);
+    CHECK(libshard_get_or_add(shards, &key, NULL, &inserted) == locked && inserted == FALSE);
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_unlock_entry(shards, locked));
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_unlock_entry(shards, locked));
+    entry = 5;
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_put(shards, &key, &entry, LIBCACHE_PUT_REPLACE));
+    CHECK_EQUAL(5, *locked);
+
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_clean(shards));
+    CHECK_EQUAL(0, (int) libshard_get_entry_number(shards));
+}
+
+TEST(TestShardPages)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = 2;
+    attr.max_entry_number = TEST_SHARD_ENTRIES;
+    attr.entry_size = sizeof(int);
+    attr.key_size = sizeof(int);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.pages = ARENA_PAGES_THP;
+    attr.populate = ARENA_PREFAULT;
+    void* shards = libshard_create(&attr);
+    CHECK(shards != NULL);
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        libshard_shard_info_t info;
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_get_shard_info(shards, i, &info));
+        CHECK(info.memory.pages <= ARENA_PAGES_THP);
+        CHECK((info.memory.pages == ARENA_PAGES_THP) == (info.memory.reason == NULL));
+        CHECK(info.memory.prefaulted);
+    }
+
+    int key = 5;
+    int entry = 50;
+    CHECK(libshard_add(shards, &key, &entry) != NULL);
+    entry = 0;
+    CHECK(libshard_lookup(shards, &key, &entry) != NULL);
+    CHECK_EQUAL(50, entry);
+
+    libshard_destroy(shards);
+}
+
+TEST(TestShardLocalRoute)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = TEST_SHARD_COUNT;
+    attr.max_entry_number = TEST_SHARD_ENTRIES;
+    attr.entry_size = sizeof(int);
+    attr.key_size = sizeof(int);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.numa_node_count = 2;
+    attr.route = LIBSHARD_ROUTE_LOCAL_NODE;
+    void* shards = libshard_create(&attr);
+    CHECK(shards != NULL);
+
+    int i;
+    libshard_bind_thread(1);
+    for (i = 0; i < 10; i++) {
+        CHECK_EQUAL(1, libshard_route(shards, &i) % 2);
+        CHECK(libshard_add(shards, &i, &i) != NULL);
+    }
+    libshard_bind_thread(0);
+    for (i = 10; i < 20; i++) {
+        CHECK_EQUAL(0, libshard_route(shards, &i) % 2);
+        CHECK(libshard_add(shards, &i, &i) != NULL);
+    }
+
+    libshard_shard_info_t info0, info1, info2, info3;
+    libshard_get_shard_info(shards, 0, &info0);
+    libshard_get_shard_info(shards, 1, &info1);
+    libshard_get_shard_info(shards, 2, &info2);
+    libshard_get_shard_info(shards, 3, &info3);
+    CHECK_EQUAL(10, (int) (info0.entry_number + info2.entry_number));
+    CHECK_EQUAL(10, (int) (info1.entry_number + info3.entry_number));
+
+    libshard_bind_thread(-1);
+    libshard_destroy(shards);
+}
+
+TEST(TestShardDeferredPromotion)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = 1;
+    attr.max_entry_number = TEST_SHARD_ENTRIES;
+    attr.entry_size = sizeof(int);
+    attr.key_size = sizeof(int);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.numa_node_count = 1;
+    attr.deferred_promotion = TRUE;
+    void* shards = libshard_create(&attr);
+    CHECK(shards != NULL);
+
+    int i;
+    for (i = 0; i <= TEST_SHARD_ENTRIES; i++) {
+        CHECK(libshard_add(shards, &i, &i) != NULL);
+    }
+
+    // the oldest entries are hit, the hits are applied before the next add evicts
+    int entry = -1;
+    for (i = 0; i < 4; i++) {
+        CHECK(libshard_lookup(shards, &i, &entry) == &entry);
+        CHECK_EQUAL(i, entry);
+    }
+    for (i = TEST_SHARD_ENTRIES + 1; i < TEST_SHARD_ENTRIES + 5; i++) {
+        CHECK(libshard_add(shards, &i, &i) != NULL);
+    }
+    for (i = 0; i < 4; i++) {
+        CHECK(libshard_lookup(shards, &i, &entry) != NULL);
+    }
+    for (i = 4; i < 8; i++) {
+        CHECK(libshard_lookup(shards, &i, &entry) == NULL);
+    }
+
+    // more hits than the buffer holds are drained by the readers or dropped
+    for (i = 0; i < 10 * TEST_SHARD_ENTRIES; i++) {
+        int key = i % TEST_SHARD_ENTRIES;
+        libshard_lookup(shards, &key, &entry);
+    }
+    CHECK_EQUAL(TEST_SHARD_ENTRIES + 1, (int) libshard_get_entry_number(shards));
+
+    libshard_destroy(shards);
+}
+
+static void* test_shard_worker(void* arg)
+{
+    void* shards = ((void**) arg)[0];
+    long base = (long) ((void**) arg)[1];
+    long failures = 0;
+    int i;
+    for (i = 0; i < TEST_SHARD_ENTRIES / 2; i++) {
+        int key = (int) base + i;
+        int entry = key;
+        if (libshard_add(shards, &key, &entry) == NULL) {
+            failures++;
+        }
+        entry = -1;
+        if (libshard_lookup(shards, &key, &entry) == NULL || entry != key) {
+            failures++;
+        }
+    }
+    return (void*) failures;
+}
+
+static void test_shard_run_workers(void* shards)
+{
+    pthread_t threads[TEST_THREAD_COUNT];
+    void* args[TEST_THREAD_COUNT][2];
+    int i;
+    for (i = 0; i < TEST_THREAD_COUNT; i++) {
+        args[i][0] = shards;
+        args[i][1] = (void*) (long) (i * TEST_SHARD_ENTRIES);
+        pthread_create(&threads[i], NULL, test_shard_worker, args[i]);
+    }
+    for (i = 0; i < TEST_THREAD_COUNT; i++) {
+        void* failures = NULL;
+        pthread_join(threads[i], &failures);
+        CHECK(failures == NULL);
+    }
+    CHECK_EQUAL(TEST_THREAD_COUNT * TEST_SHARD_ENTRIES / 2, (int) libshard_get_entry_number(shards));
+}
+
+TEST_FIXTURE(LibShardFixture, TestShardThreads)
+{
+    test_shard_run_workers(shards);
+}
+
+TEST(TestShardDeferredThreads)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = TEST_SHARD_COUNT;
+    attr.max_entry_number = TEST_SHARD_ENTRIES;
+    attr.entry_size = sizeof(int);
+    attr.key_size = sizeof(int);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.numa_node_count = 2;
+    attr.deferred_promotion = TRUE;
+    void* shards = libshard_create(&attr);
+    CHECK(shards != NULL);
+
+    test_shard_run_workers(shards);
+
+    libshard_destroy(shards);
+}
+
+#define TEST_HOT_THRESHOLD   (8)
+#define TEST_HOT_WINDOW      (64)
+#define TEST_HOT_KEY         (5)
+
+static void* test_hot_create(void)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = TEST_SHARD_COUNT;
+    attr.max_entry_number = TEST_SHARD_ENTRIES;
+    attr.entry_size = 2 * sizeof(int);
+    attr.key_size = sizeof(int);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.numa_node_count = 2;
+    attr.hot_threshold = TEST_HOT_THRESHOLD;
+    attr.hot_window = TEST_HOT_WINDOW;
+    return libshard_create(&attr);
+}
+
+static int test_hot_replicas(void* shards)
+{
+    libshard_shard_info_t info;
+    libshard_get_shard_info(shards, TEST_HOT_KEY % TEST_SHARD_COUNT, &info);
+    return info.replica_number;
+}
+
+/* lookups of the other keys of the shard of the hot key, none of them gets hot */
+static void test_hot_other_lookups(void* shards, int first, int count)
+{
+    int i;
+    for (i = first; i < first + count; i++) {
+        int key = TEST_HOT_KEY + TEST_SHARD_COUNT * (1 + i % 20);
+        int entry[2];
+        libshard_lookup(shards, &key, entry);
+    }
+}
+
+TEST(TestShardHotKeys)
+{
+    void* shards = test_hot_create();
+    CHECK(shards != NULL);
+
+    int i;
+    int entry[2];
+    for (i = 0; i < 100; i++) {
+        entry[0] = entry[1] = i;
+        CHECK(libshard_add(shards, &i, entry) != NULL);
+    }
+
+    // a key looked up hot_threshold times gets a replica on each node
+    int key = TEST_HOT_KEY;
+    for (i = 0; i < TEST_HOT_THRESHOLD - 1; i++) {
+        CHECK(libshard_lookup(shards, &key, entry) != NULL);
+    }
+    CHECK_EQUAL(0, test_hot_replicas(shards));
+    CHECK(libshard_lookup(shards, &key, entry) != NULL);
+    CHECK_EQUAL(2, test_hot_replicas(shards));
+    entry[0] = -1;
+    CHECK(libshard_lookup(shards, &key, entry) == entry);
+    CHECK_EQUAL(TEST_HOT_KEY, entry[0]);
+
+    // writes drop the replicas
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_delete_by_key(shards, &key));
+    CHECK_EQUAL(0, test_hot_replicas(shards));
+    CHECK(libshard_lookup(shards, &key, entry) == NULL);
+
+    entry[0] = entry[1] = 500;
+    CHECK(libshard_add(shards, &key, entry) != NULL);
+    for (i = 0; i < TEST_HOT_THRESHOLD; i++) {
+        libshard_lookup(shards, &key, entry);
+    }
+    CHECK_EQUAL(2, test_hot_replicas(shards));
+
+    int* locked = (int*) libshard_lookup(shards, &key, NULL);
+    CHECK(locked != NULL);
+    CHECK_EQUAL(0, test_hot_replicas(shards));
+    locked[0] = locked[1] = 501;
+    CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_unlock_entry(shards, locked));
+    CHECK(libshard_lookup(shards, &key, entry) != NULL);
+    CHECK_EQUAL(501, entry[0]);
+
+    // a replica in use stays over windows, a cool one is torn down
+    libshard_bind_thread(0);
+    for (i = 0; i < TEST_HOT_THRESHOLD; i++) {
+        libshard_lookup(shards, &key, entry);
+    }
+    CHECK_EQUAL(2, test_hot_replicas(shards));
+    for (i = 0; i < TEST_HOT_WINDOW; i++) {
+        CHECK(libshard_lookup(shards, &key, entry) != NULL);
+        CHECK_EQUAL(501, entry[1]);
+        test_hot_other_lookups(shards, i, 1);
+    }
+    CHECK(test_hot_replicas(shards) >= 1);
+
+    test_hot_other_lookups(shards, 0, 2 * TEST_HOT_WINDOW);
+    CHECK_EQUAL(0, test_hot_replicas(shards));
+    CHECK(libshard_lookup(shards, &key, entry) != NULL);
+    CHECK_EQUAL(501, entry[0]);
+
+    libshard_bind_thread(-1);
+    libshard_destroy(shards);
+}
+
+static volatile int g_hot_stop = FALSE;
+
+static void* test_hot_reader(void* arg)
+{
+    void* shards = arg;
+    long failures = 0;
+    int key = TEST_HOT_KEY;
+    while (!g_hot_stop) {
+        int entry[2];
+        if (libshard_lookup(shards, &key, entry) != NULL && entry[0] != entry[1]) {
+            failures++;
+        }
+    }
+    return (void*) failures;
+}
+
+TEST(TestShardHotKeyThreads)
+{
+    void* shards = test_hot_create();
+    CHECK(shards != NULL);
+
+    int key = TEST_HOT_KEY;
+    int entry[2] = { 0, 0 };
+    CHECK(libshard_add(shards, &key, entry) != NULL);
+
+    g_hot_stop = FALSE;
+    pthread_t readers[TEST_THREAD_COUNT];
+    int i;
+    for (i = 0; i < TEST_THREAD_COUNT; i++) {
+        pthread_create(&readers[i], NULL, test_hot_reader, shards);
+    }
+
+    // the readers never see a half written replica
+    for (i = 1; i < 2000; i++) {
+        int* locked = (int*) libshard_lookup(shards, &key, NULL);
+        locked[0] = i;
+        locked[1] = i;
+        libshard_unlock_entry(shards, locked);
+        if (i % 100 == 0) {
+            CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_delete_by_key(shards, &key));
+            entry[0] = entry[1] = i;
+            CHECK(libshard_add(shards, &key, entry) != NULL);
+        }
+    }
+
+    g_hot_stop = TRUE;
+    for (i = 0; i < TEST_THREAD_COUNT; i++) {
+        void* failures = NULL;
+        pthread_join(readers[i], &failures);
+        CHECK(failures == NULL);
+    }
+    libshard_destroy(shards);
+}
+
+static volatile int g_owner_stop = FALSE;
+
+static void* test_shard_owner(void* arg)
+{
+    void* shards = ((void**) arg)[0];
+    int shard_index = (int) (long) ((void**) arg)[1];
+    while (!g_owner_stop) {
+        if (libshard_owner_poll(shards, shard_index, 32) == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_shard_wait(libshard_request_t* requests, int count)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        while (!libshard_request_done(&requests[i])) {
+            sched_yield();
+        }
+    }
+}
+
+static void test_shard_submit(void* shards, libshard_request_t* request)
+{
+    while (libshard_submit(shards, request) == LIBCACHE_FULL) {
+        sched_yield();
+    }
+}
+
+static void* test_shard_client(void* arg)
+{
+    void* shards = ((void**) arg)[0];
+    int base = (int) (long) ((void**) arg)[1];
+    const int count = 200;
+    int keys[count];
+    int entries[count];
+    libshard_request_t requests[count];
+    long failures = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        keys[i] = base + i;
+        entries[i] = keys[i] * 2;
+        requests[i].op = LIBSHARD_OP_ADD;
+        requests[i].key = &keys[i];
+        requests[i].entry = &entries[i];
+        test_shard_submit(shards, &requests[i]);
+    }
+    test_shard_wait(requests, count);
+    for (i = 0; i < count; i++) {
+        failures += (requests[i].result != LIBCACHE_SUCCESS);
+        entries[i] = -1;
+        requests[i].op = LIBSHARD_OP_LOOKUP;
+        test_shard_submit(shards, &requests[i]);
+    }
+    test_shard_wait(requests, count);
+    for (i = 0; i < count; i++) {
+        failures += (requests[i].result != LIBCACHE_SUCCESS || entries[i] != keys[i] * 2);
+    }
+    return (void*) failures;
+}
+
+TEST(TestShardOwnerMode)
+{
+    libshard_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.shard_count = TEST_SHARD_COUNT;
+    attr.max_entry_number = TEST_SHARD_ENTRIES;
+    attr.entry_size = sizeof(int);
+    attr.key_size = sizeof(int);
+    attr.cmp_key = test_key_com;
+    attr.key_to_number = test_key_to_int;
+    attr.numa_node_count = 2;
+    attr.owner_mode = TRUE;
+    attr.ring_size = 64;
+    void* shards = libshard_create(&attr);
+    CHECK(shards != NULL);
+    CHECK_EQUAL(TRUE, libshard_is_owner_mode(shards));
+    CHECK_EQUAL(FALSE, libshard_is_owner_mode(NULL));
+
+    int key = 1;
+    CHECK(libshard_add(shards, &key, &key) == NULL);
+    CHECK(libshard_lookup(shards, &key, &key) == NULL);
+    CHECK_EQUAL(LIBCACHE_FAILURE, libshard_delete_by_key(shards, &key));
+
+    g_owner_stop = FALSE;
+    pthread_t owners[TEST_SHARD_COUNT];
+    void* owner_args[TEST_SHARD_COUNT][2];
+    int i;
+    for (i = 0; i < TEST_SHARD_COUNT; i++) {
+        owner_args[i][0] = shards;
+        owner_args[i][1] = (void*) (long) i;
+        pthread_create(&owners[i], NULL, test_shard_owner, owner_args[i]);
+    }
+
+    pthread_t clients[TEST_THREAD_COUNT];
+    void* client_args[TEST_THREAD_COUNT][2];
+    for (i = 0; i < TEST_THREAD_COUNT; i++) {
+        client_args[i][0] = shards;
+        client_args[i][1] = (void*) (long) (i * 1000);
+        pthread_create(&clients[i], NULL, test_shard_client, client_args[i]);
+    }
+    for (i = 0; i < TEST_THREAD_COUNT; i++) {
+        void* failures = NULL;
+        pthread_join(clients[i], &failures);
+        CHECK(failures == NULL);
+    }
+
+    libshard_request_t request;
+    request.op = LIBSHARD_OP_DELETE;
+    request.key = &key;
+    request.entry = NULL;
+    test_shard_submit(shards, &request);
+    test_shard_wait(&request, 1);
+    CHECK_EQUAL(LIBCACHE_SUCCESS, request.result);
+
+    // Note: the owners are still running, the counts are the ones they published with their results
+    CHECK_EQUAL(TEST_THREAD_COUNT * 200 - 1, (int) libshard_get_entry_number(shards));
+    int entry_number = 0;
+    for (i = 0; i < TEST_SHARD_COUNT; i++) {
+        libshard_shard_info_t info;
+        CHECK_EQUAL(LIBCACHE_SUCCESS, libshard_get_shard_info(shards, i, &info));
+        CHECK_EQUAL(TEST_SHARD_ENTRIES, (int) info.max_entry_number);
+        CHECK_EQUAL(0, (int) info.replica_number);
+        entry_number += (int) info.entry_number;
+    }
+    CHECK_EQUAL(TEST_THREAD_COUNT * 200 - 1, entry_number);
+
+    g_owner_stop = TRUE;
+    for (i = 0; i < TEST_SHARD_COUNT; i++) {
+        pthread_join(owners[i], NULL);
+    }
+    CHECK_EQUAL(TEST_THREAD_COUNT * 200 - 1, (int) libshard_get_entry_number(shards));
+    libshard_destroy(shards);
+}
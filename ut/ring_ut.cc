@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "UnitTest++.h"
+#include "ring.h"
+
+#define TEST_RING_SLOTS     (64)
+#define TEST_RING_PRODUCERS (4)
+#define TEST_RING_ITEMS     (20000)
+
+static ring_t* test_ring_create(unsigned int slot_count)
+{
+    void* memory = NULL;
+    if (posix_memalign(&memory, RING_CACHE_LINE, ring_get_memory_size(slot_count)) != 0) {
+        return NULL;
+    }
+    return ring_init(memory, slot_count);
+}
+
+TEST(ring_ut_normal)
+{
+    void* memory = NULL;
+    CHECK_EQUAL(0, posix_memalign(&memory, RING_CACHE_LINE, ring_get_memory_size(TEST_RING_SLOTS)));
+    CHECK(ring_init(memory, 3) == NULL);
+    CHECK(ring_init(NULL, TEST_RING_SLOTS) == NULL);
+
+    ring_t* ring = ring_init(memory, TEST_RING_SLOTS);
+    CHECK(ring != NULL);
+    CHECK(ring_dequeue(ring) == NULL);
+
+    long i;
+    for (i = 1; i <= TEST_RING_SLOTS; i++) {
+        CHECK_EQUAL(TRUE, ring_enqueue(ring, (void*) i));
+    }
+    CHECK_EQUAL(FALSE, ring_enqueue(ring, (void*) i));
+
+    CHECK((void*) 1 == ring_dequeue(ring));
+    CHECK_EQUAL(TRUE, ring_enqueue(ring, (void*) i));
+
+    void* burst[TEST_RING_SLOTS];
+    CHECK_EQUAL(TEST_RING_SLOTS, ring_dequeue_burst(ring, burst, TEST_RING_SLOTS));
+    for (i = 0; i < TEST_RING_SLOTS; i++) {
+        CHECK((void*) (i + 2) == burst[i]);
+    }
+    CHECK_EQUAL(0, ring_dequeue_burst(ring, burst, TEST_RING_SLOTS));
+
+    free(memory);
+}
+
+static void* test_ring_producer(void* arg)
+{
+    ring_t* ring = (ring_t*) ((void**) arg)[0];
+    long base = (long) ((void**) arg)[1];
+    long i;
+    for (i = 0; i < TEST_RING_ITEMS; i++) {
+        while (!ring_enqueue(ring, (void*) (base + i))) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+TEST(ring_ut_multi_producer)
+{
+    ring_t* ring = test_ring_create(TEST_RING_SLOTS);
+    CHECK(ring != NULL);
+
+    pthread_t threads[TEST_RING_PRODUCERS];
+    void* args[TEST_RING_PRODUCERS][2];
+    int i;
+    for (i = 0; i < TEST_RING_PRODUCERS; i++) {
+        args[i][0] = ring;
+        args[i][1] = (void*) (long) ((i + 1) * 1000000);
+        pthread_create(&threads[i], NULL, test_ring_producer, args[i]);
+    }
+
+    // Note: the order of every producer is kept
+    long next[TEST_RING_PRODUCERS] = { 0 };
+    long received = 0;
+    int in_order = TRUE;
+    while (received < TEST_RING_PRODUCERS * TEST_RING_ITEMS) {
+        void* data = ring_dequeue(ring);
+        if (data == NULL) {
+            sched_yield();
+            continue;
+        }
+        long value = (long) data;
+        int producer = (int) (value / 1000000) - 1;
+        if (value % 1000000 != next[producer]) {
+            in_order = FALSE;
+        }
+        next[producer]++;
+        received++;
+    }
+    CHECK(in_order);
+
+    for (i = 0; i < TEST_RING_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK_EQUAL(TEST_RING_ITEMS, next[i]);
+    }
+    CHECK(ring_dequeue(ring) == NULL);
+    free(ring);
+}